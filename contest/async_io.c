@@ -0,0 +1,471 @@
+#define _GNU_SOURCE
+
+#include "async_io.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/*
+ * Book-keeping of the asynchronous I/O of one file handle.
+ *
+ * backend   : Backend in use
+ * queueDepth: Maximum number of requests in flight
+ * inFlight  : Requests submitted and not reaped yet
+ *
+ * io_uring, the rings are shared with the kernel:
+ * ringFd    : io_uring file descriptor
+ * unsubmitted : Entries in the submission ring the kernel has not taken yet
+ * sqHead..  : Submission queue ring: head, tail, mask and the array of sqe indexes
+ * sqes      : Submission queue entries
+ * cqHead..  : Completion queue ring: head, tail, mask and the completion entries
+ *
+ * thread pool:
+ * pending   : Ring of queueDepth requests not picked up by a worker yet
+ * done      : Ring of queueDepth finished requests not reaped yet
+ * lock      : Protects pending, done and stopping
+ * workAvailable / workDone : Signal new pending and new done requests
+ */
+struct SM_AsyncIO {
+    SM_FileHandle *fHandle;
+    SM_AsyncBackend backend;
+    int queueDepth;
+    int inFlight;
+
+    int ringFd;
+    unsigned unsubmitted;
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+
+    pthread_t workers[ASYNC_IO_WORKER_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t workAvailable;
+    pthread_cond_t workDone;
+    SM_AsyncRequest **pending;
+    int pendingHead;
+    int pendingLen;
+    SM_AsyncRequest **done;
+    int doneHead;
+    int doneLen;
+    bool stopping;
+};
+
+static RC setupRing(SM_AsyncIO *async);
+static void destroyRing(SM_AsyncIO *async);
+static RC enterRing(SM_AsyncIO *async, unsigned minComplete);
+static RC submitRing(SM_AsyncIO *async, SM_AsyncRequest *requests, int numRequests);
+static int reapRing(SM_AsyncIO *async, SM_AsyncRequest **done, int maxDone, int minDone);
+static RC setupThreadPool(SM_AsyncIO *async);
+static void destroyThreadPool(SM_AsyncIO *async);
+static void submitThreadPool(SM_AsyncIO *async, SM_AsyncRequest *requests, int numRequests);
+static int reapThreadPool(SM_AsyncIO *async, SM_AsyncRequest **done, int maxDone, int minDone);
+static void *asyncWorker(void *arg);
+
+RC initAsyncIO(SM_FileHandle *fHandle, int queueDepth, SM_AsyncBackend backend) {
+    if (fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (fHandle->mgmtInfo->asyncIO != NULL || queueDepth < 1) {
+        return RC_ALLOCATION_FAILED;
+    }
+
+    SM_AsyncIO *async = calloc(1, sizeof(SM_AsyncIO));
+    async->fHandle = fHandle;
+    async->queueDepth = queueDepth;
+    async->inFlight = 0;
+    async->ringFd = -1;
+
+    // pages of a compressed file, or of a file not on disk, have no fixed place in a file, the workers read them with preadBlock
+    long long offset;
+    async->backend = backend;
+    if (backend == SM_ASYNC_IO_URING && (getPageLocation(fHandle, 0, &offset) < 0 || setupRing(async) != RC_OK)) {
+        async->backend = SM_ASYNC_THREAD_POOL;
+    }
+    if (async->backend == SM_ASYNC_THREAD_POOL && setupThreadPool(async) != RC_OK) {
+        free(async);
+        return RC_ALLOCATION_FAILED;
+    }
+
+    fHandle->mgmtInfo->asyncIO = async;
+    return RC_OK;
+}
+
+RC shutdownAsyncIO(SM_FileHandle *fHandle) {
+    SM_AsyncIO *async = fHandle->mgmtInfo->asyncIO;
+    if (async == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+
+    // the buffers of requests in flight may be freed once we return,
+    // if the ring failed closing it below cancels what is left
+    while (async->inFlight > 0) {
+        SM_AsyncRequest *done[16];
+        if (reapAsyncIO(fHandle, done, 16, 1) < 0) {
+            break;
+        }
+    }
+
+    if (async->backend == SM_ASYNC_IO_URING) {
+        destroyRing(async);
+    } else {
+        destroyThreadPool(async);
+    }
+    free(async);
+    fHandle->mgmtInfo->asyncIO = NULL;
+    return RC_OK;
+}
+
+SM_AsyncBackend getAsyncBackend(SM_FileHandle *fHandle) {
+    return fHandle->mgmtInfo->asyncIO->backend;
+}
+
+int getNumAsyncInFlight(SM_FileHandle *fHandle) {
+    SM_AsyncIO *async = fHandle->mgmtInfo->asyncIO;
+    return async == NULL ? 0 : async->inFlight;
+}
+
+RC submitAsyncIO(SM_FileHandle *fHandle, SM_AsyncRequest *requests, int numRequests) {
+    SM_AsyncIO *async = fHandle->mgmtInfo->asyncIO;
+    if (async == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (async->inFlight + numRequests > async->queueDepth) {
+        return RC_ASYNC_QUEUE_FULL;
+    }
+
+    int i;
+    for (i = 0; i < numRequests; ++i) {
+        requests[i].rc = RC_OK;
+    }
+
+    if (async->backend == SM_ASYNC_IO_URING) {
+        RC rc = submitRing(async, requests, numRequests);
+        if (rc != RC_OK) {
+            return rc;
+        }
+    } else {
+        submitThreadPool(async, requests, numRequests);
+    }
+    async->inFlight += numRequests;
+    return RC_OK;
+}
+
+int reapAsyncIO(SM_FileHandle *fHandle, SM_AsyncRequest **done, int maxDone, int minDone) {
+    SM_AsyncIO *async = fHandle->mgmtInfo->asyncIO;
+    if (async == NULL || maxDone < 1) {
+        return 0;
+    }
+    if (minDone > maxDone) {
+        minDone = maxDone;
+    }
+    if (minDone > async->inFlight) {
+        minDone = async->inFlight;
+    }
+
+    int numDone;
+    if (async->backend == SM_ASYNC_IO_URING) {
+        numDone = reapRing(async, done, maxDone, minDone);
+    } else {
+        numDone = reapThreadPool(async, done, maxDone, minDone);
+    }
+    if (numDone > 0) {
+        async->inFlight -= numDone;
+    }
+    return numDone;
+}
+
+/************************************************************
+ *                    io_uring                              *
+ ************************************************************/
+
+// Create the rings and map them in to our address space
+static RC setupRing(SM_AsyncIO *async) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int ringFd = (int) syscall(__NR_io_uring_setup, async->queueDepth, &params);
+    if (ringFd < 0) {
+        return RC_ALLOCATION_FAILED;
+    }
+    // IORING_OP_READ/WRITE came with the same kernel (5.6) as this feature
+    if (!(params.features & IORING_FEAT_CUR_PERSONALITY)) {
+        close(ringFd);
+        return RC_ALLOCATION_FAILED;
+    }
+
+    async->ringFd = ringFd;
+    async->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    async->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (async->cqRingSize > async->sqRingSize) {
+            async->sqRingSize = async->cqRingSize;
+        }
+        async->cqRingSize = async->sqRingSize;
+    }
+
+    async->sqRing = mmap(NULL, async->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ringFd, IORING_OFF_SQ_RING);
+    if (async->sqRing == MAP_FAILED) {
+        close(ringFd);
+        return RC_ALLOCATION_FAILED;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        async->cqRing = async->sqRing;
+    } else {
+        async->cqRing = mmap(NULL, async->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             ringFd, IORING_OFF_CQ_RING);
+        if (async->cqRing == MAP_FAILED) {
+            munmap(async->sqRing, async->sqRingSize);
+            close(ringFd);
+            return RC_ALLOCATION_FAILED;
+        }
+    }
+
+    async->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    async->sqes = mmap(NULL, async->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ringFd, IORING_OFF_SQES);
+    if (async->sqes == MAP_FAILED) {
+        if (async->cqRing != async->sqRing) {
+            munmap(async->cqRing, async->cqRingSize);
+        }
+        munmap(async->sqRing, async->sqRingSize);
+        close(ringFd);
+        return RC_ALLOCATION_FAILED;
+    }
+
+    char *sq = async->sqRing;
+    char *cq = async->cqRing;
+    async->sqHead = (unsigned *) (sq + params.sq_off.head);
+    async->sqTail = (unsigned *) (sq + params.sq_off.tail);
+    async->sqMask = (unsigned *) (sq + params.sq_off.ring_mask);
+    async->sqArray = (unsigned *) (sq + params.sq_off.array);
+    async->cqHead = (unsigned *) (cq + params.cq_off.head);
+    async->cqTail = (unsigned *) (cq + params.cq_off.tail);
+    async->cqMask = (unsigned *) (cq + params.cq_off.ring_mask);
+    async->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    return RC_OK;
+}
+
+static void destroyRing(SM_AsyncIO *async) {
+    munmap(async->sqes, async->sqesSize);
+    if (async->cqRing != async->sqRing) {
+        munmap(async->cqRing, async->cqRingSize);
+    }
+    munmap(async->sqRing, async->sqRingSize);
+    close(async->ringFd);
+}
+
+/*
+ * Fill one submission entry per request and hand them to the kernel with one io_uring_enter.
+ * Requests for pages outside the file are not submitted, they complete right away with an error
+ * through a NOP so that every request is reaped the same way.
+ */
+static RC submitRing(SM_AsyncIO *async, SM_AsyncRequest *requests, int numRequests) {
+    unsigned tail = *async->sqTail;
+    unsigned mask = *async->sqMask;
+    int numPages = getNumPages(async->fHandle);
+    int i;
+
+    for (i = 0; i < numRequests; ++i) {
+        SM_AsyncRequest *request = &requests[i];
+        unsigned index = tail & mask;
+        struct io_uring_sqe *sqe = &async->sqes[index];
+
+        memset(sqe, 0, sizeof(*sqe));
+        if (request->pageNum < 0 || request->pageNum >= numPages) {
+            sqe->opcode = IORING_OP_NOP;
+            request->rc = request->isWrite ? RC_READ_NON_EXISTING_PAGE : RC_READ_FAILED;
+        } else {
+            long long offset;
+            sqe->opcode = request->isWrite ? IORING_OP_WRITE : IORING_OP_READ;
+            sqe->fd = getPageLocation(async->fHandle, request->pageNum, &offset);
+            sqe->off = (unsigned long long) offset;
+            sqe->addr = (unsigned long long) (unsigned long) request->memPage;
+            sqe->len = (unsigned) getPageSize(async->fHandle);
+        }
+        sqe->user_data = (unsigned long long) (unsigned long) request;
+        async->sqArray[index] = index;
+        tail++;
+    }
+    // the kernel must see the entries before the new tail
+    __atomic_store_n(async->sqTail, tail, __ATOMIC_RELEASE);
+    async->unsubmitted += numRequests;
+
+    RC rc = enterRing(async, 0);
+    if (rc != RC_OK) {
+        // the kernel took none of the entries, ours are the last ones and are taken back out of the ring
+        __atomic_store_n(async->sqTail, tail - (unsigned) numRequests, __ATOMIC_RELEASE);
+        async->unsubmitted -= numRequests;
+    }
+    return rc;
+}
+
+/*
+ * Hand the unsubmitted entries to the kernel and wait until minComplete requests finished.
+ * Entries the kernel could not take now stay in the ring and are passed again on the next call.
+ * If io_uring_enter fails the kernel took no entry: RC_ASYNC_QUEUE_FULL if it is out of room
+ * for the moment, RC_ASYNC_IO_FAILED for any other error.
+ */
+static RC enterRing(SM_AsyncIO *async, unsigned minComplete) {
+    unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int rc;
+
+    do {
+        rc = (int) syscall(__NR_io_uring_enter, async->ringFd, async->unsubmitted, minComplete, flags, NULL, 0);
+    } while (rc < 0 && errno == EINTR);
+
+    if (rc < 0) {
+        return errno == EAGAIN || errno == EBUSY ? RC_ASYNC_QUEUE_FULL : RC_ASYNC_IO_FAILED;
+    }
+    async->unsubmitted -= (unsigned) rc;
+    return RC_OK;
+}
+
+/*
+ * Take finished requests off the completion ring, waiting in the kernel until minDone finished.
+ * If waiting fails the requests taken so far are returned, -1 if there are none.
+ */
+static int reapRing(SM_AsyncIO *async, SM_AsyncRequest **done, int maxDone, int minDone) {
+    int numDone = 0;
+
+    while (numDone < maxDone) {
+        unsigned head = *async->cqHead;
+        unsigned tail = __atomic_load_n(async->cqTail, __ATOMIC_ACQUIRE);
+
+        if (head == tail) {
+            if (numDone >= minDone) {
+                break;
+            }
+            if (enterRing(async, (unsigned) (minDone - numDone)) != RC_OK) {
+                return numDone > 0 ? numDone : -1;
+            }
+            continue;
+        }
+
+        struct io_uring_cqe *cqe = &async->cqes[head & *async->cqMask];
+        SM_AsyncRequest *request = (SM_AsyncRequest *) (unsigned long) cqe->user_data;
+        // a short transfer is an error too, pages are never partly past the end of the file
+        if (request->rc == RC_OK && cqe->res != getPageSize(async->fHandle)) {
+            request->rc = request->isWrite ? RC_WRITE_FAILED : RC_READ_FAILED;
+        }
+        done[numDone++] = request;
+        __atomic_store_n(async->cqHead, head + 1, __ATOMIC_RELEASE);
+    }
+    return numDone;
+}
+
+/************************************************************
+ *                    thread pool                           *
+ ************************************************************/
+
+static RC setupThreadPool(SM_AsyncIO *async) {
+    int i;
+
+    async->pending = malloc(async->queueDepth * sizeof(SM_AsyncRequest *));
+    async->done = malloc(async->queueDepth * sizeof(SM_AsyncRequest *));
+    async->pendingHead = async->pendingLen = 0;
+    async->doneHead = async->doneLen = 0;
+    async->stopping = FALSE;
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->workAvailable, NULL);
+    pthread_cond_init(&async->workDone, NULL);
+
+    for (i = 0; i < ASYNC_IO_WORKER_THREADS; ++i) {
+        pthread_create(&async->workers[i], NULL, asyncWorker, async);
+    }
+    return RC_OK;
+}
+
+static void destroyThreadPool(SM_AsyncIO *async) {
+    int i;
+
+    pthread_mutex_lock(&async->lock);
+    async->stopping = TRUE;
+    pthread_cond_broadcast(&async->workAvailable);
+    pthread_mutex_unlock(&async->lock);
+    for (i = 0; i < ASYNC_IO_WORKER_THREADS; ++i) {
+        pthread_join(async->workers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&async->lock);
+    pthread_cond_destroy(&async->workAvailable);
+    pthread_cond_destroy(&async->workDone);
+    free(async->pending);
+    free(async->done);
+}
+
+static void submitThreadPool(SM_AsyncIO *async, SM_AsyncRequest *requests, int numRequests) {
+    int i;
+
+    pthread_mutex_lock(&async->lock);
+    for (i = 0; i < numRequests; ++i) {
+        async->pending[(async->pendingHead + async->pendingLen) % async->queueDepth] = &requests[i];
+        async->pendingLen++;
+    }
+    pthread_cond_broadcast(&async->workAvailable);
+    pthread_mutex_unlock(&async->lock);
+}
+
+static int reapThreadPool(SM_AsyncIO *async, SM_AsyncRequest **done, int maxDone, int minDone) {
+    int numDone = 0;
+
+    pthread_mutex_lock(&async->lock);
+    while (async->doneLen < minDone) {
+        pthread_cond_wait(&async->workDone, &async->lock);
+    }
+    while (numDone < maxDone && async->doneLen > 0) {
+        done[numDone++] = async->done[async->doneHead];
+        async->doneHead = (async->doneHead + 1) % async->queueDepth;
+        async->doneLen--;
+    }
+    pthread_mutex_unlock(&async->lock);
+    return numDone;
+}
+
+// Carry out pending requests with the synchronous positional calls until the pool is stopped
+static void *asyncWorker(void *arg) {
+    SM_AsyncIO *async = arg;
+
+    pthread_mutex_lock(&async->lock);
+    while (1) {
+        while (async->pendingLen == 0 && !async->stopping) {
+            pthread_cond_wait(&async->workAvailable, &async->lock);
+        }
+        if (async->pendingLen == 0) {
+            break;
+        }
+        SM_AsyncRequest *request = async->pending[async->pendingHead];
+        async->pendingHead = (async->pendingHead + 1) % async->queueDepth;
+        async->pendingLen--;
+        pthread_mutex_unlock(&async->lock);
+
+        if (request->isWrite) {
+            request->rc = pwriteBlock(request->pageNum, async->fHandle, request->memPage);
+        } else {
+            request->rc = preadBlock(request->pageNum, async->fHandle, request->memPage);
+        }
+
+        pthread_mutex_lock(&async->lock);
+        async->done[(async->doneHead + async->doneLen) % async->queueDepth] = request;
+        async->doneLen++;
+        pthread_cond_signal(&async->workDone);
+    }
+    pthread_mutex_unlock(&async->lock);
+    return NULL;
+}
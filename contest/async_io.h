@@ -0,0 +1,62 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include "storage_mgr.h"
+#include "dt.h"
+
+/*
+ * Asynchronous page I/O on an open SM_FileHandle.
+ * Many reads and writes are submitted at once and their completions are reaped later,
+ * so a caller can keep up to queueDepth pages in flight instead of waiting for each one.
+ *
+ *      initAsyncIO(fHandle, 32, SM_ASYNC_IO_URING);
+ *      submitAsyncIO(fHandle, requests, n);
+ *      ...
+ *      reapAsyncIO(fHandle, done, n, n);   // wait for all of them
+ *
+ * One thread submits and reaps on a handle. memPage of a request must stay valid until it is reaped.
+ * On a handle opened with SM_IO_DIRECT memPage must be PAGE_SIZE aligned.
+ */
+
+// How the requests are carried out
+typedef enum SM_AsyncBackend {
+    SM_ASYNC_IO_URING = 0,      // io_uring submission and completion rings
+    SM_ASYNC_THREAD_POOL = 1    // worker threads doing preadBlock/pwriteBlock, used where io_uring is unavailable
+} SM_AsyncBackend;
+
+#define ASYNC_IO_WORKER_THREADS 4
+
+/*
+ * One page read or write.
+ *
+ * pageNum  : Page to read or write, it must exist in the file
+ * memPage  : Buffer of the file's page size (getPageSize) to read in to or write from
+ * isWrite  : Write memPage to the page instead of reading it
+ * rc       : Result, set when the request is reaped
+ * userData : Left untouched, for the caller to find its context on completion
+ */
+typedef struct SM_AsyncRequest {
+    int pageNum;
+    SM_PageHandle memPage;
+    bool isWrite;
+    RC rc;
+    void *userData;
+} SM_AsyncRequest;
+
+// Set up asynchronous I/O for fHandle. If io_uring is asked for but cannot be used the thread pool is used.
+extern RC initAsyncIO (SM_FileHandle *fHandle, int queueDepth, SM_AsyncBackend backend);
+// Tear it down, waits for requests still in flight. closePageFile does this too.
+extern RC shutdownAsyncIO (SM_FileHandle *fHandle);
+extern SM_AsyncBackend getAsyncBackend (SM_FileHandle *fHandle);
+
+// Start numRequests requests. Fails with RC_ASYNC_QUEUE_FULL if more than queueDepth would be in flight
+// or the kernel has no room for them now, and with RC_ASYNC_IO_FAILED if io_uring fails. Nothing is started then.
+extern RC submitAsyncIO (SM_FileHandle *fHandle, SM_AsyncRequest *requests, int numRequests);
+// Store up to maxDone finished requests in done, waiting until at least minDone finished.
+// Returns the number of requests stored, fewer than minDone if io_uring failed while waiting, -1 if it
+// failed before any request could be stored.
+extern int reapAsyncIO (SM_FileHandle *fHandle, SM_AsyncRequest **done, int maxDone, int minDone);
+// Number of requests submitted and not reaped yet
+extern int getNumAsyncInFlight (SM_FileHandle *fHandle);
+
+#endif
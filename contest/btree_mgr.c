@@ -20,6 +20,7 @@ int BTREE_BUFF_SIZE=20;
 extern int BTREE_BUFF_SIZE;
 #endif
 static BM_BufferPool * contestPool = NULL;
+static BM_BufferPool * sharedPool = NULL;
 
 int compareValue(Value *value, char *key, DataType keyDataType);
 
@@ -32,16 +33,31 @@ RC splitNodes(PageNumber nodeToSplit, BTreeHandle *tree, Value *key, RID rid, In
 RC initBtreePage(char *pageContent, bool isLeaf);
 
 // Initializes Index manager
+// mgmtData is a pool made with initSharedBufferPool the indexes add their files to, NULL gives each index a pool
 RC initIndexManager(void *mgmtData) {
     contestPool = NULL;
+    sharedPool = mgmtData;
     return RC_OK;
 }
 
 // Shutsdown the Index manager
 RC shutdownIndexManager() {
+    sharedPool = NULL;
     return RC_OK;
 }
 
+// Open the page file of an index in the shared pool, or in a pool of its own.
+// In the shared pool index pages are evicted after the pages of tables.
+static RC openIndexPool(BM_BufferPool *bm, char *fileName) {
+    if (sharedPool == NULL)
+        return initBufferPool(bm, fileName, BTREE_BUFF_SIZE, RS_LRU, NULL);
+
+    RC rc = openPoolFile(bm, sharedPool, fileName);
+    if (rc != RC_OK)
+        return rc;
+    return setPoolFileQuota(bm, 0, 0, PRIORITY_INDEX);
+}
+
 /**
  * Initilizes the header of empty Btree Node
  * @param pageContent: B+Tree Node page that is to be initialized
@@ -91,7 +107,7 @@ RC createBtree(char *idxId, DataType keyType, int n) {
     BM_BufferPool *bm = MAKE_POOL();
     BM_PageHandle *ph = MAKE_PAGE_HANDLE();
 
-    rc = initBufferPool(bm, fileName, BTREE_BUFF_SIZE, RS_LRU, NULL);
+    rc = openIndexPool(bm, fileName);
 
     if (rc != RC_OK) {
         free(bm);
@@ -145,7 +161,7 @@ RC openBtree(BTreeHandle **tree, char *idxId) {
 
     BM_BufferPool *bm = MAKE_POOL();
     contestPool = bm;
-    RC rc = initBufferPool(bm, fileName, BTREE_BUFF_SIZE, RS_LRU, NULL);
+    RC rc = openIndexPool(bm, fileName);
     if (rc != RC_OK) {
         free(bm);
         free(fileName);
@@ -167,6 +183,9 @@ RC openBtree(BTreeHandle **tree, char *idxId) {
     memcpy(&((*tree)->mgmtData->numRecords), ph->data + sizeof(DataType)+ 2*sizeof(int), sizeof(int));
     memcpy(&((*tree)->mgmtData->numNodes), ph->data+sizeof(DataType)+ 3*sizeof(int), sizeof(int));
 
+    // the metadata is written back from the tree handle on close
+    unpinPage(bm, ph);
+    free(ph);
     return RC_OK;
 }
 
@@ -782,8 +801,9 @@ RC splitNodes(PageNumber nodeToSplit, BTreeHandle *tree, Value *key, RID rid, In
     int splitAt = (int) ceil(header->numRec / 2.0);
 
 
-    //Get a new page from the pool
-    int newPageNum = getNumPagesInFile(bm);
+    //Get a new page from the pool, a page freed before or a new one at the end of the file
+    PageNumber newPageNum;
+    allocatePoolPage(bm, &newPageNum);
     pinPage(bm, newPh, newPageNum);
 
     // Initialize the headers
@@ -836,7 +856,7 @@ RC splitNodes(PageNumber nodeToSplit, BTreeHandle *tree, Value *key, RID rid, In
         // Check if the node to split is root.
         // If root is to be split, create a new page, initialize it.
         if (isRoot) {
-            parent = getNumPagesInFile(bm);
+            allocatePoolPage(bm, &parent);
             tree->mgmtData->rootPageNum = parent;
             pinPage(bm, parentNode, parent);
             initBtreePage(parentNode->data, false);
@@ -870,7 +890,7 @@ RC splitNodes(PageNumber nodeToSplit, BTreeHandle *tree, Value *key, RID rid, In
             splitAt = (int) floor(parentHeader->numRec / 2);
 
             // Create a new node, Initialize the headers
-            newPageNum = getNumPagesInFile(bm);
+            allocatePoolPage(bm, &newPageNum);
             pinPage(bm, ph, newPageNum);
             initBtreePage(ph->data,false);
             header = (BtreePageHeader *) ph->data;
@@ -1,8 +1,91 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "buffer_mgr.h"
 #include <stdio.h>
 #include <string.h>
-#include <math.h>
 #include <assert.h>
+#include <time.h>
+#include <stddef.h>
+#include <sched.h>
+
+static bool isSupportedStrategy(ReplacementStrategy strategy);
+static RC openFileForPool(const char *const pageFileName, SM_IOMode ioMode, SM_FileHandle **fHandle,
+                          char **fileName);
+static RC createPool(BM_BufferPool *const bm, int numPages, ReplacementStrategy strategy, void *stratData,
+                     int pageSize);
+static int addPoolFile(BM_MgmtData *mgmt, SM_FileHandle *fHandle);
+static RC removePoolFile(BM_MgmtData *mgmt, int fileId);
+static void dropPoolFilePages(BM_BufferPool *const bm);
+static QuotaData *createQuotaData(int numPages);
+static void resetFileQuota(QuotaData *quotas, int fileId, int numPages);
+static int getQuotaVictim(BM_BufferPool *const bm, PageKey key);
+static int rankQuotaVictim(BM_BufferPool *const bm, int fileId, int buffId);
+static bool *getLoadTarget(BM_BufferPool *const bm);
+static RC createStrategyData(BM_BufferPool *const bm, void *stratData);
+static void destroyStrategyData(BM_BufferPool *const bm);
+static int getVictimFrame(BM_BufferPool *const bm, PageKey key);
+static void updateStrategyOnHit(BM_BufferPool *const bm, int buffId);
+static void updateStrategyOnLoad(BM_BufferPool *const bm, int buffId, PageKey key);
+static void restoreVictimFrame(BM_BufferPool *const bm, int buffId);
+static int getAdmissionVictim(BM_BufferPool *const bm, PageKey key);
+
+static int getListVictim(BM_BufferPool *const bm);
+static int getClockVictim(BM_BufferPool *const bm);
+static int getLfuVictim(BM_BufferPool *const bm);
+static void ageLfuCounts(LFUData *lfu);
+static int getLruKVictim(BM_BufferPool *const bm);
+static unsigned long long lruKPriority(LRUKData *lruK, int buffId);
+static int getArcVictim(BM_BufferPool *const bm, PageKey key);
+static int arcReplace(BM_BufferPool *const bm, bool pageInB2);
+static int getUnpinnedFrame(BM_BufferPool *const bm, FrameLinks *links, FrameList *list);
+static void addArcGhost(ARCData *arc, PageKey key, bool toB2);
+static void dropArcGhost(ARCData *arc, int slot);
+static int getTwoQVictim(BM_BufferPool *const bm, PageKey key);
+static void addTwoQGhost(TwoQData *twoQ, PageKey key);
+static void dropTwoQGhost(TwoQData *twoQ, int slot);
+
+static PageTablePartition *getPartition(BM_BufferPool *const bm, PageKey key);
+static PageKey getFrameKey(BM_BufferPool *const bm, int buffId);
+static SM_FileHandle *getKeyFile(BM_BufferPool *const bm, PageKey key);
+static char *getFrameData(BM_BufferPool *const bm, int buffId);
+static bool frameInUse(BM_BufferPool *const bm, int buffId);
+static bool frameUnavailable(BM_BufferPool *const bm, int buffId);
+static int getFixCount(BM_BufferPool *const bm, int buffId);
+static int pinFrameOfPage(BM_BufferPool *const bm, PageKey key);
+static void unpinFrame(BM_BufferPool *const bm, int buffId);
+static RC writeFrame(BM_BufferPool *const bm, int buffId, PageKey key, bool clearDirty);
+static RC writeFrameRun(BM_BufferPool *const bm, FlushEntry *run, int numFrames);
+static int compareFlushEntries(const void *a, const void *b);
+static int compareBatchEntries(const void *a, const void *b);
+static RC loadBatch(BM_BufferPool *const bm, BatchEntry *batch, int numPages);
+static void recordHit(BM_BufferPool *const bm, int buffId, PageKey key);
+static void updateReplacementOnHit(BM_BufferPool *const bm, int buffId, PageKey key);
+static void applyBufferedHits(BM_BufferPool *const bm);
+static int compareBufferedHits(const void *a, const void *b);
+static RC pinFrame(BM_BufferPool *const bm, PageKey key, int *buffId);
+static RC pinResidentPage(BM_BufferPool *const bm, PageKey key, int *buffId);
+static RC loadPage(BM_BufferPool *const bm, PageKey key, int *loadedId);
+static RC claimFrame(BM_BufferPool *const bm, PageKey key, int *buffId);
+static bool mapLoadingFrame(BM_BufferPool *const bm, int buffId, PageKey key);
+static void finishLoadingFrame(BM_BufferPool *const bm, int buffId, PageKey key, RC rc);
+static bool waitForLoadingFrame(BM_BufferPool *const bm);
+static void unmapFrame(BM_BufferPool *const bm, int buffId, PageTablePartition *part, PageKey key);
+static int getReplacementFrame(BM_BufferPool *const bm, PageKey key);
+static void restoreReplacementFrame(BM_BufferPool *const bm, int buffId);
+static void rememberVictimFrame(BM_BufferPool *const bm, int buffId);
+static void placeLoadedFrame(BM_BufferPool *const bm, int buffId, PageKey key);
+
+static void *runBackgroundWriter(void *arg);
+static bool runBackgroundWriterRound(BM_BufferPool *const bm, bool kicked);
+static int collectDirtyFrames(BM_BufferPool *const bm, int maxFrames);
+static void addDirtyFrame(BM_BufferPool *const bm, int buffId, int *numFrames);
+static void wakeBackgroundWriter(BM_BufferPool *const bm);
+
+static void *runReadAhead(void *arg);
+static void noteSequentialPin(BM_BufferPool *const bm, PageKey key);
+static void readAheadPages(BM_BufferPool *const bm, PageKey startKey, PageKey endKey);
+static int reserveReadAheadFrames(BM_BufferPool *const bm, PageKey startKey, int numPages);
+static int reserveReadAheadFrame(BM_BufferPool *const bm, PageKey key);
 
 /*
  * Initalize BM_BufferPool with appropriate info.
@@ -10,351 +93,2732 @@
  */
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, const int numPages,
                   ReplacementStrategy strategy, void *stratData) {
+    return initBufferPoolIOMode(bm, pageFileName, numPages, strategy, stratData, SM_IO_PREAD);
+}
+
+/*
+ * Like initBufferPool, the page file is opened with the given ioMode.
+ * Frames are as large as the pages of the file.
+ * With SM_IO_DIRECT the pool is the only cache of the file's pages, frames are PAGE_SIZE aligned
+ * so they are read and written without a copy.
+ */
+RC initBufferPoolIOMode(BM_BufferPool *const bm, const char *const pageFileName, const int numPages,
+                        ReplacementStrategy strategy, void *stratData, SM_IOMode ioMode) {
+
+    if (!isSupportedStrategy(strategy)) {
+        return RC_BUFF_STRATEGY_NOT_SUPPORTED;
+    }
+
+    SM_FileHandle *fHandle;
+    char *fileName;
+    RC rc = openFileForPool(pageFileName, ioMode, &fHandle, &fileName);
+    if (rc != RC_OK) {
+        return rc;
+    }
+
+    rc = createPool(bm, numPages, strategy, stratData, getPageSize(fHandle));
+    if (rc != RC_OK) {
+        closePageFile(fHandle);
+        free(fHandle);
+        free(fileName);
+        return rc;
+    }
+    bm->pageFile = fileName;
+    bm->fileId = addPoolFile(bm->mgmtData, fHandle);
+    return RC_OK;
+}
+
+/*
+ * A pool of numPages frames of PAGE_SIZE bytes that caches pages of many files: openPoolFile adds a file
+ * and gives a handle for it, all files compete for the same frames.
+ * bm only serves to add files, to configure the pool and to shut it down.
+ */
+RC initSharedBufferPool(BM_BufferPool *const bm, const int numPages, ReplacementStrategy strategy, void *stratData) {
+    if (!isSupportedStrategy(strategy)) {
+        return RC_BUFF_STRATEGY_NOT_SUPPORTED;
+    }
 
-    SM_FileHandle *fHandle = malloc(sizeof(SM_FileHandle));
-    char* fileName = malloc((strlen(pageFileName)+1)* sizeof(char));
-    strcpy(fileName, pageFileName);
+    RC rc = createPool(bm, numPages, strategy, stratData, PAGE_SIZE);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    bm->pageFile = NULL;
+    bm->fileId = NO_FILE;
+    return RC_OK;
+}
 
-    RC rc = openPageFile(fileName, fHandle);
+/*
+ * Add the page file pageFileName to the pool of pool and make bm a handle for it.
+ * The pages of the file must be as large as the frames of the pool.
+ */
+RC openPoolFile(BM_BufferPool *const bm, BM_BufferPool *const pool, const char *const pageFileName) {
+    BM_MgmtData *mgmt = pool->mgmtData;
+    SM_FileHandle *fHandle;
+    char *fileName;
 
+    RC rc = openFileForPool(pageFileName, SM_IO_PREAD, &fHandle, &fileName);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (getPageSize(fHandle) != mgmt->pageSize) {
+        rc = RC_INVALID_PAGE_SIZE;
+    } else {
+        bm->fileId = addPoolFile(mgmt, fHandle);
+        if (bm->fileId == NO_FILE)
+            rc = RC_BUFF_POOL_IN_USE;
+    }
     if (rc != RC_OK) {
+        closePageFile(fHandle);
         free(fHandle);
-        return RC_FILE_NOT_FOUND;
+        free(fileName);
+        return rc;
+    }
+
+    bm->pageFile = fileName;
+    bm->numPages = pool->numPages;
+    bm->strategy = pool->strategy;
+    bm->mgmtData = mgmt;
+    return RC_OK;
+}
+
+/*
+ * Shut down a handle. The pages of its file are written and dropped from the pool and the file is closed.
+ * A pool is freed with the handle it was made with, once no file added with openPoolFile is left in it.
+ */
+RC shutdownBufferPool(BM_BufferPool *const bm) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    bool isOwner = mgmt->owner == bm;
+    size_t i;
+
+    if (isOwner && mgmt->numFiles > (bm->fileId == NO_FILE ? 0 : 1)) {
+        return RC_BUFF_POOL_IN_USE;
+    }
+    if (isOwner) {
+        stopReadAhead(bm);
+        stopBackgroundWriter(bm);
+    }
+
+    if (bm->fileId != NO_FILE) {
+        // Flush all dirty pages to disk
+        RC rc = forceFlushPool(bm);
+        if (rc != RC_OK) {
+            return RC_FLUSH_FAILED;
+        }
+
+        // Check for pinned pages. Throw error if there any of the pages are pinned.
+        for (i = 0; i < bm->numPages; i++) {
+            if (mgmt->buffPoolHeaders[i].fileId == bm->fileId && mgmt->buffPoolHeaders[i].pageNumber != NO_PAGE
+                && mgmt->buffPoolHeaders[i].pinned) {
+                return RC_BUFF_SHUT_FAILED;
+            }
+        }
+
+        // The other files keep using the frames of the pool
+        if (!isOwner) {
+            dropPoolFilePages(bm);
+        }
+
+        //close the file
+        rc = removePoolFile(mgmt, bm->fileId);
+        if(rc != RC_OK){
+            return rc;
+        }
+        free(bm->pageFile);
+        bm->fileId = NO_FILE;
+    }
+    if (!isOwner) {
+        return RC_OK;
+    }
+
+    // Free all allocated data
+    free(mgmt->buffPoolAddr);
+    free(mgmt->buffPoolHeaders);
+    free(mgmt->fixCount);
+    free(mgmt->files);
+    free(mgmt->fileFrames);
+    for (i = 0; i < PAGE_TABLE_PARTITIONS; ++i) {
+        pthread_mutex_destroy(&mgmt->buffTable[i].lock);
+        pthread_cond_destroy(&mgmt->buffTable[i].ioDone);
+        destroyHashTable(mgmt->buffTable[i].table);
+    }
+    free(mgmt->buffTable);
+    free(mgmt->hitBatch);
+    pthread_mutex_destroy(&mgmt->strategyLock);
+    pthread_mutex_destroy(&mgmt->ioLock);
+    destroyFreeList(mgmt->freeBuffList);
+    destroyStrategyData(bm);
+    if (mgmt->admission != NULL) {
+        AdmissionData *admission = mgmt->admission;
+        destroyFreqSketch(admission->sketch);
+        destroyFrameLinks(admission->links);
+        free(admission->inWindow);
+        free(admission);
+    }
+    if (mgmt->quotas != NULL) {
+        free(mgmt->quotas->heldBack);
+        free(mgmt->quotas);
+    }
+    free(mgmt);
+    return RC_OK;
+}
+
+static bool isSupportedStrategy(ReplacementStrategy strategy) {
+    return strategy == RS_FIFO || strategy == RS_LRU || strategy == RS_CLOCK || strategy == RS_LFU
+           || strategy == RS_LRU_K || strategy == RS_ARC || strategy == RS_2Q;
+}
+
+// Open pageFileName with a handle and a copy of the name for a pool
+static RC openFileForPool(const char *const pageFileName, SM_IOMode ioMode, SM_FileHandle **fHandle,
+                          char **fileName) {
+    *fHandle = malloc(sizeof(SM_FileHandle));
+    *fileName = malloc((strlen(pageFileName)+1)* sizeof(char));
+    strcpy(*fileName, pageFileName);
+
+    RC rc = openPageFileMode(*fileName, *fHandle, ioMode);
+
+    if (rc != RC_OK) {
+        free(*fHandle);
+        free(*fileName);
+        return rc == RC_OPEN_FAILED ? RC_OPEN_FAILED : RC_FILE_NOT_FOUND;
+    }
+    return RC_OK;
+}
+
+// Allocate the frames and the book-keeping of a pool without files, bm becomes its owner
+static RC createPool(BM_BufferPool *const bm, int numPages, ReplacementStrategy strategy, void *stratData,
+                     int pageSize) {
+    unsigned int i;
+
+    // Frames are PAGE_SIZE aligned for O_DIRECT
+    char *buffPoolAddr;
+    if (posix_memalign((void **) &buffPoolAddr, PAGE_SIZE, (size_t) pageSize * numPages) != 0) {
+        return RC_ALLOCATION_FAILED;
     }
 
     bm->strategy = strategy;
     bm->numPages = numPages;
-    bm->pageFile = fileName;
     bm->mgmtData = malloc(sizeof(BM_MgmtData));
-    bm->mgmtData->fHandle = fHandle;
-    bm->mgmtData->buffPoolAddr = malloc(PAGE_SIZE * numPages * sizeof(char));
-    memset(bm->mgmtData->buffPoolAddr,'\0',PAGE_SIZE * numPages * sizeof(char));
+    bm->mgmtData->files = calloc(POOL_MAX_FILES, sizeof(SM_FileHandle *));
+    bm->mgmtData->numFiles = 0;
+    bm->mgmtData->fileFrames = calloc(POOL_MAX_FILES, sizeof(int));
+    bm->mgmtData->owner = bm;
+    bm->mgmtData->buffPoolAddr = buffPoolAddr;
+    bm->mgmtData->pageSize = pageSize;
+    memset(bm->mgmtData->buffPoolAddr,'\0',(size_t) pageSize * numPages);
     bm->mgmtData->buffPoolHeaders = malloc(numPages * sizeof(BufferHeader));
     memset(bm->mgmtData->buffPoolHeaders,'\0',numPages * sizeof(BufferHeader));
-    bm->mgmtData->buffTable = createHashTable((size_t)pow(2, (double)(log(2*numPages)/ log(2))));
+    bm->mgmtData->buffTable = malloc(PAGE_TABLE_PARTITIONS * sizeof(PageTablePartition));
+    for (i = 0; i < PAGE_TABLE_PARTITIONS; ++i) {
+        pthread_mutex_init(&bm->mgmtData->buffTable[i].lock, NULL);
+        pthread_cond_init(&bm->mgmtData->buffTable[i].ioDone, NULL);
+        bm->mgmtData->buffTable[i].table = createHashTable(2 * numPages / PAGE_TABLE_PARTITIONS);
+        bm->mgmtData->buffTable[i].numHits = 0;
+    }
+    bm->mgmtData->hitClock = 0;
+    bm->mgmtData->hitBatch = malloc(PAGE_TABLE_PARTITIONS * HIT_BUFFER_SIZE * sizeof(BufferedHit));
+    pthread_mutex_init(&bm->mgmtData->strategyLock, NULL);
+    pthread_mutex_init(&bm->mgmtData->ioLock, NULL);
     bm->mgmtData->fixCount = malloc(sizeof(int)* numPages);
     memset(bm->mgmtData->fixCount,0,sizeof(int)* numPages);
     bm->mgmtData->freeBuffList = createFreeList();
 
-    if(strategy == RS_FIFO|| strategy == RS_LRU){
-        bm->mgmtData->strategyData = createFreeList();
-    }
+    createStrategyData(bm, stratData);
+    bm->mgmtData->admission = NULL;
+    bm->mgmtData->bgWriter = NULL;
+    bm->mgmtData->readAhead = NULL;
+    bm->mgmtData->quotas = NULL;
+    bm->mgmtData->readingAhead = FALSE;
+    bm->mgmtData->probingVictims = FALSE;
 
     bm->mgmtData->buffStats.num_buff_hits = 0;
     bm->mgmtData->buffStats.num_reads_disk = 0;
     bm->mgmtData->buffStats.num_writes_disk = 0;
+    bm->mgmtData->buffStats.num_recency_ghost_hits = 0;
+    bm->mgmtData->buffStats.num_frequency_ghost_hits = 0;
+    bm->mgmtData->buffStats.num_background_writes = 0;
+    bm->mgmtData->buffStats.num_readahead_pages = 0;
 
-    unsigned int i;
     for (i = 0; i < numPages; ++i) {
         bm->mgmtData->buffPoolHeaders[i].buff_id = i;
         bm->mgmtData->buffPoolHeaders[i].pageNumber = NO_PAGE;
+        bm->mgmtData->buffPoolHeaders[i].fileId = NO_FILE;
         bm->mgmtData->buffPoolHeaders[i].dirtyPage = FALSE;
         bm->mgmtData->buffPoolHeaders[i].pinned = FALSE;
+        bm->mgmtData->buffPoolHeaders[i].refBit = FALSE;
+        bm->mgmtData->buffPoolHeaders[i].loading = FALSE;
         bm->mgmtData->fixCount[i] = 0;
         //insertFreeNode(bm->mgmtData->freeBuffList, i);
         insertFreeNode(bm->mgmtData->freeBuffList,i);
     }
 
+    bm->fileId = NO_FILE;
     return RC_OK;
 }
 
-RC shutdownBufferPool(BM_BufferPool *const bm) {
-    // Flush all dirty pages to disk
-    RC rc = forceFlushPool(bm);
+// Give fHandle the lowest unused file id of the pool, NO_FILE if the pool has POOL_MAX_FILES files
+static int addPoolFile(BM_MgmtData *mgmt, SM_FileHandle *fHandle) {
+    int fileId;
+
+    pthread_mutex_lock(&mgmt->ioLock);
+    for (fileId = 0; fileId < POOL_MAX_FILES && mgmt->files[fileId] != NULL; ++fileId);
+    if (fileId < POOL_MAX_FILES) {
+        mgmt->files[fileId] = fHandle;
+        mgmt->numFiles++;
+    } else {
+        fileId = NO_FILE;
+    }
+    pthread_mutex_unlock(&mgmt->ioLock);
+    return fileId;
+}
+
+static RC removePoolFile(BM_MgmtData *mgmt, int fileId) {
+    SM_FileHandle *fHandle = mgmt->files[fileId];
+
+    RC rc = closePageFile(fHandle);
     if (rc != RC_OK) {
-        return RC_FLUSH_FAILED;
+        return rc;
     }
+    // the next file with this id starts without quotas
+    pthread_mutex_lock(&mgmt->strategyLock);
+    if (mgmt->quotas != NULL)
+        resetFileQuota(mgmt->quotas, fileId, mgmt->owner->numPages);
+    pthread_mutex_unlock(&mgmt->strategyLock);
+    pthread_mutex_lock(&mgmt->ioLock);
+    mgmt->files[fileId] = NULL;
+    mgmt->numFiles--;
+    pthread_mutex_unlock(&mgmt->ioLock);
+    free(fHandle);
+    return RC_OK;
+}
 
-    // Check for pinned pages. Throw error if there any of the pages are pinned.
-    size_t i;
-    for (i = 0; i < bm->numPages; i++) {
-        if (bm->mgmtData->buffPoolHeaders[i].pinned) {
-            return RC_BUFF_SHUT_FAILED;
+/*
+ * Take the written, unpinned pages of the file of bm out of the pool before the file id is reused.
+ * The frames stay where they are in the replacement strategy, empty, and are the next victims they pick.
+ * Read-ahead of the file is dropped first. Only the background writer or a flush may still hold a frame
+ * for the moment of a write, they are waited for.
+ */
+static void dropPoolFilePages(BM_BufferPool *const bm) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    ReadAheadData *ra = mgmt->readAhead;
+    int i;
+
+    if (ra != NULL) {
+        pthread_mutex_lock(&ra->lock);
+        if (ra->endKey >= ra->startKey && PAGE_KEY_FILE(ra->startKey) == bm->fileId)
+            ra->endKey = ra->startKey - 1;
+        if (PAGE_KEY_FILE(ra->lastKey) == bm->fileId)
+            ra->lastKey = MAKE_PAGE_KEY(NO_FILE, NO_PAGE);
+        while (ra->busyFile == bm->fileId)
+            pthread_cond_wait(&ra->idle, &ra->lock);
+        pthread_mutex_unlock(&ra->lock);
+    }
 
+    // No frame of the file is mapped anymore, frames of the file can only leave the page table now
+    for (i = 0; i < bm->numPages; ++i) {
+        PageKey key = getFrameKey(bm, i);
+        if (PAGE_KEY_FILE(key) != bm->fileId || PAGE_KEY_PAGE(key) == NO_PAGE)
+            continue;
+
+        PageTablePartition *part = getPartition(bm, key);
+        pthread_mutex_lock(&part->lock);
+        while (getFrameKey(bm, i) == key && getFixCount(bm, i) > 0) {
+            pthread_mutex_unlock(&part->lock);
+            sched_yield();
+            pthread_mutex_lock(&part->lock);
         }
+        unmapFrame(bm, i, part, key);
+        pthread_mutex_unlock(&part->lock);
     }
+}
 
-    //close the file
-    rc = closePageFile(bm->mgmtData->fHandle);
-    if(rc != RC_OK){
-        return rc;
+/*
+ * Put a TinyLFU admission filter in front of the replacement strategy of the pool.
+ * windowPercent is the size of the admission window in percent of the pool, <= 0 selects the default.
+ * Must be called before the first page is pinned.
+ */
+RC enableAdmissionFilter(BM_BufferPool *const bm, int windowPercent) {
+    if (bm->mgmtData->freeBuffList->listLen != bm->numPages || bm->mgmtData->admission != NULL) {
+        return RC_BUFF_POOL_IN_USE;
+    }
+    if (windowPercent <= 0) {
+        windowPercent = ADMISSION_DEFAULT_WINDOW_PERCENT;
     }
 
-    // Free all allocated data
-    free(bm->pageFile);
-    free(bm->mgmtData->buffPoolAddr);
-    free(bm->mgmtData->buffPoolHeaders);
-    free(bm->mgmtData->fixCount);
-    free(bm->mgmtData->fHandle);
-    destroyHashTable(bm->mgmtData->buffTable);
-    destroyFreeList(bm->mgmtData->freeBuffList);
-    destroyFreeList(bm->mgmtData->strategyData);
-    free(bm->mgmtData);
+    AdmissionData *admission = malloc(sizeof(AdmissionData));
+    admission->sketch = createFreqSketch(bm->numPages);
+    admission->links = createFrameLinks(bm->numPages);
+    initFrameList(&admission->window);
+    admission->inWindow = calloc(bm->numPages, sizeof(bool));
+    admission->windowSize = (int) ((long) bm->numPages * windowPercent / 100);
+    if (admission->windowSize < 1)
+        admission->windowSize = 1;
+    admission->loadToWindow = FALSE;
+    admission->victimFromWindow = FALSE;
+    bm->mgmtData->admission = admission;
     return RC_OK;
 }
 
+/*
+ * Start a thread that writes dirty, unpinned frames back ahead of demand, so a pin that needs a victim
+ * finds a clean one and does not wait for a write. config NULL, or a value <= 0 in it, selects the defaults.
+ */
+RC startBackgroundWriter(BM_BufferPool *const bm, BgWriterConfig *config) {
+    if (bm->mgmtData->bgWriter != NULL) {
+        return RC_BUFF_POOL_IN_USE;
+    }
 
-// FLush the enitre buffer Pool
-RC forceFlushPool(BM_BufferPool *const bm) {
-    size_t i;
-    BM_PageHandle *pHandle = malloc(sizeof(BM_PageHandle));
-    pHandle->data = NULL;
-    RC rc;
-    // Iterate through all bufferHeaders, check if there is a dirty page.
-    //      if it is a dirty page, flush the page
-    for (i = 0; i < bm->numPages; ++i) {
-            if (bm->mgmtData->buffPoolHeaders[i].dirtyPage){
-                pHandle->pageNum = bm->mgmtData->buffPoolHeaders[i].pageNumber;
-                assert(bm->mgmtData->buffPoolHeaders[i].pageNumber >= 0);
-                rc = forcePage(bm,pHandle);
-
-                if(rc<0){
-                    free(pHandle);
-                    return RC_FLUSH_FAILED;
-                }
-            }
+    BgWriterData *bg = malloc(sizeof(BgWriterData));
+    bg->cleanPercent = (config != NULL && config->cleanPercent > 0) ? config->cleanPercent
+                                                                    : BGWRITER_DEFAULT_CLEAN_PERCENT;
+    bg->lowWatermark = (config != NULL && config->lowWatermark > 0) ? config->lowWatermark
+                                                                    : BGWRITER_DEFAULT_LOW_WATERMARK;
+    bg->highWatermark = (config != NULL && config->highWatermark > 0) ? config->highWatermark
+                                                                      : BGWRITER_DEFAULT_HIGH_WATERMARK;
+    bg->intervalMillis = (config != NULL && config->intervalMillis > 0) ? config->intervalMillis
+                                                                        : BGWRITER_DEFAULT_INTERVAL_MILLIS;
+    bg->maxPagesPerRound = (config != NULL && config->maxPagesPerRound > 0) ? config->maxPagesPerRound
+                                                                            : BGWRITER_DEFAULT_MAX_PAGES;
+    if (bg->cleanPercent > 100)
+        bg->cleanPercent = 100;
+    if (bg->highWatermark < bg->lowWatermark)
+        bg->highWatermark = bg->lowWatermark;
+    bg->stop = FALSE;
+    bg->kicked = FALSE;
+    bg->cursor = 0;
+    bg->batch = malloc(bg->maxPagesPerRound * sizeof(FlushEntry));
+    pthread_mutex_init(&bg->lock, NULL);
+    pthread_cond_init(&bg->wakeUp, NULL);
+
+    // the thread outlives handles of files added to the pool, not the pool
+    bm->mgmtData->bgWriter = bg;
+    if (pthread_create(&bg->thread, NULL, runBackgroundWriter, bm->mgmtData->owner) != 0) {
+        bm->mgmtData->bgWriter = NULL;
+        pthread_mutex_destroy(&bg->lock);
+        pthread_cond_destroy(&bg->wakeUp);
+        free(bg->batch);
+        free(bg);
+        return RC_ALLOCATION_FAILED;
     }
-    free(pHandle);
     return RC_OK;
 }
 
-// Mark the page dirty
-//  We expect the page to be in buffer, if not throw error.
-RC markDirty(BM_BufferPool *const bm, BM_PageHandle *const page) {
+// Stop the background writer after its current round, the frames it did not get to stay dirty
+RC stopBackgroundWriter(BM_BufferPool *const bm) {
+    BgWriterData *bg = bm->mgmtData->bgWriter;
 
-    if(page == NULL){
-        return RC_DIRTY_FAILED;
+    if (bg == NULL) {
+        return RC_OK;
     }
+    pthread_mutex_lock(&bg->lock);
+    bg->stop = TRUE;
+    pthread_cond_signal(&bg->wakeUp);
+    pthread_mutex_unlock(&bg->lock);
+    pthread_join(bg->thread, NULL);
+
+    bm->mgmtData->bgWriter = NULL;
+    pthread_mutex_destroy(&bg->lock);
+    pthread_cond_destroy(&bg->wakeUp);
+    free(bg->batch);
+    free(bg);
+    return RC_OK;
+}
 
-    HashTable* hTable = bm->mgmtData->buffTable;
-
-    // Search page in hashTable
-    int buffId = searchHashTable(hTable,page->pageNum);
-    if (buffId<0){
-        printf("Trying to mark page dirty, But page not in buffer.?!\n");
-        return RC_DIRTY_FAILED;
+/*
+ * Start a thread that reads the pages following a sequential run of pins before they are pinned,
+ * numPages at a time. numPages <= 0 selects the default, it is capped at half of the pool.
+ */
+RC startReadAhead(BM_BufferPool *const bm, int numPages) {
+    if (bm->mgmtData->readAhead != NULL) {
+        return RC_BUFF_POOL_IN_USE;
+    }
+    if (numPages <= 0) {
+        numPages = READAHEAD_DEFAULT_PAGES;
+    }
+    if (numPages > bm->numPages / 2) {
+        numPages = bm->numPages / 2;
+    }
+    if (numPages < 1) {
+        return RC_BUFF_POOL_IN_USE;
     }
-    bm->mgmtData->buffPoolHeaders[buffId].dirtyPage = TRUE;
 
+    ReadAheadData *ra = malloc(sizeof(ReadAheadData));
+    ra->stop = FALSE;
+    ra->lastKey = MAKE_PAGE_KEY(NO_FILE, NO_PAGE);
+    ra->runLength = 0;
+    ra->issuedUpTo = ra->lastKey;
+    ra->startKey = 0;
+    ra->endKey = -1;
+    ra->busyFile = NO_FILE;
+    ra->numPages = numPages;
+    ra->frames = malloc(numPages * sizeof(int));
+    ra->pages = malloc(numPages * sizeof(char *));
+    pthread_mutex_init(&ra->lock, NULL);
+    pthread_cond_init(&ra->wakeUp, NULL);
+    pthread_cond_init(&ra->idle, NULL);
+
+    bm->mgmtData->readAhead = ra;
+    if (pthread_create(&ra->thread, NULL, runReadAhead, bm->mgmtData->owner) != 0) {
+        bm->mgmtData->readAhead = NULL;
+        pthread_mutex_destroy(&ra->lock);
+        pthread_cond_destroy(&ra->wakeUp);
+        pthread_cond_destroy(&ra->idle);
+        free(ra->frames);
+        free(ra->pages);
+        free(ra);
+        return RC_ALLOCATION_FAILED;
+    }
     return RC_OK;
 }
 
-/* 
-    Give the requested data block to the client.
-    If the requested block is not in the buffer, fetch from the disk and load in buffer.
-    Also pin the pageFrame  and update the stats.
-*/
-RC pinPage(BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum) {
-    HashTable* hTable = bm->mgmtData->buffTable;
-
-    // Search the page in hash table
-    int buffId = searchHashTable(hTable, pageNum);
-    BufferHeader* buffHead;
-
-    char * buffPool;
-    buffPool = bm->mgmtData->buffPoolAddr;
-    ListNode* node;
-    bool found = false;
-
-    /*
-     * If page is not in buffer:
-     *      Check for empty buffer slot.
-     *      if No empty slot
-     *          Invoke page replacement strategy, get the buffer slot to evict.
-     *      read the page in to buffer slot.
-     *
-    */
-
-    if (buffId <  0){
-        // Check for empty slot in buffer
-        node = getFreeNode(bm->mgmtData->freeBuffList);
-
-        if(node == NULL){
-                // Buffer full, Invoke PageFrame replacement strategy
-            if(bm->strategy == RS_FIFO || bm->strategy == RS_LRU){
-                node = getListHead(bm->mgmtData->strategyData);
-                if(node == NULL)
-                    return -1;
-
-                while (node) {
-                    buffId = node->buff_id;
-                    if (bm->mgmtData->buffPoolHeaders[buffId].pinned || bm->mgmtData->fixCount[buffId] > 0) {
-                        node = node->next;
-                    } else {
-                        found = true;
-                        deleteAppendListNode(bm->mgmtData->strategyData, node);
-                        break;
-                    }
-                }
-                if(!found){
-                    printf("Buffer full");
-                    exit(-1);
-                }
+// Stop read-ahead after the window being read, requested pages not taken yet are dropped
+RC stopReadAhead(BM_BufferPool *const bm) {
+    ReadAheadData *ra = bm->mgmtData->readAhead;
 
-            }
+    if (ra == NULL) {
+        return RC_OK;
+    }
+    pthread_mutex_lock(&ra->lock);
+    ra->stop = TRUE;
+    pthread_cond_signal(&ra->wakeUp);
+    pthread_mutex_unlock(&ra->lock);
+    pthread_join(ra->thread, NULL);
+
+    bm->mgmtData->readAhead = NULL;
+    pthread_mutex_destroy(&ra->lock);
+    pthread_cond_destroy(&ra->wakeUp);
+    pthread_cond_destroy(&ra->idle);
+    free(ra->frames);
+    free(ra->pages);
+    free(ra);
+    return RC_OK;
+}
 
-            // Strategy gave us a buffer frame, if it is dirty flush it, before replacing it.
-            buffHead = &(bm->mgmtData->buffPoolHeaders[buffId]);
-            BM_PageHandle *pHand = malloc(sizeof(BM_PageHandle));
+/*
+ * Set the quota of the file of bm in its pool, see QuotaData: minPages frames are reserved for the file,
+ * it holds at most maxPages frames (<= 0 for no cap) and its pages are evicted by priority.
+ * Returns RC_BUFF_POOL_IN_USE if the reservations of all files together do not fit in the pool.
+ */
+RC setPoolFileQuota(BM_BufferPool *const bm, int minPages, int maxPages, PoolPriority priority) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    int reserved;
+    int i;
+
+    if (bm->fileId == NO_FILE)
+        return RC_FILE_HANDLE_NOT_INIT;
+    if (maxPages <= 0 || maxPages > bm->numPages)
+        maxPages = bm->numPages;
+    if (minPages < 0)
+        minPages = 0;
+    if (minPages > maxPages)
+        minPages = maxPages;
+
+    pthread_mutex_lock(&mgmt->strategyLock);
+    reserved = minPages;
+    for (i = 0; mgmt->quotas != NULL && i < POOL_MAX_FILES; ++i) {
+        if (i != bm->fileId)
+            reserved += mgmt->quotas->minPages[i];
+    }
+    if (reserved > bm->numPages) {
+        pthread_mutex_unlock(&mgmt->strategyLock);
+        return RC_BUFF_POOL_IN_USE;
+    }
 
-            pHand->data = NULL;
-            pHand->pageNum = buffHead->pageNumber;
-            if(buffHead->dirtyPage)
-                forcePage(bm, pHand);
+    if (mgmt->quotas == NULL)
+        mgmt->quotas = createQuotaData(bm->numPages);
+    mgmt->quotas->minPages[bm->fileId] = minPages;
+    mgmt->quotas->maxPages[bm->fileId] = maxPages;
+    mgmt->quotas->priority[bm->fileId] = priority;
+    pthread_mutex_unlock(&mgmt->strategyLock);
+    return RC_OK;
+}
 
-            free(pHand);
+static QuotaData *createQuotaData(int numPages) {
+    QuotaData *quotas = malloc(sizeof(QuotaData));
+    int i;
 
-        }
-        else{
-            if(bm->strategy == RS_FIFO|| bm->strategy == RS_LRU)
-                insertListNode(bm->mgmtData->strategyData,node);
+    quotas->heldBack = calloc(numPages, sizeof(bool));
+    for (i = 0; i < POOL_MAX_FILES; ++i) {
+        resetFileQuota(quotas, i, numPages);
+    }
+    return quotas;
+}
 
-            buffId = node->buff_id;
-        }
+// No reservation, no cap and the lowest class
+static void resetFileQuota(QuotaData *quotas, int fileId, int numPages) {
+    quotas->minPages[fileId] = 0;
+    quotas->maxPages[fileId] = numPages;
+    quotas->priority[fileId] = PRIORITY_HEAP;
+}
 
-        //ensure capacity before reading the page
-        RC rc;
-        rc = ensureCapacity(pageNum+1, bm->mgmtData->fHandle);
-        if(rc!=RC_OK){
-            return rc;
-        }
+// FLush the enitre buffer Pool, the pages of the file of bm if it is a handle for a file of a shared pool
+RC forceFlushPool(BM_BufferPool *const bm) {
+    size_t i;
+    int numDirty = 0;
+    RC rc = RC_OK;
+    FlushEntry *dirty = malloc(bm->numPages * sizeof(FlushEntry));
 
-        //Read the page from disk to buffer
-        rc = readBlock(pageNum, bm->mgmtData->fHandle, &buffPool[buffId*PAGE_SIZE]);
-        if(rc !=RC_OK){
-            return rc;
+    // Iterate through all bufferHeaders, check if there is a dirty page.
+    //      if it is a dirty page, pin it so it stays in the buffer until it is written
+    for (i = 0; i < bm->numPages; ++i) {
+        if (__atomic_load_n(&bm->mgmtData->buffPoolHeaders[i].dirtyPage, __ATOMIC_ACQUIRE)) {
+            PageKey key = getFrameKey(bm, i);
+            if (bm->fileId != NO_FILE && PAGE_KEY_FILE(key) != bm->fileId)
+                continue;
+            int buffId = pinFrameOfPage(bm, key);
+
+            // The page was evicted (and written) by another thread in the meantime
+            if (buffId != i) {
+                if (buffId >= 0)
+                    unpinFrame(bm, buffId);
+                continue;
+            }
+            dirty[numDirty].key = key;
+            dirty[numDirty].buffId = buffId;
+            numDirty++;
         }
-        //printf("BuffId: %d \n", buffId);
-
-        // Delete the old page mapping in buffTable.
-        // Insert the new page mapping in buffTable. Done with single call to delsert (Both del and ins are done here)
-        delsertHashNode(bm->mgmtData->buffTable,bm->mgmtData->buffPoolHeaders[buffId].pageNumber, pageNum, buffId);
-
-        bm->mgmtData->buffStats.num_reads_disk +=1;
-
     }
-    else{
-        if(bm->strategy == RS_LRU){
-            deleteAppendListData(bm->mgmtData->strategyData,buffId);
+
+    // Write runs of contiguous pages with one call each
+    qsort(dirty, numDirty, sizeof(FlushEntry), compareFlushEntries);
+    int start = 0;
+    while (start < numDirty && rc == RC_OK) {
+        int end = start + 1;
+        while (end < numDirty && dirty[end].key == dirty[end - 1].key + 1) {
+            end++;
         }
-        bm->mgmtData->buffStats.num_buff_hits += 1;
+        rc = writeFrameRun(bm, &dirty[start], end - start);
+        start = end;
     }
 
+    for (i = 0; i < numDirty; ++i) {
+        unpinFrame(bm, dirty[i].buffId);
+    }
+    free(dirty);
+    return rc == RC_OK ? RC_OK : RC_FLUSH_FAILED;
+}
 
+/*
+ * Write the pinned frames of the contiguous pages run[0].key .. run[0].key + numFrames - 1 with one
+ * vectored write. Like writeFrame a frame only becomes clean if nobody else has it pinned.
+ */
+static RC writeFrameRun(BM_BufferPool *const bm, FlushEntry *run, int numFrames) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    SM_PageHandle *pages = malloc(numFrames * sizeof(SM_PageHandle));
+    int i;
+
+    for (i = 0; i < numFrames; ++i) {
+        run[i].cleared = getFixCount(bm, run[i].buffId) == 1;
+        if (run[i].cleared)
+            __atomic_store_n(&mgmt->buffPoolHeaders[run[i].buffId].dirtyPage, FALSE, __ATOMIC_RELEASE);
+        pages[i] = getFrameData(bm, run[i].buffId);
+    }
 
+    RC rc = writeBlocks(PAGE_KEY_PAGE(run[0].key), numFrames, getKeyFile(bm, run[0].key), pages);
+    free(pages);
 
-    buffHead = &(bm->mgmtData->buffPoolHeaders[buffId]);
-    // pin the buffer,update the fix count, update Statistics.
-    buffHead->pinned = TRUE;
-    buffHead->pageNumber = pageNum;
-    bm->mgmtData->fixCount[buffId] += 1;
-
-    assert(bm->mgmtData->buffPoolHeaders[buffId].pageNumber >= 0);
-    //Fill in PageHandle and return
-    page->pageNum = buffHead->pageNumber;
-    page->data = &(buffPool[buffId * PAGE_SIZE]);
+    if (rc != RC_OK) {
+        for (i = 0; i < numFrames; ++i) {
+            if (run[i].cleared)
+                __atomic_store_n(&mgmt->buffPoolHeaders[run[i].buffId].dirtyPage, TRUE, __ATOMIC_RELEASE);
+        }
+        printf("Storage Manager couldn't write to disk.");
+        return RC_FLUSH_FAILED;
+    }
 
+    __atomic_add_fetch(&mgmt->buffStats.num_writes_disk, numFrames, __ATOMIC_RELAXED);
+    return RC_OK;
+}
 
+static int compareFlushEntries(const void *a, const void *b) {
+    PageKey keyA = ((const FlushEntry *) a)->key;
+    PageKey keyB = ((const FlushEntry *) b)->key;
+    return (keyA > keyB) - (keyA < keyB);
+}
 
-    return RC_OK;
+// Body of the background writer thread: a round, then a pause unless the pool is still too dirty
+static void *runBackgroundWriter(void *arg) {
+    BM_BufferPool *bm = arg;
+    BgWriterData *bg = bm->mgmtData->bgWriter;
+
+    pthread_mutex_lock(&bg->lock);
+    while (!bg->stop) {
+        bool kicked = bg->kicked;
+        bg->kicked = FALSE;
+        pthread_mutex_unlock(&bg->lock);
+
+        bool busy = runBackgroundWriterRound(bm, kicked);
+
+        pthread_mutex_lock(&bg->lock);
+        if (!busy && !bg->stop && !bg->kicked) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_sec += bg->intervalMillis / 1000;
+            until.tv_nsec += (long) (bg->intervalMillis % 1000) * 1000000L;
+            if (until.tv_nsec >= 1000000000L) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&bg->wakeUp, &bg->lock, &until);
+        }
+    }
+    pthread_mutex_unlock(&bg->lock);
+    return NULL;
 }
 
 /*
- * Unpin the buffer and reduce the Fix count
+ * Write as many dirty, unpinned frames as it takes to get cleanPercent of the evictable frames clean,
+ * or the dirty frames down to lowWatermark once they reached highWatermark, at most maxPagesPerRound.
+ * Nothing is written while the dirty frames are below lowWatermark, unless a pin had to write a victim.
+ * Returns whether the pool is still above highWatermark, the next round then starts without a pause.
  */
-RC unpinPage(BM_BufferPool *const bm, BM_PageHandle *const page) {
-    HashTable *hTable = bm->mgmtData->buffTable;
-    int buffId = searchHashTable(hTable, page->pageNum);
+static bool runBackgroundWriterRound(BM_BufferPool *const bm, bool kicked) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    BgWriterData *bg = mgmt->bgWriter;
+    int numEvictable = 0;
+    int numDirtyEvictable = 0;
+    int numDirty = 0;
+    int i;
 
-    if(buffId < 0){
-        printf("Cannot Unpin page as it is not in buffer");
-        return RC_UNPIN_FAILED;
+    for (i = 0; i < bm->numPages; ++i) {
+        bool dirty = __atomic_load_n(&mgmt->buffPoolHeaders[i].dirtyPage, __ATOMIC_ACQUIRE);
+        numDirty += dirty;
+        if (mgmt->buffPoolHeaders[i].pageNumber != NO_PAGE && !frameInUse(bm, i)) {
+            numEvictable++;
+            numDirtyEvictable += dirty;
+        }
     }
-
-    bm->mgmtData->buffPoolHeaders[buffId].pinned = FALSE;
-    assert(bm->mgmtData->buffPoolHeaders[buffId].pageNumber >= 0);
-    if (bm->mgmtData->fixCount[buffId] > 0) {
-        bm->mgmtData->fixCount[buffId] -= 1;
+    if (!kicked && (long) numDirty * 100 < (long) bg->lowWatermark * bm->numPages)
+        return FALSE;
+
+    int toWrite = numDirtyEvictable - (int) ((long) numEvictable * (100 - bg->cleanPercent) / 100);
+    bool overHigh = (long) numDirty * 100 >= (long) bg->highWatermark * bm->numPages;
+    if (overHigh) {
+        int excess = numDirty - (int) ((long) bm->numPages * bg->lowWatermark / 100);
+        if (excess > toWrite)
+            toWrite = excess;
     }
-    return RC_OK;
+    if (kicked && toWrite < 1)
+        toWrite = 1;
+    if (toWrite > bg->maxPagesPerRound)
+        toWrite = bg->maxPagesPerRound;
+    if (toWrite <= 0)
+        return FALSE;
+
+    int numFrames = collectDirtyFrames(bm, toWrite);
+
+    // Write runs of contiguous pages with one call each, a failed run stays dirty for the pins to retry
+    qsort(bg->batch, numFrames, sizeof(FlushEntry), compareFlushEntries);
+    int start = 0;
+    while (start < numFrames) {
+        int end = start + 1;
+        while (end < numFrames && bg->batch[end].key == bg->batch[end - 1].key + 1) {
+            end++;
+        }
+        if (writeFrameRun(bm, &bg->batch[start], end - start) == RC_OK)
+            __atomic_add_fetch(&mgmt->buffStats.num_background_writes, end - start, __ATOMIC_RELAXED);
+        start = end;
+    }
+    for (i = 0; i < numFrames; ++i) {
+        unpinFrame(bm, bg->batch[i].buffId);
+    }
+    return overHigh && numFrames > 0;
 }
 
 /*
- * Flush the page to the disk.
- * update the stats.
- * Mark the page non-dirty if Fix count is zero.
+ * Pin up to maxFrames dirty, unpinned frames in to the batch of the writer, returns how many.
+ * FIFO and LRU are followed from the head of their queue and CLOCK from its hand, so the frames evicted next
+ * are cleaned first. For the other strategies the frames are swept round robin.
  */
-RC forcePage(BM_BufferPool *const bm, BM_PageHandle *const page) {
-    if(page == NULL){
-        return RC_FLUSH_FAILED;
+static int collectDirtyFrames(BM_BufferPool *const bm, int maxFrames) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    BgWriterData *bg = mgmt->bgWriter;
+    int numFrames = 0;
+    int i;
+
+    if ((bm->strategy == RS_FIFO || bm->strategy == RS_LRU) && mgmt->admission == NULL) {
+        QueueData *queue = mgmt->strategyData;
+
+        pthread_mutex_lock(&mgmt->strategyLock);
+        int buffId = queue->queue.head;
+        while (buffId != NO_FRAME && numFrames < maxFrames) {
+            addDirtyFrame(bm, buffId, &numFrames);
+            buffId = queue->links->next[buffId];
+        }
+        pthread_mutex_unlock(&mgmt->strategyLock);
+        return numFrames;
     }
 
-    int buff_id = searchHashTable(bm->mgmtData->buffTable, page->pageNum);
-    if(buff_id < 0){
-        printf("The page is not in buffer, Cannot flush it.!");
-        return RC_FLUSH_FAILED;
+    int start = bm->strategy == RS_CLOCK ? (int) __atomic_load_n(&((ClockData *) mgmt->strategyData)->hand,
+                                                                  __ATOMIC_RELAXED)
+                                         : bg->cursor;
+    for (i = 0; i < bm->numPages && numFrames < maxFrames; ++i) {
+        addDirtyFrame(bm, (start + i) % bm->numPages, &numFrames);
     }
+    bg->cursor = (start + i) % bm->numPages;
+    return numFrames;
+}
 
-    //SM_PageHandle data = calloc(PAGE_SIZE, sizeof(char));
-    SM_PageHandle data = malloc(sizeof(char)*PAGE_SIZE);
-    memset(data,'\0',PAGE_SIZE);
-    memcpy(data, &(bm->mgmtData->buffPoolAddr[buff_id*PAGE_SIZE]), PAGE_SIZE);
+// Pin the frame in to the batch if it is dirty and nobody else uses it
+static void addDirtyFrame(BM_BufferPool *const bm, int buffId, int *numFrames) {
+    BM_MgmtData *mgmt = bm->mgmtData;
 
-    //strcpy(data, &(bm->mgmtData->buffPoolAddr[buff_id*PAGE_SIZE]));
-    RC rc = writeBlock(page->pageNum, bm->mgmtData->fHandle, data);
+    if (!__atomic_load_n(&mgmt->buffPoolHeaders[buffId].dirtyPage, __ATOMIC_ACQUIRE) || frameInUse(bm, buffId))
+        return;
 
-    free(data);
-    if (rc != RC_OK){
-        printf("Storage Manager couldn't write to disk.");
-        return RC_FLUSH_FAILED;
+    PageKey key = getFrameKey(bm, buffId);
+    int pinnedId = pinFrameOfPage(bm, key);
+    // The frame got another page in the meantime, or somebody pinned it
+    if (pinnedId != buffId || getFixCount(bm, buffId) != 1) {
+        if (pinnedId >= 0)
+            unpinFrame(bm, pinnedId);
+        return;
     }
+    mgmt->bgWriter->batch[*numFrames].key = key;
+    mgmt->bgWriter->batch[*numFrames].buffId = buffId;
+    (*numFrames)++;
+}
 
-    bm->mgmtData->buffStats.num_writes_disk +=1;
-    if(bm->mgmtData->fixCount[buff_id] == 0){
-        bm->mgmtData->buffPoolHeaders[buff_id].dirtyPage = FALSE;
-    }
+// A pin is about to write a dirty victim itself, have the writer clean the frames evicted next
+static void wakeBackgroundWriter(BM_BufferPool *const bm) {
+    BgWriterData *bg = bm->mgmtData->bgWriter;
 
-    return RC_OK;
+    if (bg == NULL)
+        return;
+    pthread_mutex_lock(&bg->lock);
+    bg->kicked = TRUE;
+    pthread_cond_signal(&bg->wakeUp);
+    pthread_mutex_unlock(&bg->lock);
 }
 
-PageNumber *getFrameContents(BM_BufferPool *const bm) {
-    PageNumber * pageNbrArr = malloc(sizeof(PageNumber)*bm->numPages);
-
-    for(int i=0; i< bm->numPages; i++) {
-       pageNbrArr[i] = bm->mgmtData->buffPoolHeaders[i].pageNumber;
+// Body of the read-ahead thread: wait for requested pages and read them
+static void *runReadAhead(void *arg) {
+    BM_BufferPool *bm = arg;
+    ReadAheadData *ra = bm->mgmtData->readAhead;
 
+    pthread_mutex_lock(&ra->lock);
+    while (!ra->stop) {
+        if (ra->endKey < ra->startKey) {
+            pthread_cond_wait(&ra->wakeUp, &ra->lock);
+            continue;
+        }
+        PageKey startKey = ra->startKey;
+        PageKey endKey = ra->endKey;
+        ra->endKey = startKey - 1;
+        // the file is not removed from the pool while its pages are read
+        ra->busyFile = PAGE_KEY_FILE(startKey);
+        pthread_mutex_unlock(&ra->lock);
+
+        readAheadPages(bm, startKey, endKey);
+
+        pthread_mutex_lock(&ra->lock);
+        ra->busyFile = NO_FILE;
+        pthread_cond_broadcast(&ra->idle);
     }
-    return pageNbrArr;
+    pthread_mutex_unlock(&ra->lock);
+    return NULL;
 }
 
-bool *getDirtyFlags(BM_BufferPool *const bm) {
-    bool* flagArr = malloc(sizeof(bool)* bm->numPages);
+/*
+ * Follow the pins for sequential runs and request the next window of a run from the read-ahead thread.
+ * A request right after the pending one extends it, any other request replaces it.
+ */
+static void noteSequentialPin(BM_BufferPool *const bm, PageKey key) {
+    ReadAheadData *ra = bm->mgmtData->readAhead;
+
+    if (ra == NULL)
+        return;
+    pthread_mutex_lock(&ra->lock);
+    if (key != ra->lastKey) {
+        if (key == ra->lastKey + 1) {
+            ra->runLength++;
+        } else {
+            ra->runLength = 1;
+            ra->issuedUpTo = key;
+        }
+        ra->lastKey = key;
 
-    for (int i = 0; i < bm->numPages; ++i) {
-        flagArr[i] = bm->mgmtData->buffPoolHeaders[i].dirtyPage;
-    }
-    return flagArr;
-}
+        if (ra->runLength >= READAHEAD_MIN_RUN && ra->issuedUpTo - key <= ra->numPages / 2) {
+            PageKey startKey = (ra->issuedUpTo > key ? ra->issuedUpTo : key) + 1;
+            PageKey endKey = startKey + ra->numPages - 1;
 
-int *getFixCounts(BM_BufferPool *const bm) {
-    int * arr = malloc(sizeof(int)*bm->numPages);
-    for (int i = 0; i < bm->numPages; ++i) {
-       arr[i] = bm->mgmtData->fixCount[i];
+            if (ra->endKey >= ra->startKey && startKey == ra->endKey + 1) {
+                ra->endKey = endKey;
+            } else {
+                ra->startKey = startKey;
+                ra->endKey = endKey;
+            }
+            ra->issuedUpTo = endKey;
+            pthread_cond_signal(&ra->wakeUp);
+        }
     }
-    return arr;
+    pthread_mutex_unlock(&ra->lock);
 }
 
-int getNumReadIO(BM_BufferPool *const bm) {
-    return bm->mgmtData->buffStats.num_reads_disk;
-}
+/*
+ * Read the pages startKey .. endKey that are in their file but not in the pool, a window at a time.
+ * Stops early when no free or clean unpinned frame is left, read-ahead never writes a victim back.
+ */
+static void readAheadPages(BM_BufferPool *const bm, PageKey startKey, PageKey endKey) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    ReadAheadData *ra = mgmt->readAhead;
+    SM_FileHandle *fHandle = getKeyFile(bm, startKey);
+    int i;
+
+    pthread_mutex_lock(&mgmt->ioLock);
+    int numPagesInFile = getNumPages(fHandle);
+    pthread_mutex_unlock(&mgmt->ioLock);
+    if (PAGE_KEY_PAGE(endKey) >= numPagesInFile)
+        endKey = MAKE_PAGE_KEY(PAGE_KEY_FILE(startKey), numPagesInFile - 1);
+
+    while (startKey <= endKey) {
+        int numPages = endKey - startKey + 1 < ra->numPages ? (int) (endKey - startKey + 1) : ra->numPages;
+        int numReserved = reserveReadAheadFrames(bm, startKey, numPages);
+
+        // Read each run of contiguous pages that got a frame with one call
+        int start = 0;
+        while (start < numReserved) {
+            if (ra->frames[start] == NO_PAGE) {
+                start++;
+                continue;
+            }
+            int end = start;
+            while (end < numReserved && ra->frames[end] != NO_PAGE) {
+                ra->pages[end - start] = getFrameData(bm, ra->frames[end]);
+                end++;
+            }
+            RC rc = readBlocks(PAGE_KEY_PAGE(startKey) + start, end - start, fHandle, ra->pages);
+            for (i = start; i < end; ++i)
+                finishLoadingFrame(bm, ra->frames[i], startKey + i, rc);
+            if (rc == RC_OK) {
+                __atomic_add_fetch(&mgmt->buffStats.num_reads_disk, end - start, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&mgmt->buffStats.num_readahead_pages, end - start, __ATOMIC_RELAXED);
+            }
+            start = end;
+        }
 
-int getNumWriteIO(BM_BufferPool *const bm) {
-    return bm->mgmtData->buffStats.num_writes_disk;
+        if (numReserved < numPages)
+            return;
+        startKey += numPages;
+    }
 }
 
-int getNumPagesInFile(BM_BufferPool *const bm) {
-    SM_FileHandle *fHandle =  bm->mgmtData->fHandle;
+/*
+ * Give each of the pages startKey .. startKey + numPages - 1 that is not in the pool a frame, mapped and
+ * marked loading but not pinned, in ra->frames. Returns how many pages were handled, fewer than numPages
+ * if the pool ran out of free and clean unpinned frames.
+ */
+static int reserveReadAheadFrames(BM_BufferPool *const bm, PageKey startKey, int numPages) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    ReadAheadData *ra = mgmt->readAhead;
+    bool *loadTarget = getLoadTarget(bm);
+    int i;
 
-    return getNumPages(fHandle);
-}
+    pthread_mutex_lock(&mgmt->strategyLock);
+    for (i = 0; i < numPages; ++i) {
+        PageKey key = startKey + i;
+        PageTablePartition *part = getPartition(bm, key);
+
+        pthread_mutex_lock(&part->lock);
+        bool resident = searchHashTable(part->table, key) >= 0;
+        pthread_mutex_unlock(&part->lock);
+        if (resident) {
+            ra->frames[i] = NO_PAGE;
+            continue;
+        }
+
+        int buffId = reserveReadAheadFrame(bm, key);
+        if (buffId == NO_PAGE)
+            break;
+
+        // Map the page, unless a pin was faster
+        if (mapLoadingFrame(bm, buffId, key)) {
+            ra->frames[i] = buffId;
+        } else {
+            ra->frames[i] = NO_PAGE;
+            if (loadTarget != NULL)
+                *loadTarget = FALSE;
+        }
+    }
+    pthread_mutex_unlock(&mgmt->strategyLock);
+    return i;
+}
+
+/*
+ * A free frame, or a clean victim taken out of the page table, for reading key ahead, NO_PAGE if there
+ * is none. The caller holds strategyLock. Unlike loadPage the frame is not pinned.
+ * A page read ahead has not been asked for, so it is no ghost hit of ARC or 2Q and goes to T1 or A1in.
+ */
+static int reserveReadAheadFrame(BM_BufferPool *const bm, PageKey key) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    BufferHeader *headers = mgmt->buffPoolHeaders;
+    bool *loadTarget = getLoadTarget(bm);
+    ListNode *node = getFreeNode(mgmt->freeBuffList);
+    int buffId;
+
+    if (node != NULL) {
+        buffId = node->buff_id;
+        free(node);
+        if (mgmt->admission != NULL)
+            mgmt->admission->loadToWindow = mgmt->admission->window.listLen < mgmt->admission->windowSize;
+        if (loadTarget != NULL)
+            *loadTarget = FALSE;
+        return buffId;
+    }
+
+    mgmt->readingAhead = TRUE;
+    buffId = getReplacementFrame(bm, key);
+    mgmt->readingAhead = FALSE;
+    if (buffId < 0)
+        return NO_PAGE;
+
+    PageKey victimKey = getFrameKey(bm, buffId);
+    PageTablePartition *victimPart = getPartition(bm, victimKey);
+    bool claimed = FALSE;
+
+    pthread_mutex_lock(&victimPart->lock);
+    if (getFixCount(bm, buffId) == 0 && !headers[buffId].loading && !headers[buffId].dirtyPage) {
+        unmapFrame(bm, buffId, victimPart, victimKey);
+        claimed = TRUE;
+    }
+    pthread_mutex_unlock(&victimPart->lock);
+
+    if (!claimed) {
+        restoreReplacementFrame(bm, buffId);
+        return NO_PAGE;
+    }
+    return buffId;
+}
+
+
+// Mark the page dirty
+//  We expect the page to be in buffer, if not throw error.
+RC markDirty(BM_BufferPool *const bm, BM_PageHandle *const page) {
+
+    if(page == NULL){
+        return RC_DIRTY_FAILED;
+    }
+
+    PageKey key = MAKE_PAGE_KEY(bm->fileId, page->pageNum);
+    PageTablePartition *part = getPartition(bm, key);
+
+    // Search page in hashTable
+    pthread_mutex_lock(&part->lock);
+    int buffId = searchHashTable(part->table, key);
+    pthread_mutex_unlock(&part->lock);
+    if (buffId<0){
+        printf("Trying to mark page dirty, But page not in buffer.?!\n");
+        return RC_DIRTY_FAILED;
+    }
+    __atomic_store_n(&bm->mgmtData->buffPoolHeaders[buffId].dirtyPage, TRUE, __ATOMIC_RELEASE);
+
+    return RC_OK;
+}
+
+/* 
+    Give the requested data block to the client.
+    If the requested block is not in the buffer, fetch from the disk and load in buffer.
+    Also pin the pageFrame  and update the stats.
+*/
+RC pinPage(BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum) {
+    BufferHeader *buffHead;
+    int buffId;
+
+    if (bm->fileId == NO_FILE) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (pageNum < 0) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+
+    PageKey key = MAKE_PAGE_KEY(bm->fileId, pageNum);
+    RC rc = pinFrame(bm, key, &buffId);
+    if (rc != RC_OK) {
+        return rc;
+    }
+
+    buffHead = &(bm->mgmtData->buffPoolHeaders[buffId]);
+    // pin the buffer, the fix count was already updated
+    __atomic_store_n(&buffHead->pinned, TRUE, __ATOMIC_RELEASE);
+    noteSequentialPin(bm, key);
+
+    //Fill in PageHandle and return
+    page->pageNum = pageNum;
+    page->data = getFrameData(bm, buffId);
+
+    return RC_OK;
+}
+
+/*
+ * Pin a batch of pages. The pages in the pool are pinned first, then the misses get their frames
+ * with one pass over the replacement strategy and are read in page order, runs of contiguous pages
+ * with one call. If a page cannot be pinned the pages pinned so far are unpinned again.
+ * The same page may be in the batch more than once, it is then pinned once per handle.
+ */
+RC pinPages(BM_BufferPool *const bm, BM_PageHandle *const pages, const PageNumber *pageNums, int numPages) {
+    BatchEntry *batch;
+    int i;
+    RC rc = RC_OK;
+
+    if (bm->fileId == NO_FILE) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    for (i = 0; i < numPages; ++i) {
+        if (pageNums[i] < 0) {
+            return RC_READ_NON_EXISTING_PAGE;
+        }
+    }
+    if (numPages <= 0) {
+        return RC_OK;
+    }
+
+    batch = malloc(numPages * sizeof(BatchEntry));
+    for (i = 0; i < numPages; ++i) {
+        batch[i].pageNum = pageNums[i];
+        batch[i].index = i;
+        batch[i].buffId = NO_PAGE;
+        batch[i].reading = FALSE;
+    }
+    qsort(batch, numPages, sizeof(BatchEntry), compareBatchEntries);
+
+    rc = loadBatch(bm, batch, numPages);
+
+    // Pages another thread read while the batch was at it are pinned one by one
+    for (i = 0; i < numPages && rc == RC_OK; ++i) {
+        if (batch[i].buffId == NO_PAGE)
+            rc = pinFrame(bm, MAKE_PAGE_KEY(bm->fileId, batch[i].pageNum), &batch[i].buffId);
+    }
+
+    if (rc != RC_OK) {
+        for (i = 0; i < numPages; ++i) {
+            if (batch[i].buffId >= 0)
+                unpinFrame(bm, batch[i].buffId);
+        }
+        free(batch);
+        return rc;
+    }
+
+    for (i = 0; i < numPages; ++i) {
+        BM_PageHandle *page = &pages[batch[i].index];
+
+        __atomic_store_n(&bm->mgmtData->buffPoolHeaders[batch[i].buffId].pinned, TRUE, __ATOMIC_RELEASE);
+        noteSequentialPin(bm, MAKE_PAGE_KEY(bm->fileId, batch[i].pageNum));
+        page->pageNum = batch[i].pageNum;
+        page->data = getFrameData(bm, batch[i].buffId);
+    }
+    free(batch);
+    return RC_OK;
+}
+
+/*
+ * Pin the pages of the sorted batch that are in the pool, then take and read frames for the others.
+ * The replacement book-keeping of the hits and the frames of the misses are done with strategyLock
+ * taken once. Entries left at NO_PAGE were read by another thread in the meantime.
+ * A page that is in the batch more than once is read once, its other entries pin the same frame.
+ */
+static RC loadBatch(BM_BufferPool *const bm, BatchEntry *batch, int numPages) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    SM_FileHandle *fHandle = mgmt->files[bm->fileId];
+    SM_PageHandle *frames;
+    PageNumber lastReading = NO_PAGE;
+    int numHits = 0;
+    int numReading = 0;
+    int i;
+    RC rc = RC_OK;
+
+    for (i = 0; i < numPages && rc == RC_OK; ++i) {
+        rc = pinResidentPage(bm, MAKE_PAGE_KEY(bm->fileId, batch[i].pageNum), &batch[i].buffId);
+        if (batch[i].buffId >= 0)
+            numHits++;
+    }
+    if (rc != RC_OK)
+        return rc;
+    __atomic_add_fetch(&mgmt->buffStats.num_buff_hits, numHits, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&mgmt->strategyLock);
+    for (i = 0; i < numPages; ++i) {
+        if (batch[i].buffId >= 0)
+            updateReplacementOnHit(bm, batch[i].buffId, MAKE_PAGE_KEY(bm->fileId, batch[i].pageNum));
+    }
+    for (i = 0; i < numPages && rc == RC_OK; ++i) {
+        PageKey key = MAKE_PAGE_KEY(bm->fileId, batch[i].pageNum);
+        int buffId;
+
+        if (batch[i].buffId >= 0)
+            continue;
+        // the sorted batch has the entries of a page next to each other
+        if (i > 0 && batch[i - 1].pageNum == batch[i].pageNum) {
+            if (batch[i - 1].reading) {
+                __atomic_add_fetch(&mgmt->fixCount[batch[i - 1].buffId], 1, __ATOMIC_ACQ_REL);
+                batch[i].buffId = batch[i - 1].buffId;
+            }
+            continue;
+        }
+        if (mgmt->admission != NULL)
+            incrementFreq(mgmt->admission->sketch, key);
+        rc = claimFrame(bm, key, &buffId);
+        if (rc == RC_OK && buffId < 0)
+            rc = RC_BUFF_POOL_IN_USE;
+        if (rc == RC_OK && mapLoadingFrame(bm, buffId, key)) {
+            batch[i].buffId = buffId;
+            batch[i].reading = TRUE;
+            lastReading = batch[i].pageNum;
+            numReading++;
+        }
+    }
+    pthread_mutex_unlock(&mgmt->strategyLock);
+
+    if (numReading == 0)
+        return rc;
+
+    // The frames taken are read even if the batch failed, threads may be waiting for them
+    pthread_mutex_lock(&mgmt->ioLock);
+    RC readRc = ensureCapacity(lastReading + 1, fHandle);
+    pthread_mutex_unlock(&mgmt->ioLock);
+
+    frames = malloc(numReading * sizeof(SM_PageHandle));
+    int start = 0;
+    while (start < numPages) {
+        if (!batch[start].reading) {
+            start++;
+            continue;
+        }
+        int end = start;
+        while (end < numPages && batch[end].reading && batch[end].pageNum == batch[start].pageNum + (end - start)) {
+            frames[end - start] = getFrameData(bm, batch[end].buffId);
+            end++;
+        }
+        RC runRc = readRc == RC_OK ? readBlocks(batch[start].pageNum, end - start, fHandle, frames) : readRc;
+        for (i = start; i < end; ++i) {
+            finishLoadingFrame(bm, batch[i].buffId, MAKE_PAGE_KEY(bm->fileId, batch[i].pageNum), runRc);
+            if (runRc != RC_OK) {
+                unpinFrame(bm, batch[i].buffId);
+                batch[i].buffId = NO_PAGE;
+            }
+        }
+        if (runRc == RC_OK)
+            __atomic_add_fetch(&mgmt->buffStats.num_reads_disk, end - start, __ATOMIC_RELAXED);
+        else if (rc == RC_OK)
+            rc = runRc;
+        start = end;
+    }
+    free(frames);
+    return rc;
+}
+
+static int compareBatchEntries(const void *a, const void *b) {
+    PageNumber pageA = ((const BatchEntry *) a)->pageNum;
+    PageNumber pageB = ((const BatchEntry *) b)->pageNum;
+    return (pageA > pageB) - (pageA < pageB);
+}
+
+/*
+ * Pin the page, reading it in to a free or victim slot if it is not in the buffer.
+ *      If another thread read the same page in the meantime, start over and pin that one.
+ */
+static RC pinFrame(BM_BufferPool *const bm, PageKey key, int *buffId) {
+    RC rc;
+
+    while (1) {
+        rc = pinResidentPage(bm, key, buffId);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        if (*buffId >= 0) {
+            recordHit(bm, *buffId, key);
+            return RC_OK;
+        }
+
+        rc = loadPage(bm, key, buffId);
+        if (rc != RC_OK || *buffId >= 0) {
+            return rc;
+        }
+    }
+}
+
+/*
+ * If the page is in buffer, pin it while its partition is locked, so it cannot be evicted,
+ * and wait if it is still being read. *buffId is NO_PAGE if the page is not in the buffer.
+ */
+static RC pinResidentPage(BM_BufferPool *const bm, PageKey key, int *buffId) {
+    PageTablePartition *part = getPartition(bm, key);
+
+    pthread_mutex_lock(&part->lock);
+    *buffId = searchHashTable(part->table, key);
+    if (*buffId < 0) {
+        pthread_mutex_unlock(&part->lock);
+        *buffId = NO_PAGE;
+        return RC_OK;
+    }
+    __atomic_add_fetch(&bm->mgmtData->fixCount[*buffId], 1, __ATOMIC_ACQ_REL);
+    while (bm->mgmtData->buffPoolHeaders[*buffId].loading) {
+        pthread_cond_wait(&part->ioDone, &part->lock);
+    }
+    pthread_mutex_unlock(&part->lock);
+
+    // The thread that read the page failed and gave the slot up
+    if (getFrameKey(bm, *buffId) != key) {
+        unpinFrame(bm, *buffId);
+        *buffId = NO_PAGE;
+        return RC_READ_FAILED;
+    }
+    return RC_OK;
+}
+
+/*
+ * Unpin the buffer and reduce the Fix count
+ */
+RC unpinPage(BM_BufferPool *const bm, BM_PageHandle *const page) {
+    PageKey key = MAKE_PAGE_KEY(bm->fileId, page->pageNum);
+    PageTablePartition *part = getPartition(bm, key);
+
+    pthread_mutex_lock(&part->lock);
+    int buffId = searchHashTable(part->table, key);
+    pthread_mutex_unlock(&part->lock);
+
+    if(buffId < 0){
+        printf("Cannot Unpin page as it is not in buffer");
+        return RC_UNPIN_FAILED;
+    }
+
+    __atomic_store_n(&bm->mgmtData->buffPoolHeaders[buffId].pinned, FALSE, __ATOMIC_RELEASE);
+    unpinFrame(bm, buffId);
+    return RC_OK;
+}
+
+/*
+ * Unpin the pages of a batch. The frame of each page is found from its data, which needs no page table lookup.
+ */
+RC unpinPages(BM_BufferPool *const bm, BM_PageHandle *const pages, int numPages) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    RC rc = RC_OK;
+    int i;
+
+    for (i = 0; i < numPages; ++i) {
+        ptrdiff_t offset = pages[i].data - mgmt->buffPoolAddr;
+        int buffId = (int) (offset / mgmt->pageSize);
+
+        if (offset < 0 || buffId >= bm->numPages
+            || getFrameKey(bm, buffId) != MAKE_PAGE_KEY(bm->fileId, pages[i].pageNum)) {
+            printf("Cannot Unpin page as it is not in buffer");
+            rc = RC_UNPIN_FAILED;
+            continue;
+        }
+        __atomic_store_n(&mgmt->buffPoolHeaders[buffId].pinned, FALSE, __ATOMIC_RELEASE);
+        unpinFrame(bm, buffId);
+    }
+    return rc;
+}
+
+/*
+ * Flush the page to the disk.
+ * update the stats.
+ * Mark the page non-dirty if Fix count is zero.
+ */
+RC forcePage(BM_BufferPool *const bm, BM_PageHandle *const page) {
+    if(page == NULL){
+        return RC_FLUSH_FAILED;
+    }
+
+    // Hold a pin while writing, so that the slot is not reused under our feet
+    PageKey key = MAKE_PAGE_KEY(bm->fileId, page->pageNum);
+    int buff_id = pinFrameOfPage(bm, key);
+    if(buff_id < 0){
+        printf("The page is not in buffer, Cannot flush it.!");
+        return RC_FLUSH_FAILED;
+    }
+
+    RC rc = writeFrame(bm, buff_id, key, getFixCount(bm, buff_id) == 1);
+    unpinFrame(bm, buff_id);
+    return rc;
+}
+
+PageNumber *getFrameContents(BM_BufferPool *const bm) {
+    PageNumber * pageNbrArr = malloc(sizeof(PageNumber)*bm->numPages);
+
+    for(int i=0; i< bm->numPages; i++) {
+       pageNbrArr[i] = bm->mgmtData->buffPoolHeaders[i].pageNumber;
+
+    }
+    return pageNbrArr;
+}
+
+bool *getDirtyFlags(BM_BufferPool *const bm) {
+    bool* flagArr = malloc(sizeof(bool)* bm->numPages);
+
+    for (int i = 0; i < bm->numPages; ++i) {
+        flagArr[i] = bm->mgmtData->buffPoolHeaders[i].dirtyPage;
+    }
+    return flagArr;
+}
+
+int *getFixCounts(BM_BufferPool *const bm) {
+    int * arr = malloc(sizeof(int)*bm->numPages);
+    for (int i = 0; i < bm->numPages; ++i) {
+       arr[i] = bm->mgmtData->fixCount[i];
+    }
+    return arr;
+}
+
+/*
+ * Read the missing page key in to a free or victim slot.
+ * On success *loadedId is the slot, pinned once for the caller. *loadedId is NO_PAGE if another
+ * thread read the same page in the meantime, the caller then pins that copy instead.
+ * If every slot is pinned or being read, a slot being read is waited for and *loadedId is NO_PAGE too,
+ * the caller starts over. RC_BUFF_POOL_IN_USE if every slot is pinned.
+ *
+ * The victim is chosen and the page mapped with strategyLock held, the page itself is read
+ * after all pool locks are released.
+ */
+static RC loadPage(BM_BufferPool *const bm, PageKey key, int *loadedId) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    SM_FileHandle *fHandle = getKeyFile(bm, key);
+    PageNumber pageNum = PAGE_KEY_PAGE(key);
+    int buffId;
+    RC rc;
+
+    pthread_mutex_lock(&mgmt->strategyLock);
+    if (mgmt->admission != NULL)
+        incrementFreq(mgmt->admission->sketch, key);
+
+    rc = claimFrame(bm, key, &buffId);
+    if (rc != RC_OK) {
+        pthread_mutex_unlock(&mgmt->strategyLock);
+        return rc;
+    }
+    if (buffId < 0) {
+        pthread_mutex_unlock(&mgmt->strategyLock);
+        *loadedId = NO_PAGE;
+        return waitForLoadingFrame(bm) ? RC_OK : RC_BUFF_POOL_IN_USE;
+    }
+
+    if (!mapLoadingFrame(bm, buffId, key)) {
+        pthread_mutex_unlock(&mgmt->strategyLock);
+        *loadedId = NO_PAGE;
+        return RC_OK;
+    }
+    pthread_mutex_unlock(&mgmt->strategyLock);
+
+    //ensure capacity before reading the page, then read the page from disk to buffer
+    pthread_mutex_lock(&mgmt->ioLock);
+    rc = ensureCapacity(pageNum+1, fHandle);
+    pthread_mutex_unlock(&mgmt->ioLock);
+    if (rc == RC_OK)
+        rc = preadBlock(pageNum, fHandle, getFrameData(bm, buffId));
+
+    finishLoadingFrame(bm, buffId, key, rc);
+    if (rc != RC_OK) {
+        unpinFrame(bm, buffId);
+        return rc;
+    }
+
+    __atomic_add_fetch(&mgmt->buffStats.num_reads_disk, 1, __ATOMIC_RELAXED);
+    *loadedId = buffId;
+    return RC_OK;
+}
+
+/*
+ * Get a free slot, or a victim taken out of the page table, for the missing page key, pinned once.
+ * *buffId is NO_PAGE if every slot is in use. The caller holds strategyLock. A dirty victim is written
+ * back first without holding strategyLock, and then the choice is made again.
+ * A ghost hit of ARC or 2Q on key is only seen by the first choice, putting a victim back clears it,
+ * so it is remembered here and handed to the frame that is finally claimed.
+ */
+static RC claimFrame(BM_BufferPool *const bm, PageKey key, int *buffId) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    BufferHeader *headers = mgmt->buffPoolHeaders;
+    bool *loadTarget = getLoadTarget(bm);
+    bool toFrequentList = FALSE;
+    ListNode *node;
+    RC rc;
+
+    while (1) {
+        // Check for empty slot in buffer
+        node = getFreeNode(mgmt->freeBuffList);
+        if (node != NULL) {
+            *buffId = node->buff_id;
+            free(node);
+            if (mgmt->admission != NULL)
+                mgmt->admission->loadToWindow = mgmt->admission->window.listLen < mgmt->admission->windowSize;
+            if (loadTarget != NULL)
+                *loadTarget = toFrequentList;
+            __atomic_store_n(&mgmt->fixCount[*buffId], 1, __ATOMIC_RELEASE);
+            return RC_OK;
+        }
+
+        // Buffer full, Invoke PageFrame replacement strategy
+        *buffId = getReplacementFrame(bm, key);
+        if (loadTarget != NULL) {
+            toFrequentList = toFrequentList || *loadTarget;
+            *loadTarget = FALSE;
+        }
+        if (*buffId < 0) {
+            *buffId = NO_PAGE;
+            return RC_OK;
+        }
+
+        // Take the victim out of the page table, unless a hit pinned it after it was chosen.
+        // A dirty victim stays mapped and is only reserved for writing it back.
+        PageKey victimKey = getFrameKey(bm, *buffId);
+        PageTablePartition *victimPart = getPartition(bm, victimKey);
+        bool claimed = FALSE;
+        bool dirty = FALSE;
+
+        pthread_mutex_lock(&victimPart->lock);
+        if (getFixCount(bm, *buffId) == 0 && !headers[*buffId].loading) {
+            __atomic_store_n(&mgmt->fixCount[*buffId], 1, __ATOMIC_RELEASE);
+            if (headers[*buffId].dirtyPage) {
+                dirty = TRUE;
+            } else {
+                unmapFrame(bm, *buffId, victimPart, victimKey);
+                claimed = TRUE;
+            }
+        }
+        pthread_mutex_unlock(&victimPart->lock);
+
+        if (claimed) {
+            if (loadTarget != NULL)
+                *loadTarget = toFrequentList;
+            return RC_OK;
+        }
+
+        restoreReplacementFrame(bm, *buffId);
+        if (dirty) {
+            pthread_mutex_unlock(&mgmt->strategyLock);
+            wakeBackgroundWriter(bm);
+            rc = writeFrame(bm, *buffId, victimKey, TRUE);
+            unpinFrame(bm, *buffId);
+            pthread_mutex_lock(&mgmt->strategyLock);
+            if (rc != RC_OK)
+                return rc;
+        }
+    }
+}
+
+/*
+ * Map key to the free or claimed slot buffId and mark it loading, the caller holds strategyLock.
+ * Returns FALSE if another thread mapped the page in the meantime, the slot is then free again.
+ */
+static bool mapLoadingFrame(BM_BufferPool *const bm, int buffId, PageKey key) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    BufferHeader *headers = mgmt->buffPoolHeaders;
+    PageTablePartition *part = getPartition(bm, key);
+
+    pthread_mutex_lock(&part->lock);
+    if (searchHashTable(part->table, key) >= 0) {
+        pthread_mutex_unlock(&part->lock);
+        headers[buffId].pageNumber = NO_PAGE;
+        headers[buffId].fileId = NO_FILE;
+        __atomic_store_n(&mgmt->fixCount[buffId], 0, __ATOMIC_RELEASE);
+        insertFreeNode(mgmt->freeBuffList, buffId);
+        return FALSE;
+    }
+    insertHashNode(part->table, key, buffId);
+    headers[buffId].pageNumber = PAGE_KEY_PAGE(key);
+    headers[buffId].fileId = PAGE_KEY_FILE(key);
+    __atomic_add_fetch(&mgmt->fileFrames[PAGE_KEY_FILE(key)], 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&headers[buffId].loading, TRUE, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&part->lock);
+
+    placeLoadedFrame(bm, buffId, key);
+    return TRUE;
+}
+
+/*
+ * The read of key in to the loading slot buffId is done, wake up the threads waiting for the page.
+ * If the read failed the slot holds no page any more, the strategy keeps it and will hand it out as a victim again.
+ */
+static void finishLoadingFrame(BM_BufferPool *const bm, int buffId, PageKey key, RC rc) {
+    PageTablePartition *part = getPartition(bm, key);
+
+    pthread_mutex_lock(&part->lock);
+    if (rc != RC_OK)
+        unmapFrame(bm, buffId, part, key);
+    __atomic_store_n(&bm->mgmtData->buffPoolHeaders[buffId].loading, FALSE, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&part->ioDone);
+    pthread_mutex_unlock(&part->lock);
+}
+
+/*
+ * Wait until a slot that is being read is done, FALSE if no slot is being read.
+ * The slots read ahead are not pinned, once read they can be victims again.
+ */
+static bool waitForLoadingFrame(BM_BufferPool *const bm) {
+    BufferHeader *headers = bm->mgmtData->buffPoolHeaders;
+    int i;
+
+    for (i = 0; i < bm->numPages; ++i) {
+        if (!__atomic_load_n(&headers[i].loading, __ATOMIC_ACQUIRE))
+            continue;
+
+        PageKey key = getFrameKey(bm, i);
+        PageTablePartition *part = getPartition(bm, key);
+        pthread_mutex_lock(&part->lock);
+        while (getFrameKey(bm, i) == key && __atomic_load_n(&headers[i].loading, __ATOMIC_ACQUIRE))
+            pthread_cond_wait(&part->ioDone, &part->lock);
+        pthread_mutex_unlock(&part->lock);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Take the page key of slot buffId out of the page table, the slot then holds no page.
+ * The caller holds the lock of the partition of key. Nothing is done if the slot no longer holds key.
+ */
+static void unmapFrame(BM_BufferPool *const bm, int buffId, PageTablePartition *part, PageKey key) {
+    BufferHeader *header = &bm->mgmtData->buffPoolHeaders[buffId];
+
+    if (PAGE_KEY_PAGE(key) == NO_PAGE || getFrameKey(bm, buffId) != key)
+        return;
+    deleteHashNode(part->table, key);
+    header->pageNumber = NO_PAGE;
+    header->fileId = NO_FILE;
+    __atomic_sub_fetch(&bm->mgmtData->fileFrames[PAGE_KEY_FILE(key)], 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Update the replacement book-keeping for a hit on the pinned frame buffId.
+ * CLOCK only sets the reference bit. For the other strategies the hit is buffered in the partition of key,
+ * see PageTablePartition. A full buffer is emptied first, waiting for strategyLock in the lock order.
+ */
+static void recordHit(BM_BufferPool *const bm, int buffId, PageKey key) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    PageTablePartition *part = getPartition(bm, key);
+    bool batchFull;
+
+    __atomic_add_fetch(&mgmt->buffStats.num_buff_hits, 1, __ATOMIC_RELAXED);
+
+    if (bm->strategy == RS_CLOCK && mgmt->admission == NULL) {
+        __atomic_store_n(&mgmt->buffPoolHeaders[buffId].refBit, TRUE, __ATOMIC_RELAXED);
+        return;
+    }
+
+    pthread_mutex_lock(&part->lock);
+    while (part->numHits == HIT_BUFFER_SIZE) {
+        pthread_mutex_unlock(&part->lock);
+        pthread_mutex_lock(&mgmt->strategyLock);
+        applyBufferedHits(bm);
+        pthread_mutex_unlock(&mgmt->strategyLock);
+        pthread_mutex_lock(&part->lock);
+    }
+    part->hits[part->numHits].stamp = __atomic_fetch_add(&mgmt->hitClock, 1, __ATOMIC_RELAXED);
+    part->hits[part->numHits].buffId = buffId;
+    part->hits[part->numHits].key = key;
+    __atomic_store_n(&part->numHits, part->numHits + 1, __ATOMIC_RELAXED);
+    batchFull = part->numHits >= HIT_BATCH_SIZE;
+    pthread_mutex_unlock(&part->lock);
+
+    if (batchFull && pthread_mutex_trylock(&mgmt->strategyLock) == 0) {
+        applyBufferedHits(bm);
+        pthread_mutex_unlock(&mgmt->strategyLock);
+    }
+}
+
+/*
+ * Hand the hits buffered in all partitions to the strategy in the order they happened, the caller holds strategyLock.
+ * A frame that was evicted since holds another page, or none, and the hit on its old page is dropped.
+ */
+static void applyBufferedHits(BM_BufferPool *const bm) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    int numHits = 0;
+    int i, j;
+
+    for (i = 0; i < PAGE_TABLE_PARTITIONS; ++i) {
+        PageTablePartition *part = &mgmt->buffTable[i];
+
+        if (__atomic_load_n(&part->numHits, __ATOMIC_RELAXED) == 0)
+            continue;
+        pthread_mutex_lock(&part->lock);
+        for (j = 0; j < part->numHits; ++j) {
+            if (getFrameKey(bm, part->hits[j].buffId) == part->hits[j].key)
+                mgmt->hitBatch[numHits++] = part->hits[j];
+        }
+        __atomic_store_n(&part->numHits, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&part->lock);
+    }
+
+    qsort(mgmt->hitBatch, numHits, sizeof(BufferedHit), compareBufferedHits);
+    for (i = 0; i < numHits; ++i) {
+        updateReplacementOnHit(bm, mgmt->hitBatch[i].buffId, mgmt->hitBatch[i].key);
+    }
+}
+
+static int compareBufferedHits(const void *a, const void *b) {
+    unsigned long stampA = ((const BufferedHit *) a)->stamp;
+    unsigned long stampB = ((const BufferedHit *) b)->stamp;
+    return (stampA > stampB) - (stampA < stampB);
+}
+
+// Tell the admission filter, or the strategy, about a hit on buffId, the caller holds strategyLock
+static void updateReplacementOnHit(BM_BufferPool *const bm, int buffId, PageKey key) {
+    AdmissionData *admission = bm->mgmtData->admission;
+
+    if (admission != NULL) {
+        incrementFreq(admission->sketch, key);
+        if (admission->inWindow[buffId]) {
+            moveFrameToTail(admission->links, &admission->window, buffId);
+            return;
+        }
+    }
+    updateStrategyOnHit(bm, buffId);
+}
+
+// Ask the admission filter, or the strategy if there is none, for the slot to replace
+static int getReplacementFrame(BM_BufferPool *const bm, PageKey key) {
+    applyBufferedHits(bm);
+    if (bm->mgmtData->quotas != NULL)
+        return getQuotaVictim(bm, key);
+    if (bm->mgmtData->admission != NULL)
+        return getAdmissionVictim(bm, key);
+    return getVictimFrame(bm, key);
+}
+
+/*
+ * Victim selection under the quotas of the files, see QuotaData.
+ * Victims of the admission filter or the strategy are set aside until one keeps all quotas, none is left
+ * or QUOTA_MAX_CANDIDATES were taken. The best ranked one is taken, the others go back where they came
+ * from, the last one first.
+ * The first victim is picked as for any miss, its choices for the page being loaded, which list of ARC
+ * or 2Q or the admission window it goes to, are kept. The others are probed: the strategy leaves its
+ * ghost lists and reference bits alone for them, and only remembers the one that is taken.
+ */
+static int getQuotaVictim(BM_BufferPool *const bm, PageKey key) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    QuotaData *quotas = mgmt->quotas;
+    AdmissionData *admission = mgmt->admission;
+    bool *loadTarget;
+    bool toFrequentList = FALSE;
+    bool loadToWindow = FALSE;
+    int numCandidates = 0;
+    int best = NO_PAGE;
+    int bestRank = QUOTA_RANKS;
+    int i;
+
+    while (bestRank > 0 && numCandidates < QUOTA_MAX_CANDIDATES) {
+        mgmt->probingVictims = numCandidates > 0;
+        int buffId = admission != NULL ? getAdmissionVictim(bm, key) : getVictimFrame(bm, key);
+        mgmt->probingVictims = FALSE;
+        if (buffId < 0)
+            break;
+
+        quotas->heldBack[buffId] = TRUE;
+        quotas->candidates[numCandidates] = buffId;
+        quotas->fromWindow[numCandidates] = admission != NULL && admission->victimFromWindow;
+        if (numCandidates == 0 && admission != NULL)
+            loadToWindow = admission->loadToWindow;
+
+        int rank = rankQuotaVictim(bm, PAGE_KEY_FILE(key), buffId);
+        if (rank < bestRank) {
+            best = numCandidates;
+            bestRank = rank;
+        }
+        numCandidates++;
+    }
+
+    loadTarget = getLoadTarget(bm);
+    if (loadTarget != NULL)
+        toFrequentList = *loadTarget;
+    for (i = numCandidates - 1; i >= 0; --i) {
+        quotas->heldBack[quotas->candidates[i]] = FALSE;
+        if (i == best)
+            continue;
+        if (admission != NULL)
+            admission->victimFromWindow = quotas->fromWindow[i];
+        restoreReplacementFrame(bm, quotas->candidates[i]);
+    }
+    if (loadTarget != NULL)
+        *loadTarget = toFrequentList;
+
+    if (best == NO_PAGE)
+        return NO_PAGE;
+    if (admission != NULL) {
+        admission->victimFromWindow = quotas->fromWindow[best];
+        admission->loadToWindow = loadToWindow;
+    }
+    if (best > 0 && !quotas->fromWindow[best])
+        rememberVictimFrame(bm, quotas->candidates[best]);
+    return quotas->candidates[best];
+}
+
+/*
+ * How well evicting the page of slot buffId for a page of file fileId keeps the quotas:
+ * 0 keeps them, 1 evicts a page of a higher class, 2 breaks a reservation or a cap.
+ */
+static int rankQuotaVictim(BM_BufferPool *const bm, int fileId, int buffId) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    QuotaData *quotas = mgmt->quotas;
+    BufferHeader *header = &mgmt->buffPoolHeaders[buffId];
+    int victimFile = header->fileId;
+
+    if (header->pageNumber == NO_PAGE || victimFile == fileId)
+        return 0;
+
+    int victimFrames = __atomic_load_n(&mgmt->fileFrames[victimFile], __ATOMIC_RELAXED);
+    if (victimFrames > quotas->maxPages[victimFile])
+        return 0;
+    if (victimFrames <= quotas->minPages[victimFile]
+        || __atomic_load_n(&mgmt->fileFrames[fileId], __ATOMIC_RELAXED) >= quotas->maxPages[fileId])
+        return 2;
+    return quotas->priority[victimFile] > quotas->priority[fileId] ? 1 : 0;
+}
+
+// The flag of ARC or 2Q that sends the page being loaded to the frequency list, NULL for the other strategies
+static bool *getLoadTarget(BM_BufferPool *const bm) {
+    if (bm->strategy == RS_ARC)
+        return &((ARCData *) bm->mgmtData->strategyData)->loadToT2;
+    if (bm->strategy == RS_2Q)
+        return &((TwoQData *) bm->mgmtData->strategyData)->loadToAm;
+    return NULL;
+}
+
+// The slot from getReplacementFrame is not replaced after all, put it back where it came from
+static void restoreReplacementFrame(BM_BufferPool *const bm, int buffId) {
+    AdmissionData *admission = bm->mgmtData->admission;
+
+    if (admission != NULL && admission->victimFromWindow) {
+        prependFrame(admission->links, &admission->window, buffId);
+        admission->inWindow[buffId] = TRUE;
+        return;
+    }
+    restoreVictimFrame(bm, buffId);
+}
+
+/*
+ * The probed victim buffId is evicted after all, remember its page on the ghost list its strategy
+ * would have put it on: B1 or B2 for ARC, A1out for a page of A1in for 2Q.
+ */
+static void rememberVictimFrame(BM_BufferPool *const bm, int buffId) {
+    if (bm->mgmtData->buffPoolHeaders[buffId].pageNumber == NO_PAGE)
+        return;
+    if (bm->strategy == RS_ARC) {
+        ARCData *arc = bm->mgmtData->strategyData;
+        addArcGhost(arc, getFrameKey(bm, buffId), arc->inT2[buffId]);
+    } else if (bm->strategy == RS_2Q) {
+        TwoQData *twoQ = bm->mgmtData->strategyData;
+        if (!twoQ->inAm[buffId])
+            addTwoQGhost(twoQ, getFrameKey(bm, buffId));
+    }
+}
+
+// Hand a slot that just got a new page to the admission window or to the strategy
+static void placeLoadedFrame(BM_BufferPool *const bm, int buffId, PageKey key) {
+    AdmissionData *admission = bm->mgmtData->admission;
+
+    if (admission != NULL && admission->loadToWindow) {
+        appendFrame(admission->links, &admission->window, buffId);
+        admission->inWindow[buffId] = TRUE;
+    } else {
+        updateStrategyOnLoad(bm, buffId, key);
+    }
+}
+
+/*
+ * Write the page in slot buffId to disk, the caller holds a pin on the slot.
+ * The dirty flag is cleared before the page is written, so a change made while writing marks it dirty again.
+ */
+static RC writeFrame(BM_BufferPool *const bm, int buffId, PageKey key, bool clearDirty) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+
+    if (clearDirty)
+        __atomic_store_n(&mgmt->buffPoolHeaders[buffId].dirtyPage, FALSE, __ATOMIC_RELEASE);
+
+    RC rc = pwriteBlock(PAGE_KEY_PAGE(key), getKeyFile(bm, key), getFrameData(bm, buffId));
+
+    if (rc != RC_OK){
+        if (clearDirty)
+            __atomic_store_n(&mgmt->buffPoolHeaders[buffId].dirtyPage, TRUE, __ATOMIC_RELEASE);
+        printf("Storage Manager couldn't write to disk.");
+        return RC_FLUSH_FAILED;
+    }
+
+    __atomic_add_fetch(&mgmt->buffStats.num_writes_disk, 1, __ATOMIC_RELAXED);
+    return RC_OK;
+}
+
+// Start of the page held by slot buffId, the arena can be larger than 2 GB
+static char *getFrameData(BM_BufferPool *const bm, int buffId) {
+    return &bm->mgmtData->buffPoolAddr[(size_t) buffId * bm->mgmtData->pageSize];
+}
+
+// Page table partition a page belongs to, the pages of a file are spread like those of a pool with one file
+static PageTablePartition *getPartition(BM_BufferPool *const bm, PageKey key) {
+    return &bm->mgmtData->buffTable[((unsigned int) key + (unsigned int) PAGE_KEY_FILE(key)) % PAGE_TABLE_PARTITIONS];
+}
+
+// Page held by slot buffId
+static PageKey getFrameKey(BM_BufferPool *const bm, int buffId) {
+    BufferHeader *header = &bm->mgmtData->buffPoolHeaders[buffId];
+    return MAKE_PAGE_KEY(header->fileId, header->pageNumber);
+}
+
+// Handle of the file of a page
+static SM_FileHandle *getKeyFile(BM_BufferPool *const bm, PageKey key) {
+    return bm->mgmtData->files[PAGE_KEY_FILE(key)];
+}
+
+// A slot is in use while a client has it pinned, a thread is reading or writing it or it is read ahead
+static bool frameInUse(BM_BufferPool *const bm, int buffId) {
+    return __atomic_load_n(&bm->mgmtData->buffPoolHeaders[buffId].pinned, __ATOMIC_ACQUIRE)
+           || getFixCount(bm, buffId) > 0
+           || __atomic_load_n(&bm->mgmtData->buffPoolHeaders[buffId].loading, __ATOMIC_ACQUIRE);
+}
+
+// A slot the strategies must not pick: in use, or set aside by the quota victim search
+static bool frameUnavailable(BM_BufferPool *const bm, int buffId) {
+    return frameInUse(bm, buffId)
+           || (bm->mgmtData->quotas != NULL && bm->mgmtData->quotas->heldBack[buffId]);
+}
+
+static int getFixCount(BM_BufferPool *const bm, int buffId) {
+    return __atomic_load_n(&bm->mgmtData->fixCount[buffId], __ATOMIC_ACQUIRE);
+}
+
+// Look the page up and pin its slot, NO_PAGE if it is not in the buffer
+static int pinFrameOfPage(BM_BufferPool *const bm, PageKey key) {
+    PageTablePartition *part = getPartition(bm, key);
+
+    pthread_mutex_lock(&part->lock);
+    int buffId = searchHashTable(part->table, key);
+    if (buffId >= 0)
+        __atomic_add_fetch(&bm->mgmtData->fixCount[buffId], 1, __ATOMIC_ACQ_REL);
+    pthread_mutex_unlock(&part->lock);
+    return buffId;
+}
+
+// Drop one pin of the slot, the fix count never goes below zero
+static void unpinFrame(BM_BufferPool *const bm, int buffId) {
+    int count = getFixCount(bm, buffId);
+
+    while (count > 0 && !__atomic_compare_exchange_n(&bm->mgmtData->fixCount[buffId], &count, count - 1,
+                                                     FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+int getNumReadIO(BM_BufferPool *const bm) {
+    return bm->mgmtData->buffStats.num_reads_disk;
+}
+
+int getNumWriteIO(BM_BufferPool *const bm) {
+    return bm->mgmtData->buffStats.num_writes_disk;
+}
+
+int getNumRecencyGhostHits(BM_BufferPool *const bm) {
+    return bm->mgmtData->buffStats.num_recency_ghost_hits;
+}
+
+int getNumFrequencyGhostHits(BM_BufferPool *const bm) {
+    return bm->mgmtData->buffStats.num_frequency_ghost_hits;
+}
+
+int getNumBackgroundWrites(BM_BufferPool *const bm) {
+    return bm->mgmtData->buffStats.num_background_writes;
+}
+
+int getNumReadAheadPages(BM_BufferPool *const bm) {
+    return bm->mgmtData->buffStats.num_readahead_pages;
+}
+
+// The current target size p of T1 for an ARC pool, -1 for every other strategy
+int getArcTargetSize(BM_BufferPool *const bm) {
+    if (bm->strategy != RS_ARC)
+        return -1;
+    return ((ARCData *) bm->mgmtData->strategyData)->targetT1;
+}
+
+int getNumPagesInFile(BM_BufferPool *const bm) {
+    if (bm->fileId == NO_FILE)
+        return 0;
+    SM_FileHandle *fHandle =  bm->mgmtData->files[bm->fileId];
+
+    pthread_mutex_lock(&bm->mgmtData->ioLock);
+    int numPages = getNumPages(fHandle);
+    pthread_mutex_unlock(&bm->mgmtData->ioLock);
+    return numPages;
+}
+
+int getNumPoolFileFrames(BM_BufferPool *const bm) {
+    if (bm->fileId == NO_FILE)
+        return 0;
+    return __atomic_load_n(&bm->mgmtData->fileFrames[bm->fileId], __ATOMIC_RELAXED);
+}
+
+int getPoolPageSize(BM_BufferPool *const bm) {
+    return bm->mgmtData->pageSize;
+}
+
+// Get a page nobody uses, a freed one or a new one at the end of the file
+RC allocatePoolPage(BM_BufferPool *const bm, PageNumber *pageNum) {
+    if (bm->fileId == NO_FILE)
+        return RC_FILE_HANDLE_NOT_INIT;
+    pthread_mutex_lock(&bm->mgmtData->ioLock);
+    RC rc = allocatePage(bm->mgmtData->files[bm->fileId], pageNum);
+    pthread_mutex_unlock(&bm->mgmtData->ioLock);
+    return rc;
+}
+
+/*
+ * Give the page back to the file, it must not be pinned.
+ * If its hole is punched a frame still holding the page is made clean, writing it back would fill the hole again.
+ */
+RC freePoolPage(BM_BufferPool *const bm, PageNumber pageNum) {
+    BM_MgmtData *mgmt = bm->mgmtData;
+    if (bm->fileId == NO_FILE)
+        return RC_FILE_HANDLE_NOT_INIT;
+    SM_FileHandle *fHandle = mgmt->files[bm->fileId];
+    PageKey key = MAKE_PAGE_KEY(bm->fileId, pageNum);
+    PageTablePartition *part = getPartition(bm, key);
+
+    pthread_mutex_lock(&part->lock);
+    int buffId = searchHashTable(part->table, key);
+    if (buffId >= 0 && (getFixCount(bm, buffId) > 0 || mgmt->buffPoolHeaders[buffId].loading)) {
+        pthread_mutex_unlock(&part->lock);
+        return RC_BUFF_POOL_IN_USE;
+    }
+
+    pthread_mutex_lock(&mgmt->ioLock);
+    RC rc = freePage(fHandle, pageNum);
+    if (rc == RC_OK && buffId >= 0 && fHandle->mgmtInfo->punchHoles) {
+        __atomic_store_n(&mgmt->buffPoolHeaders[buffId].dirtyPage, FALSE, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&mgmt->ioLock);
+    pthread_mutex_unlock(&part->lock);
+    return rc;
+}
+
+bool isPoolPageFree(BM_BufferPool *const bm, PageNumber pageNum) {
+    if (bm->fileId == NO_FILE)
+        return FALSE;
+    pthread_mutex_lock(&bm->mgmtData->ioLock);
+    bool isFree = isPageFree(bm->mgmtData->files[bm->fileId], pageNum);
+    pthread_mutex_unlock(&bm->mgmtData->ioLock);
+    return isFree;
+}
+
+/*
+ * Allocate the book-keeping the replacement strategy of the pool needs.
+ * stratData is the strategy specific configuration given to initBufferPool, NULL means defaults.
+ */
+static RC createStrategyData(BM_BufferPool *const bm, void *stratData) {
+    switch (bm->strategy) {
+        case RS_FIFO:
+        case RS_LRU: {
+            QueueData *queue = malloc(sizeof(QueueData));
+            queue->links = createFrameLinks(bm->numPages);
+            initFrameList(&queue->queue);
+            bm->mgmtData->strategyData = queue;
+            break;
+        }
+        case RS_CLOCK: {
+            ClockData *clock = malloc(sizeof(ClockData));
+            clock->hand = 0;
+            bm->mgmtData->strategyData = clock;
+            break;
+        }
+        case RS_LFU: {
+            LFUConfig *config = stratData;
+            LFUData *lfu = malloc(sizeof(LFUData));
+            int f;
+
+            lfu->maxFreq = (config != NULL && config->maxFreq > 0) ? config->maxFreq : LFU_DEFAULT_MAX_FREQ;
+            lfu->agingPeriod = (config != NULL) ? config->agingPeriod : 0;
+            lfu->numRefs = 0;
+            lfu->minFreq = 1;
+            lfu->links = createFrameLinks(bm->numPages);
+            lfu->freq = calloc(bm->numPages, sizeof(int));
+            lfu->buckets = malloc((lfu->maxFreq + 1) * sizeof(FrameList));
+            for (f = 0; f <= lfu->maxFreq; ++f) {
+                initFrameList(&lfu->buckets[f]);
+            }
+            bm->mgmtData->strategyData = lfu;
+            break;
+        }
+        case RS_LRU_K: {
+            LRUKConfig *config = stratData;
+            LRUKData *lruK = malloc(sizeof(LRUKData));
+
+            lruK->k = (config != NULL && config->k > 0) ? config->k : LRUK_DEFAULT_K;
+            lruK->correlatedRefPeriod = (config != NULL && config->correlatedRefPeriod >= 0)
+                                        ? config->correlatedRefPeriod : LRUK_DEFAULT_CRP;
+            lruK->clock = 0;
+            lruK->hist = calloc((size_t) bm->numPages * lruK->k, sizeof(long));
+            lruK->last = calloc(bm->numPages, sizeof(long));
+            lruK->victimHeap = createFrameHeap(bm->numPages);
+            lruK->skipped = malloc(sizeof(int) * bm->numPages);
+            bm->mgmtData->strategyData = lruK;
+            break;
+        }
+        case RS_ARC: {
+            ARCData *arc = malloc(sizeof(ARCData));
+            int i;
+
+            // B1 and B2 together never hold more than numPages ghosts
+            arc->links = createFrameLinks(bm->numPages);
+            initFrameList(&arc->t1);
+            initFrameList(&arc->t2);
+            arc->inT2 = calloc(bm->numPages, sizeof(bool));
+            arc->ghostLinks = createFrameLinks(bm->numPages);
+            initFrameList(&arc->b1);
+            initFrameList(&arc->b2);
+            initFrameList(&arc->freeGhosts);
+            for (i = 0; i < bm->numPages; ++i) {
+                appendFrame(arc->ghostLinks, &arc->freeGhosts, i);
+            }
+            arc->ghostKey = malloc(sizeof(PageKey) * bm->numPages);
+            arc->ghostInB2 = calloc(bm->numPages, sizeof(bool));
+            arc->ghostTable = createHashTable(2 * bm->numPages);
+            arc->targetT1 = 0;
+            arc->loadToT2 = FALSE;
+            bm->mgmtData->strategyData = arc;
+            break;
+        }
+        case RS_2Q: {
+            TwoQConfig *config = stratData;
+            TwoQData *twoQ = malloc(sizeof(TwoQData));
+            int inPercent = (config != NULL && config->inPercent > 0) ? config->inPercent : TWOQ_DEFAULT_IN_PERCENT;
+            int outPercent = (config != NULL && config->outPercent > 0) ? config->outPercent : TWOQ_DEFAULT_OUT_PERCENT;
+            int maxOut = (int) ((long) bm->numPages * outPercent / 100);
+            int i;
+
+            twoQ->maxIn = (int) ((long) bm->numPages * inPercent / 100);
+            if (twoQ->maxIn < 1)
+                twoQ->maxIn = 1;
+            if (maxOut < 1)
+                maxOut = 1;
+
+            twoQ->links = createFrameLinks(bm->numPages);
+            initFrameList(&twoQ->a1in);
+            initFrameList(&twoQ->am);
+            twoQ->inAm = calloc(bm->numPages, sizeof(bool));
+            twoQ->ghostLinks = createFrameLinks(maxOut);
+            initFrameList(&twoQ->a1out);
+            initFrameList(&twoQ->freeGhosts);
+            for (i = 0; i < maxOut; ++i) {
+                appendFrame(twoQ->ghostLinks, &twoQ->freeGhosts, i);
+            }
+            twoQ->ghostKey = malloc(sizeof(PageKey) * maxOut);
+            twoQ->ghostTable = createHashTable(2 * maxOut);
+            twoQ->loadToAm = FALSE;
+            bm->mgmtData->strategyData = twoQ;
+            break;
+        }
+        default:
+            return RC_BUFF_STRATEGY_NOT_SUPPORTED;
+    }
+    return RC_OK;
+}
+
+// Free the book-keeping of the replacement strategy
+static void destroyStrategyData(BM_BufferPool *const bm) {
+    switch (bm->strategy) {
+        case RS_FIFO:
+        case RS_LRU: {
+            QueueData *queue = bm->mgmtData->strategyData;
+            destroyFrameLinks(queue->links);
+            free(queue);
+            break;
+        }
+        case RS_LFU: {
+            LFUData *lfu = bm->mgmtData->strategyData;
+            destroyFrameLinks(lfu->links);
+            free(lfu->freq);
+            free(lfu->buckets);
+            free(lfu);
+            break;
+        }
+        case RS_LRU_K: {
+            LRUKData *lruK = bm->mgmtData->strategyData;
+            free(lruK->hist);
+            free(lruK->last);
+            destroyFrameHeap(lruK->victimHeap);
+            free(lruK->skipped);
+            free(lruK);
+            break;
+        }
+        case RS_ARC: {
+            ARCData *arc = bm->mgmtData->strategyData;
+            destroyFrameLinks(arc->links);
+            free(arc->inT2);
+            destroyFrameLinks(arc->ghostLinks);
+            free(arc->ghostKey);
+            free(arc->ghostInB2);
+            destroyHashTable(arc->ghostTable);
+            free(arc);
+            break;
+        }
+        case RS_2Q: {
+            TwoQData *twoQ = bm->mgmtData->strategyData;
+            destroyFrameLinks(twoQ->links);
+            free(twoQ->inAm);
+            destroyFrameLinks(twoQ->ghostLinks);
+            free(twoQ->ghostKey);
+            destroyHashTable(twoQ->ghostTable);
+            free(twoQ);
+            break;
+        }
+        default:
+            free(bm->mgmtData->strategyData);
+    }
+}
+
+/*
+ * Ask the replacement strategy for a frame to evict.
+ * The returned frame is unpinned, NO_PAGE means every frame is in use.
+ */
+static int getVictimFrame(BM_BufferPool *const bm, PageKey key) {
+    switch (bm->strategy) {
+        case RS_FIFO:
+        case RS_LRU:
+            return getListVictim(bm);
+        case RS_CLOCK:
+            return getClockVictim(bm);
+        case RS_LFU:
+            return getLfuVictim(bm);
+        case RS_LRU_K:
+            return getLruKVictim(bm);
+        case RS_ARC:
+            return getArcVictim(bm, key);
+        case RS_2Q:
+            return getTwoQVictim(bm, key);
+        default:
+            return NO_PAGE;
+    }
+}
+
+// The page in frame buffId was requested again
+static void updateStrategyOnHit(BM_BufferPool *const bm, int buffId) {
+    switch (bm->strategy) {
+        case RS_LRU: {
+            QueueData *queue = bm->mgmtData->strategyData;
+            moveFrameToTail(queue->links, &queue->queue, buffId);
+            break;
+        }
+        case RS_CLOCK:
+            __atomic_store_n(&bm->mgmtData->buffPoolHeaders[buffId].refBit, TRUE, __ATOMIC_RELAXED);
+            break;
+        case RS_LFU: {
+            LFUData *lfu = bm->mgmtData->strategyData;
+            int f = lfu->freq[buffId];
+
+            if (f < lfu->maxFreq) {
+                removeFrame(lfu->links, &lfu->buckets[f], buffId);
+                appendFrame(lfu->links, &lfu->buckets[f + 1], buffId);
+                lfu->freq[buffId] = f + 1;
+                if (f == lfu->minFreq && lfu->buckets[f].listLen == 0)
+                    lfu->minFreq = f + 1;
+            } else {
+                moveFrameToTail(lfu->links, &lfu->buckets[f], buffId);
+            }
+            if (lfu->agingPeriod > 0 && ++lfu->numRefs >= lfu->agingPeriod)
+                ageLfuCounts(lfu);
+            break;
+        }
+        case RS_LRU_K: {
+            LRUKData *lruK = bm->mgmtData->strategyData;
+            long *hist = &lruK->hist[(size_t) buffId * lruK->k];
+            long now = ++lruK->clock;
+            int i;
+
+            // An uncorrelated reference closes the previous correlated period, which counts as
+            // a single reference: shift the history by the length of that period.
+            if (now - lruK->last[buffId] > lruK->correlatedRefPeriod) {
+                long correlPeriod = lruK->last[buffId] - hist[0];
+                for (i = lruK->k - 1; i > 0; --i) {
+                    hist[i] = (hist[i - 1] != 0) ? hist[i - 1] + correlPeriod : 0;
+                }
+                hist[0] = now;
+                updateHeapFrame(lruK->victimHeap, buffId, lruKPriority(lruK, buffId));
+            }
+            lruK->last[buffId] = now;
+            break;
+        }
+        case RS_ARC: {
+            ARCData *arc = bm->mgmtData->strategyData;
+            if (arc->inT2[buffId]) {
+                moveFrameToTail(arc->links, &arc->t2, buffId);
+            } else {
+                removeFrame(arc->links, &arc->t1, buffId);
+                appendFrame(arc->links, &arc->t2, buffId);
+                arc->inT2[buffId] = TRUE;
+            }
+            break;
+        }
+        case RS_2Q: {
+            // Hits on A1in are part of the first, correlated burst of references
+            TwoQData *twoQ = bm->mgmtData->strategyData;
+            if (twoQ->inAm[buffId])
+                moveFrameToTail(twoQ->links, &twoQ->am, buffId);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// A new page was read in to frame buffId
+static void updateStrategyOnLoad(BM_BufferPool *const bm, int buffId, PageKey key) {
+    switch (bm->strategy) {
+        case RS_FIFO:
+        case RS_LRU: {
+            QueueData *queue = bm->mgmtData->strategyData;
+            appendFrame(queue->links, &queue->queue, buffId);
+            break;
+        }
+        case RS_CLOCK:
+            __atomic_store_n(&bm->mgmtData->buffPoolHeaders[buffId].refBit, TRUE, __ATOMIC_RELAXED);
+            break;
+        case RS_LFU: {
+            LFUData *lfu = bm->mgmtData->strategyData;
+            lfu->freq[buffId] = 1;
+            lfu->minFreq = 1;
+            appendFrame(lfu->links, &lfu->buckets[1], buffId);
+            if (lfu->agingPeriod > 0 && ++lfu->numRefs >= lfu->agingPeriod)
+                ageLfuCounts(lfu);
+            break;
+        }
+        case RS_LRU_K: {
+            LRUKData *lruK = bm->mgmtData->strategyData;
+            long *hist = &lruK->hist[(size_t) buffId * lruK->k];
+            int i;
+
+            hist[0] = ++lruK->clock;
+            for (i = 1; i < lruK->k; ++i) {
+                hist[i] = 0;
+            }
+            lruK->last[buffId] = hist[0];
+            pushHeapFrame(lruK->victimHeap, buffId, lruKPriority(lruK, buffId));
+            break;
+        }
+        case RS_ARC: {
+            ARCData *arc = bm->mgmtData->strategyData;
+            arc->inT2[buffId] = arc->loadToT2;
+            appendFrame(arc->links, arc->loadToT2 ? &arc->t2 : &arc->t1, buffId);
+            arc->loadToT2 = FALSE;
+            break;
+        }
+        case RS_2Q: {
+            TwoQData *twoQ = bm->mgmtData->strategyData;
+            twoQ->inAm[buffId] = twoQ->loadToAm;
+            appendFrame(twoQ->links, twoQ->loadToAm ? &twoQ->am : &twoQ->a1in, buffId);
+            twoQ->loadToAm = FALSE;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/*
+ * Undo getVictimFrame: the frame was not evicted after all and keeps its page.
+ * It goes back to the position it was taken from, any ghost entry recorded for it is dropped.
+ */
+static void restoreVictimFrame(BM_BufferPool *const bm, int buffId) {
+    switch (bm->strategy) {
+        case RS_FIFO:
+        case RS_LRU: {
+            QueueData *queue = bm->mgmtData->strategyData;
+            prependFrame(queue->links, &queue->queue, buffId);
+            break;
+        }
+        case RS_LFU: {
+            LFUData *lfu = bm->mgmtData->strategyData;
+            prependFrame(lfu->links, &lfu->buckets[lfu->freq[buffId]], buffId);
+            if (lfu->freq[buffId] < lfu->minFreq)
+                lfu->minFreq = lfu->freq[buffId];
+            break;
+        }
+        case RS_LRU_K: {
+            LRUKData *lruK = bm->mgmtData->strategyData;
+            pushHeapFrame(lruK->victimHeap, buffId, lruK->victimHeap->key[buffId]);
+            break;
+        }
+        case RS_ARC: {
+            ARCData *arc = bm->mgmtData->strategyData;
+            int slot = searchHashTable(arc->ghostTable, getFrameKey(bm, buffId));
+            if (slot >= 0)
+                dropArcGhost(arc, slot);
+            prependFrame(arc->links, arc->inT2[buffId] ? &arc->t2 : &arc->t1, buffId);
+            arc->loadToT2 = FALSE;
+            break;
+        }
+        case RS_2Q: {
+            TwoQData *twoQ = bm->mgmtData->strategyData;
+            if (twoQ->inAm[buffId]) {
+                prependFrame(twoQ->links, &twoQ->am, buffId);
+            } else {
+                int slot = searchHashTable(twoQ->ghostTable, getFrameKey(bm, buffId));
+                if (slot >= 0)
+                    dropTwoQGhost(twoQ, slot);
+                prependFrame(twoQ->links, &twoQ->a1in, buffId);
+            }
+            twoQ->loadToAm = FALSE;
+            break;
+        }
+        case RS_CLOCK: {
+            // CLOCK does not take the victim off any list, just point the hand at it again
+            ClockData *clock = bm->mgmtData->strategyData;
+            clock->hand = buffId;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/*
+ * Victim selection with the TinyLFU admission filter.
+ * The requested page always goes to the admission window. The oldest unpinned window page is
+ * the candidate for the main area, managed by the strategy: it takes the place of the strategy's
+ * victim if its estimated frequency is higher, else the candidate itself is evicted.
+ * If the window has no unpinned page the strategy evicts as usual and the new page bypasses the window.
+ */
+static int getAdmissionVictim(BM_BufferPool *const bm, PageKey key) {
+    AdmissionData *admission = bm->mgmtData->admission;
+    int candidate = getUnpinnedFrame(bm, admission->links, &admission->window);
+    int victim;
+
+    if (candidate == NO_FRAME) {
+        admission->loadToWindow = FALSE;
+        admission->victimFromWindow = FALSE;
+        return getVictimFrame(bm, key);
+    }
+
+    PageKey candidateKey = getFrameKey(bm, candidate);
+    removeFrame(admission->links, &admission->window, candidate);
+    admission->loadToWindow = TRUE;
+
+    // The candidate stays marked as a window frame until the strategy picked its victim,
+    // so that CLOCK, which sweeps over all frames, cannot pick the candidate itself.
+    victim = getVictimFrame(bm, candidateKey);
+    admission->inWindow[candidate] = FALSE;
+    if (victim < 0) {
+        admission->victimFromWindow = TRUE;
+        return candidate;
+    }
+
+    if (estimateFreq(admission->sketch, candidateKey)
+        > estimateFreq(admission->sketch, getFrameKey(bm, victim))) {
+        updateStrategyOnLoad(bm, candidate, candidateKey);
+        admission->victimFromWindow = FALSE;
+        return victim;
+    }
+    restoreVictimFrame(bm, victim);
+    admission->victimFromWindow = TRUE;
+    return candidate;
+}
+
+/*
+ * FIFO and LRU victim selection.
+ * The queue is ordered from oldest to newest (by load time for FIFO, by last use for LRU),
+ * the first unpinned frame is the victim. It leaves the queue and is appended again once the new page is loaded.
+ * Pinned frames are usually few, so this normally stops at the head.
+ */
+static int getListVictim(BM_BufferPool *const bm) {
+    QueueData *queue = bm->mgmtData->strategyData;
+    int buffId = queue->queue.head;
+
+    while (buffId != NO_FRAME) {
+        if (!frameUnavailable(bm, buffId)) {
+            removeFrame(queue->links, &queue->queue, buffId);
+            return buffId;
+        }
+        buffId = queue->links->next[buffId];
+    }
+    return NO_PAGE;
+}
+
+/*
+ * CLOCK (second chance) victim selection.
+ * Sweep the hand over the slots: a slot with its reference bit set gets a second chance
+ * (the bit is cleared), the first unpinned slot with a clear bit is the victim.
+ * Two full sweeps are enough to clear every bit, so if nothing is found by then all slots are pinned.
+ * A probe sweeps once and clears no bits.
+ */
+static int getClockVictim(BM_BufferPool *const bm) {
+    ClockData *clock = bm->mgmtData->strategyData;
+    BufferHeader *headers = bm->mgmtData->buffPoolHeaders;
+    bool probing = bm->mgmtData->probingVictims;
+    int i;
+
+    for (i = 0; i < (probing ? 1 : 2) * bm->numPages; ++i) {
+        unsigned int buffId = clock->hand;
+        clock->hand = (clock->hand + 1) % bm->numPages;
+
+        if (frameUnavailable(bm, buffId)) {
+            continue;
+        }
+        if (bm->mgmtData->admission != NULL && bm->mgmtData->admission->inWindow[buffId]) {
+            continue;
+        }
+        // hits set the bit without holding strategyLock
+        if (probing ? __atomic_load_n(&headers[buffId].refBit, __ATOMIC_RELAXED)
+                    : __atomic_exchange_n(&headers[buffId].refBit, FALSE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        return buffId;
+    }
+    return NO_PAGE;
+}
+
+/*
+ * LFU victim selection.
+ * Frames are kept in buckets by reference count, oldest reference first within a bucket,
+ * so the victim is the head of the lowest non empty bucket unless that frame is pinned.
+ * The victim leaves its bucket, it is inserted again with count 1 once the new page is loaded.
+ */
+static int getLfuVictim(BM_BufferPool *const bm) {
+    LFUData *lfu = bm->mgmtData->strategyData;
+    int f, buffId;
+
+    for (f = lfu->minFreq; f <= lfu->maxFreq; ++f) {
+        buffId = lfu->buckets[f].head;
+        while (buffId != NO_FRAME) {
+            if (!frameUnavailable(bm, buffId)) {
+                removeFrame(lfu->links, &lfu->buckets[f], buffId);
+                lfu->minFreq = f;
+                return buffId;
+            }
+            buffId = lfu->links->next[buffId];
+        }
+    }
+    return NO_PAGE;
+}
+
+/*
+ * Halve all LFU reference counts, so pages that were hot long ago can be evicted eventually.
+ * Buckets are processed from low to high count, each frame moves to a lower bucket that was
+ * already emptied, which keeps the order of frames with the same new count.
+ */
+static void ageLfuCounts(LFUData *lfu) {
+    int f, newFreq, buffId;
+
+    for (f = 2; f <= lfu->maxFreq; ++f) {
+        newFreq = f / 2;
+        while ((buffId = popFrameListHead(lfu->links, &lfu->buckets[f])) != NO_FRAME) {
+            appendFrame(lfu->links, &lfu->buckets[newFreq], buffId);
+            lfu->freq[buffId] = newFreq;
+        }
+    }
+    lfu->minFreq = 1;
+    lfu->numRefs = 0;
+}
+
+/*
+ * Eviction priority of a frame for LRU-K, the smallest value is evicted first.
+ * Frames with less than K references have an infinite backward K-distance and come first,
+ * among them the least recently used one. All others are ordered by their K-th most recent reference.
+ */
+static unsigned long long lruKPriority(LRUKData *lruK, int buffId) {
+    long *hist = &lruK->hist[(size_t) buffId * lruK->k];
+
+    if (hist[lruK->k - 1] == 0)
+        return (unsigned long long) hist[0];
+    return (1ULL << 62) + (unsigned long long) hist[lruK->k - 1];
+}
+
+/*
+ * LRU-K victim selection.
+ * Pop frames in priority order until one is neither pinned nor inside its correlated reference period.
+ * If every unpinned frame was referenced too recently, the best unpinned one is taken anyway.
+ * Frames popped but not evicted go back in to the heap.
+ */
+static int getLruKVictim(BM_BufferPool *const bm) {
+    LRUKData *lruK = bm->mgmtData->strategyData;
+    int numSkipped = 0;
+    int victim = NO_PAGE;
+    int fallback = NO_PAGE;
+    int buffId, i;
+
+    while ((buffId = popHeapFrame(lruK->victimHeap)) != NO_FRAME) {
+        if (!frameUnavailable(bm, buffId)) {
+            if (lruK->clock + 1 - lruK->last[buffId] > lruK->correlatedRefPeriod) {
+                victim = buffId;
+                break;
+            }
+            if (fallback == NO_PAGE)
+                fallback = buffId;
+        }
+        lruK->skipped[numSkipped++] = buffId;
+    }
+
+    if (victim == NO_PAGE)
+        victim = fallback;
+
+    for (i = 0; i < numSkipped; ++i) {
+        if (lruK->skipped[i] != victim)
+            pushHeapFrame(lruK->victimHeap, lruK->skipped[i], lruK->victimHeap->key[lruK->skipped[i]]);
+    }
+    return victim;
+}
+
+/*
+ * ARC victim selection, the miss cases of the ARC algorithm.
+ * A page found on B1 (B2) shows that a larger T1 (T2) would have kept it, so the target size
+ * of T1 is moved by the relative size of the other ghost list. The ghost entry is dropped and
+ * the page is loaded straight in to T2. Otherwise the ghost lists are trimmed so that
+ * |T1| + |B1| <= numPages and |T1| + |T2| + |B1| + |B2| <= 2 * numPages keep holding.
+ */
+static int getArcVictim(BM_BufferPool *const bm, PageKey key) {
+    ARCData *arc = bm->mgmtData->strategyData;
+    int slot = bm->mgmtData->readingAhead ? -1 : searchHashTable(arc->ghostTable, key);
+    int delta;
+
+    if (bm->mgmtData->probingVictims)
+        return arcReplace(bm, FALSE);
+
+    if (slot >= 0) {
+        bool inB2 = arc->ghostInB2[slot];
+
+        if (!inB2) {
+            delta = arc->b2.listLen / arc->b1.listLen;
+            arc->targetT1 += (delta > 1) ? delta : 1;
+            if (arc->targetT1 > bm->numPages)
+                arc->targetT1 = bm->numPages;
+            bm->mgmtData->buffStats.num_recency_ghost_hits += 1;
+        } else {
+            delta = arc->b1.listLen / arc->b2.listLen;
+            arc->targetT1 -= (delta > 1) ? delta : 1;
+            if (arc->targetT1 < 0)
+                arc->targetT1 = 0;
+            bm->mgmtData->buffStats.num_frequency_ghost_hits += 1;
+        }
+        dropArcGhost(arc, slot);
+        arc->loadToT2 = TRUE;
+        return arcReplace(bm, inB2);
+    }
+
+    if (arc->t1.listLen + arc->b1.listLen >= bm->numPages) {
+        if (arc->t1.listLen < bm->numPages) {
+            dropArcGhost(arc, arc->b1.head);
+        } else {
+            // B1 is empty and T1 fills the pool: evict from T1 without remembering the page
+            int buffId = getUnpinnedFrame(bm, arc->links, &arc->t1);
+            if (buffId != NO_FRAME) {
+                removeFrame(arc->links, &arc->t1, buffId);
+                return buffId;
+            }
+        }
+    } else if (arc->t1.listLen + arc->t2.listLen + arc->b1.listLen + arc->b2.listLen >= 2 * bm->numPages) {
+        dropArcGhost(arc, arc->b2.head);
+    }
+    return arcReplace(bm, FALSE);
+}
 
+/*
+ * ARC REPLACE: evict the LRU frame of T1 if T1 is above its target, else the LRU frame of T2,
+ * and remember its page on B1 or B2. Pinned frames are skipped, if one list has only pinned
+ * frames the other one is used.
+ */
+static int arcReplace(BM_BufferPool *const bm, bool pageInB2) {
+    ARCData *arc = bm->mgmtData->strategyData;
+    bool fromT1 = arc->t1.listLen > 0
+                  && ((pageInB2 && arc->t1.listLen == arc->targetT1) || arc->t1.listLen > arc->targetT1);
+    FrameList *list = fromT1 ? &arc->t1 : &arc->t2;
+    int buffId = getUnpinnedFrame(bm, arc->links, list);
+
+    if (buffId == NO_FRAME) {
+        list = fromT1 ? &arc->t2 : &arc->t1;
+        buffId = getUnpinnedFrame(bm, arc->links, list);
+        if (buffId == NO_FRAME)
+            return NO_PAGE;
+    }
+
+    removeFrame(arc->links, list, buffId);
+    // a frame emptied when its file left the pool has no page to remember
+    if (bm->mgmtData->buffPoolHeaders[buffId].pageNumber != NO_PAGE && !bm->mgmtData->probingVictims)
+        addArcGhost(arc, getFrameKey(bm, buffId), list == &arc->t2);
+    return buffId;
+}
+
+// First frame from the head of the list that is not pinned, NO_FRAME if there is none
+static int getUnpinnedFrame(BM_BufferPool *const bm, FrameLinks *links, FrameList *list) {
+    int buffId = list->head;
+
+    while (buffId != NO_FRAME
+           && frameUnavailable(bm, buffId)) {
+        buffId = links->next[buffId];
+    }
+    return buffId;
+}
+
+// Remember an evicted page at the MRU end of B1 or B2
+static void addArcGhost(ARCData *arc, PageKey key, bool toB2) {
+    int slot = popFrameListHead(arc->ghostLinks, &arc->freeGhosts);
+
+    // Only possible while pinned pages keep T1 and T2 from shrinking, forget the oldest ghost
+    if (slot == NO_FRAME) {
+        dropArcGhost(arc, (arc->b1.listLen > 0) ? arc->b1.head : arc->b2.head);
+        slot = popFrameListHead(arc->ghostLinks, &arc->freeGhosts);
+    }
+
+    arc->ghostKey[slot] = key;
+    arc->ghostInB2[slot] = toB2;
+    appendFrame(arc->ghostLinks, toB2 ? &arc->b2 : &arc->b1, slot);
+    insertHashNode(arc->ghostTable, key, slot);
+}
+
+// Forget the page in the given ghost slot
+static void dropArcGhost(ARCData *arc, int slot) {
+    if (slot == NO_FRAME)
+        return;
+    removeFrame(arc->ghostLinks, arc->ghostInB2[slot] ? &arc->b2 : &arc->b1, slot);
+    deleteHashNode(arc->ghostTable, arc->ghostKey[slot]);
+    appendFrame(arc->ghostLinks, &arc->freeGhosts, slot);
+}
+
+/*
+ * 2Q victim selection.
+ * While A1in is above its target size its oldest page is evicted and remembered on A1out,
+ * otherwise the least recently used page of Am is evicted and forgotten.
+ * If the chosen queue holds only pinned pages the other one is used.
+ */
+static int getTwoQVictim(BM_BufferPool *const bm, PageKey key) {
+    TwoQData *twoQ = bm->mgmtData->strategyData;
+    int slot = bm->mgmtData->readingAhead || bm->mgmtData->probingVictims
+               ? -1 : searchHashTable(twoQ->ghostTable, key);
+    int buffId = NO_FRAME;
+
+    if (slot >= 0) {
+        dropTwoQGhost(twoQ, slot);
+        twoQ->loadToAm = TRUE;
+        bm->mgmtData->buffStats.num_recency_ghost_hits += 1;
+    }
+
+    if (twoQ->a1in.listLen > twoQ->maxIn)
+        buffId = getUnpinnedFrame(bm, twoQ->links, &twoQ->a1in);
+
+    if (buffId == NO_FRAME) {
+        buffId = getUnpinnedFrame(bm, twoQ->links, &twoQ->am);
+        if (buffId != NO_FRAME) {
+            removeFrame(twoQ->links, &twoQ->am, buffId);
+            return buffId;
+        }
+        buffId = getUnpinnedFrame(bm, twoQ->links, &twoQ->a1in);
+        if (buffId == NO_FRAME)
+            return NO_PAGE;
+    }
+
+    removeFrame(twoQ->links, &twoQ->a1in, buffId);
+    if (bm->mgmtData->buffPoolHeaders[buffId].pageNumber != NO_PAGE && !bm->mgmtData->probingVictims)
+        addTwoQGhost(twoQ, getFrameKey(bm, buffId));
+    return buffId;
+}
+
+// Remember an evicted page of A1in on A1out, forgetting the oldest one if A1out is full
+static void addTwoQGhost(TwoQData *twoQ, PageKey key) {
+    int slot = popFrameListHead(twoQ->ghostLinks, &twoQ->freeGhosts);
+
+    if (slot == NO_FRAME) {
+        dropTwoQGhost(twoQ, twoQ->a1out.head);
+        slot = popFrameListHead(twoQ->ghostLinks, &twoQ->freeGhosts);
+    }
+    twoQ->ghostKey[slot] = key;
+    appendFrame(twoQ->ghostLinks, &twoQ->a1out, slot);
+    insertHashNode(twoQ->ghostTable, key, slot);
+}
+
+// Forget the page in the given A1out slot
+static void dropTwoQGhost(TwoQData *twoQ, int slot) {
+    removeFrame(twoQ->ghostLinks, &twoQ->a1out, slot);
+    deleteHashNode(twoQ->ghostTable, twoQ->ghostKey[slot]);
+    appendFrame(twoQ->ghostLinks, &twoQ->freeGhosts, slot);
+}
@@ -6,17 +6,24 @@
 #include "storage_mgr.h"
 #include "hash_table.h"
 #include "free_list.h"
+#include "frame_list.h"
+#include "frame_heap.h"
+#include "freq_sketch.h"
 
 // Include bool DT
 #include "dt.h"
 
+#include <pthread.h>
+
 // Replacement Strategies
 typedef enum ReplacementStrategy {
     RS_FIFO = 0,
     RS_LRU = 1,
     RS_CLOCK = 2,
     RS_LFU = 3,
-    RS_LRU_K = 4
+    RS_LRU_K = 4,
+    RS_ARC = 5,
+    RS_2Q = 6
 } ReplacementStrategy;
 
 // Data Types and Structures
@@ -24,6 +31,19 @@ typedef int PageNumber;
 #define NO_PAGE -1
 #define NOT_IN_BUF -1;
 
+/*
+ * A pool caches the pages of one or more page files. A page is identified by a PageKey: the id of
+ * its file in the pool in the high 32 bits and its page number in the low 32 bits.
+ * The file of a pool made by initBufferPool has id 0, so there the keys are the page numbers.
+ */
+typedef long long PageKey;
+#define NO_FILE -1
+#define POOL_MAX_FILES 64
+#define MAKE_PAGE_KEY(fileId, pageNum) ((PageKey) ((unsigned long long) (unsigned int) (fileId) << 32 \
+                                                     | (unsigned int) (pageNum)))
+#define PAGE_KEY_FILE(key) ((int) ((key) >> 32))
+#define PAGE_KEY_PAGE(key) ((PageNumber) (unsigned int) (key))
+
 
 /**
  * The buffer pool has N slots in it.
@@ -32,14 +52,22 @@ typedef int PageNumber;
  * buff_id    : Each slot in the buffer pool is uniquely identified by the buff_id.
  *              It starts from 0
  * pageNumber : The pageNumber that the slot holds.
+ * fileId     : File of the page, the index of its handle in the files of the pool.
  * dirtyPage  :  Indicates whether the page is dirty, i.e, if there are updates are not written to disk yet.
  * pinned     : Indicates if the page in this slot is pinned by user.
+ * refBit     : Reference bit used by the CLOCK strategy. Set on every access,
+ *              cleared when the clock hand passes over the slot.
+ * loading    : The page is being read in to the slot. Threads that pin it wait until the read is done.
+ *              A slot being read ahead has no pin, it is kept from eviction by this flag alone.
  */
 typedef  struct  BM_BufferHeader{
     unsigned int buff_id;
     PageNumber pageNumber;
+    int fileId;
     bool dirtyPage;
     bool pinned;
+    bool refBit;
+    bool loading;
 
 }BufferHeader;
 
@@ -50,44 +78,501 @@ typedef  struct  BM_BufferHeader{
  * num_reads_disk   : Number of read requests that needed to hit the disk.
  * num_writes_disk  : Number of writes made to the disk.
  * num_buff_hits    : Number of read requests that did not need disk I/O.
+ * num_recency_ghost_hits   : Misses on a page that was evicted recently after being used once (ARC: B1, 2Q: A1out).
+ * num_frequency_ghost_hits : Misses on a page that was evicted recently after being used repeatedly (ARC: B2).
+ * num_background_writes    : Writes made by the background writer, they are counted in num_writes_disk too.
+ * num_readahead_pages      : Pages read ahead of a sequential scan, they are counted in num_reads_disk too.
  */
 typedef struct BM_BufferStatistics{
     unsigned int num_reads_disk;
     unsigned int num_writes_disk;
     unsigned int num_buff_hits;
+    unsigned int num_recency_ghost_hits;
+    unsigned int num_frequency_ghost_hits;
+    unsigned int num_background_writes;
+    unsigned int num_readahead_pages;
 }BufferStats;
 
 
+/*
+ * Book-keeping for the FIFO and LRU strategies.
+ * The resident frames in eviction order, by load time for FIFO and by last use for LRU.
+ * The links are indexed by buff_id, so a hit moves its frame to the tail in O(1).
+ *
+ * links : List links of the frames, indexed by buff_id
+ * queue : Resident frames, the head is evicted first
+ */
+typedef struct BM_QueueData{
+    FrameLinks *links;
+    FrameList queue;
+}QueueData;
+
+/*
+ * Book-keeping for the CLOCK (second chance) strategy.
+ *
+ * hand : buff_id of the slot the clock hand currently points to.
+ */
+typedef struct BM_ClockData{
+    unsigned int hand;
+}ClockData;
+
+/*
+ * Optional configuration for the LFU strategy, passed as stratData to initBufferPool.
+ *
+ * maxFreq      : Reference counts saturate at this value. Defaults to LFU_DEFAULT_MAX_FREQ when <= 0.
+ * agingPeriod  : Every agingPeriod references all counts are halved, so that pages which were hot
+ *                once but are not used anymore leave the pool eventually. 0 disables aging.
+ */
+#define LFU_DEFAULT_MAX_FREQ 255
+
+typedef struct BM_LFUConfig{
+    int maxFreq;
+    int agingPeriod;
+}LFUConfig;
+
+/*
+ * Book-keeping for the LFU strategy.
+ * Every resident frame is on exactly one bucket list, the one of its reference count,
+ * ordered from least to most recently used. Hit, load and evict only relink one frame.
+ *
+ * links       : List links of the frames, indexed by buff_id
+ * buckets     : buckets[f] holds the frames referenced f times, 1 <= f <= maxFreq
+ * freq        : Reference count of each frame, indexed by buff_id
+ * minFreq     : No bucket below minFreq holds a frame
+ * numRefs     : References since the counts were aged the last time
+ */
+typedef struct BM_LFUData{
+    FrameLinks *links;
+    FrameList *buckets;
+    int *freq;
+    int minFreq;
+    int maxFreq;
+    int agingPeriod;
+    int numRefs;
+}LFUData;
+
+/*
+ * Optional configuration for the LRU-K strategy, passed as stratData to initBufferPool.
+ *
+ * k                    : Number of past references kept per page. Defaults to LRUK_DEFAULT_K when <= 0.
+ * correlatedRefPeriod  : References to a page at most this many pins after its previous reference are
+ *                        treated as one (correlated) reference, and a page referenced that recently is
+ *                        not evicted if any other page can be. Defaults to LRUK_DEFAULT_CRP when < 0.
+ */
+#define LRUK_DEFAULT_K 2
+#define LRUK_DEFAULT_CRP 1
+
+typedef struct BM_LRUKConfig{
+    int k;
+    int correlatedRefPeriod;
+}LRUKConfig;
+
+/*
+ * Book-keeping for the LRU-K strategy.
+ * Time is a logical clock advanced by every pin. The victim is the page with the largest backward
+ * K-distance, i.e. the oldest K-th most recent reference, pages with less than K references first.
+ *
+ * hist         : hist[buff_id * k + i] is the time of the (i+1)-th most recent uncorrelated reference, 0 if none
+ * last         : Time of the most recent reference of each frame, correlated or not
+ * victimHeap   : Resident frames ordered by eviction priority
+ * skipped      : Scratch space for frames popped from the heap that could not be evicted
+ */
+typedef struct BM_LRUKData{
+    int k;
+    long correlatedRefPeriod;
+    long clock;
+    long *hist;
+    long *last;
+    FrameHeap *victimHeap;
+    int *skipped;
+}LRUKData;
+
+/*
+ * Book-keeping for the ARC (Adaptive Replacement Cache) strategy.
+ * Resident frames are on T1 (seen once recently) or T2 (seen at least twice recently).
+ * B1 and B2 remember the page numbers recently evicted from T1 and T2. A miss on a ghost
+ * moves the target size p of T1 towards the list that would have kept the page.
+ *
+ * links        : List links of the frames for T1 and T2, indexed by buff_id
+ * inT2         : Whether a resident frame is on T2, indexed by buff_id
+ * ghostLinks   : List links of the ghost slots for B1, B2 and the unused slots
+ * ghostKey     : Page remembered in each ghost slot
+ * ghostInB2    : Whether a used ghost slot is on B2
+ * ghostTable   : Maps page key to its ghost slot
+ * targetT1     : The adaptive target size p of T1, 0 <= p <= numPages
+ * loadToT2     : Set when the page being loaded was found on a ghost list
+ */
+typedef struct BM_ARCData{
+    FrameLinks *links;
+    FrameList t1;
+    FrameList t2;
+    bool *inT2;
+    FrameLinks *ghostLinks;
+    FrameList b1;
+    FrameList b2;
+    FrameList freeGhosts;
+    PageKey *ghostKey;
+    bool *ghostInB2;
+    HashTable *ghostTable;
+    int targetT1;
+    bool loadToT2;
+}ARCData;
+
+/*
+ * Optional configuration for the 2Q strategy, passed as stratData to initBufferPool.
+ *
+ * inPercent  : Size of A1in in percent of the pool. Defaults to TWOQ_DEFAULT_IN_PERCENT when <= 0.
+ * outPercent : Number of page numbers A1out remembers, in percent of the pool size.
+ *              Defaults to TWOQ_DEFAULT_OUT_PERCENT when <= 0.
+ */
+#define TWOQ_DEFAULT_IN_PERCENT 25
+#define TWOQ_DEFAULT_OUT_PERCENT 50
+
+typedef struct BM_TwoQConfig{
+    int inPercent;
+    int outPercent;
+}TwoQConfig;
+
+/*
+ * Book-keeping for the 2Q strategy.
+ * A page read in for the first time goes to the probationary FIFO A1in. Further hits while it
+ * is there are treated as one correlated burst. When it leaves A1in only its page number is kept
+ * on the ghost FIFO A1out, and a miss on a page found there loads it in to the main LRU Am.
+ * A sequential scan therefore only cycles through A1in and leaves the pages of Am alone.
+ *
+ * links        : List links of the frames for A1in and Am, indexed by buff_id
+ * inAm         : Whether a resident frame is on Am, indexed by buff_id
+ * maxIn        : Target size of A1in, older A1in pages are evicted first while A1in is larger
+ * ghostLinks   : List links of the ghost slots for A1out and the unused slots
+ * ghostKey     : Page remembered in each ghost slot
+ * ghostTable   : Maps page key to its ghost slot
+ * loadToAm     : Set when the page being loaded was found on A1out
+ */
+typedef struct BM_TwoQData{
+    FrameLinks *links;
+    FrameList a1in;
+    FrameList am;
+    bool *inAm;
+    int maxIn;
+    FrameLinks *ghostLinks;
+    FrameList a1out;
+    FrameList freeGhosts;
+    PageKey *ghostKey;
+    HashTable *ghostTable;
+    bool loadToAm;
+}TwoQData;
+
+/*
+ * TinyLFU admission filter, works in front of any replacement strategy.
+ * Newly read pages first go to a small LRU admission window that the strategy does not see.
+ * When the window is full its oldest page competes with the victim the strategy would evict:
+ * it only replaces that victim if the sketch estimates it was requested more often,
+ * otherwise it is evicted itself. Pages requested only once never push out the working set.
+ *
+ * sketch       : Estimated request frequency of the pages, updated on every pin
+ * links        : List links of the window frames, indexed by buff_id
+ * window       : Frames of the admission window, least recently used first
+ * inWindow     : Whether a frame is in the window (and not managed by the strategy)
+ * windowSize   : Number of frames in the window once the pool is full
+ * loadToWindow : Whether the page being loaded goes to the window
+ * victimFromWindow : Whether the last slot handed out for replacement came from the window
+ */
+#define ADMISSION_DEFAULT_WINDOW_PERCENT 1
+
+typedef struct BM_AdmissionData{
+    FreqSketch *sketch;
+    FrameLinks *links;
+    FrameList window;
+    bool *inWindow;
+    int windowSize;
+    bool loadToWindow;
+    bool victimFromWindow;
+}AdmissionData;
+
+/*
+ * One lock striped slice of the page table. Page pageNum of file fileId lives in partition
+ * (pageNum + fileId) % PAGE_TABLE_PARTITIONS, so page 0 of every file does not land in the same one.
+ * Pins of pages in different partitions never wait for each other.
+ * Hits on its pages are buffered here and handed to the strategy in batches, so that a hit does not
+ * wait for strategyLock: once HIT_BATCH_SIZE are buffered if strategyLock is free, before a victim is
+ * picked, and waiting for strategyLock only when HIT_BUFFER_SIZE are buffered.
+ *
+ * lock    : Protects the table, the buffered hits and the loading flag of the frames it maps
+ * ioDone  : Broadcast when a frame mapped by this partition finished loading
+ * table   : Maps PageKey to buffer slot
+ * numHits : Number of buffered hits, only changed with atomic operations
+ * hits    : The buffered hits
+ */
+#define PAGE_TABLE_PARTITIONS 16
+#define HIT_BATCH_SIZE 32
+#define HIT_BUFFER_SIZE 64
+
+/*
+ * A hit waiting in the buffer of a partition.
+ *
+ * stamp  : Order of the hit among the hits of the pool
+ * buffId : The frame that was hit
+ * key    : The page it held, a frame that holds another page by now is skipped
+ */
+typedef struct BM_BufferedHit{
+    unsigned long stamp;
+    int buffId;
+    PageKey key;
+}BufferedHit;
+
+typedef struct BM_PageTablePartition{
+    pthread_mutex_t lock;
+    pthread_cond_t ioDone;
+    HashTable *table;
+    int numHits;
+    BufferedHit hits[HIT_BUFFER_SIZE];
+}PageTablePartition;
+
+/*
+ * A dirty frame collected by forceFlushPool, frames are sorted by page so contiguous pages are written together.
+ *
+ * key     : Page in the frame
+ * buffId  : Frame, pinned until it is written
+ * cleared : Whether the write cleared the dirty flag, so a failed write can set it again
+ */
+typedef struct BM_FlushEntry{
+    PageKey key;
+    int buffId;
+    bool cleared;
+}FlushEntry;
+
+/*
+ * A page of a pinPages batch, the batch is sorted by page so misses are read in page order.
+ *
+ * pageNum : Page to pin
+ * index   : Position of the page in the batch, i.e. of its page handle
+ * buffId  : Frame the page is pinned in, NO_PAGE while it is not
+ * reading : The frame was taken for the page by the batch and is read by it
+ */
+typedef struct BM_BatchEntry{
+    PageNumber pageNum;
+    int index;
+    int buffId;
+    bool reading;
+}BatchEntry;
+
+/*
+ * Optional configuration of the background writer, passed to startBackgroundWriter.
+ * Values <= 0 select the defaults.
+ *
+ * cleanPercent     : Percent of the evictable (unpinned) frames the writer keeps clean
+ * lowWatermark     : While fewer than this percent of the frames are dirty the writer leaves them alone,
+ *                    so pages written again and again are not written out every time
+ * highWatermark    : Once this percent of the frames are dirty the writer flushes down to lowWatermark
+ *                    without pausing between rounds
+ * intervalMillis   : Pause between two rounds
+ * maxPagesPerRound : Most pages written in one round
+ */
+#define BGWRITER_DEFAULT_CLEAN_PERCENT 50
+#define BGWRITER_DEFAULT_LOW_WATERMARK 10
+#define BGWRITER_DEFAULT_HIGH_WATERMARK 50
+#define BGWRITER_DEFAULT_INTERVAL_MILLIS 20
+#define BGWRITER_DEFAULT_MAX_PAGES 64
+
+typedef struct BM_BgWriterConfig{
+    int cleanPercent;
+    int lowWatermark;
+    int highWatermark;
+    int intervalMillis;
+    int maxPagesPerRound;
+}BgWriterConfig;
+
+/*
+ * State of the background writer thread of a pool.
+ * Every round it writes dirty, unpinned frames, those the strategy evicts next first where it can tell,
+ * until cleanPercent of the evictable frames are clean. A pin that still finds a dirty victim wakes it early.
+ *
+ * thread   : The writer thread
+ * lock     : Protects stop and wakeUp
+ * wakeUp   : Signalled to end the pause between rounds
+ * stop     : Set to make the thread exit
+ * kicked   : A pin had to write a dirty victim itself since the last round
+ * cursor   : Frame the next sweep over the frames starts at, for strategies without an eviction order to follow
+ * cleanPercent .. maxPagesPerRound : The configuration, with the defaults filled in
+ * batch    : Frames picked in a round, maxPagesPerRound entries
+ */
+typedef struct BM_BgWriterData{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeUp;
+    bool stop;
+    bool kicked;
+    int cursor;
+    int cleanPercent;
+    int lowWatermark;
+    int highWatermark;
+    int intervalMillis;
+    int maxPagesPerRound;
+    FlushEntry *batch;
+}BgWriterData;
+
+/*
+ * State of the read-ahead thread of a pool.
+ * Pins of consecutive pages form a sequential run. Once a run is READAHEAD_MIN_RUN pages long, the next
+ * numPages pages are requested, and the next window again whenever less than half a window is left ahead
+ * of the run. The thread reads a window in to free or clean unpinned frames, contiguous pages with one
+ * call, and never pins them: a pin of a page still being read waits for it like for any other read.
+ * Pins of the same page again do not break a run, pins of any other page start a new one.
+ *
+ * Runs are followed by page key, so a run ends where pins move to another file of the pool.
+ *
+ * thread     : The read-ahead thread
+ * lock       : Protects everything below but numPages, frames and pages
+ * wakeUp     : Signalled when pages are requested or the thread has to stop
+ * idle       : Signalled when the thread is done with a window
+ * stop       : Set to make the thread exit
+ * lastKey    : Page pinned last
+ * runLength  : Number of consecutive pages pinned, ending with lastKey
+ * issuedUpTo : Last page of the run requested so far
+ * startKey   : First requested page the thread has not taken yet
+ * endKey     : Last requested page, no pages are requested while endKey < startKey
+ * busyFile   : File of the window the thread is reading, NO_FILE while it waits
+ * numPages   : Pages per window, at most half of the pool
+ * frames     : Frames of the window being read, numPages entries, NO_PAGE for pages already in the pool
+ * pages      : Data of the frames of a run, numPages entries
+ */
+#define READAHEAD_DEFAULT_PAGES 8
+#define READAHEAD_MIN_RUN 2
+
+typedef struct BM_ReadAheadData{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeUp;
+    pthread_cond_t idle;
+    bool stop;
+    PageKey lastKey;
+    int runLength;
+    PageKey issuedUpTo;
+    PageKey startKey;
+    PageKey endKey;
+    int busyFile;
+    int numPages;
+    int *frames;
+    char **pages;
+}ReadAheadData;
+
+/*
+ * Priority classes of the files of a pool, pages of a higher class are evicted last.
+ */
+typedef enum PoolPriority {
+    PRIORITY_HEAP = 0,
+    PRIORITY_METADATA = 1,
+    PRIORITY_INDEX = 2
+} PoolPriority;
+
+/*
+ * Quotas of the files of a pool, set with setPoolFileQuota.
+ * Victims the strategy hands out are ranked, the first one that keeps every quota is taken:
+ *  - a page of another file is not evicted while that file holds no more than its reservation,
+ *    and a file at its cap only replaces its own pages,
+ *  - a page of a file of a higher class than the file of the missing page is only evicted if no page of
+ *    the same or a lower class can go.
+ * Frames holding no page, pages of the file itself and pages of files over their cap always can go.
+ * Only the first QUOTA_MAX_CANDIDATES victims are looked at. Reservations and caps are soft: if none of
+ * them keeps the quotas the best ranked one is taken anyway, a pin never fails because of them.
+ *
+ * minPages   : Frames reserved for each file id
+ * maxPages   : Most frames each file id may hold
+ * priority   : Class of each file id
+ * heldBack   : Frames the victim search took from the strategy and set aside, numPages entries
+ * candidates : Those frames in the order they were taken
+ * fromWindow : Whether each of them came from the admission window
+ */
+// Victims are ranked 0 (keeps every quota) to QUOTA_RANKS - 1 (breaks a reservation or a cap)
+#define QUOTA_RANKS 3
+#define QUOTA_MAX_CANDIDATES 8
+
+typedef struct BM_QuotaData{
+    int minPages[POOL_MAX_FILES];
+    int maxPages[POOL_MAX_FILES];
+    PoolPriority priority[POOL_MAX_FILES];
+    bool *heldBack;
+    int candidates[QUOTA_MAX_CANDIDATES];
+    bool fromWindow[QUOTA_MAX_CANDIDATES];
+}QuotaData;
+
 /*
  * This structure holds book-keeping information for the buffer pool
  *
- * fHandle          : File handle from which buffer manager reads/Writes
+ * files            : Handles of the page files the pool caches, POOL_MAX_FILES entries indexed by file id,
+ *                    NULL for unused ids
+ * numFiles         : Number of files in files
+ * fileFrames       : Number of frames holding a page of each file id, only changed with atomic operations
+ * owner            : The handle the pool was made with, its background threads run on it
  * buffPoolAddr     : Holds the pointer to the starting address in memory where the buffer pool stores the pages.
+ * pageSize         : Bytes per frame, the page size of all files of the pool
  * buffPoolHeaders  : Pointer to array of headers of length equal to number of slots in buffer pool
  * buffStats        : Holds statistics of the buffer pool
- * buffTable        : Maps PageNumber to buffer slot
+ * buffTable        : Page table, PAGE_TABLE_PARTITIONS partitions mapping PageKey to buffer slot
+ * hitClock         : Stamps the buffered hits, only changed with atomic operations
+ * hitBatch         : Room for the buffered hits of all partitions, sorted by stamp before they are handed on
  * freeBuffList     : List of empty buffers in Buffer pool
  * fixCount         : Array of size equal to number of buffer slots, when tells how many clients are using this page.
+ *                    Only changed with atomic operations.
  * strategyData     : Pointer to data that would be needed by the Page replacement strategy
+ * admission        : TinyLFU admission filter, NULL unless enabled with enableAdmissionFilter
+ * bgWriter         : Background writer, NULL unless started with startBackgroundWriter
+ * readAhead        : Sequential read-ahead, NULL unless started with startReadAhead
+ * quotas           : Quotas of the files, NULL unless set with setPoolFileQuota
+ * readingAhead     : Set while read-ahead picks victims, ARC and 2Q then treat the page as never seen before
+ * probingVictims   : Set while the quota search picks victims that may go back, the strategies then
+ *                    leave their ghost lists and reference bits alone
+ * strategyLock     : Protects strategyData, admission, quotas, the two flags above and freeBuffList,
+ *                    i.e. everything that picks victims
+ * ioLock           : Serializes growing the page files, changing their free pages and changing files,
+ *                    pages are read and written with positional I/O without it
+ *
+ * pinPage, unpinPage, markDirty and forcePage can be called from many threads at once.
+ * A pinned frame (fixCount > 0) is never evicted, so the hit path only needs the lock of one partition.
+ * A frame is only taken from the page table while holding the lock of its partition and seeing fixCount == 0.
+ * Locks are taken in the order strategyLock, partition lock, ioLock. Pages are read and written holding no lock.
+ * The locks of the background writer and of read-ahead are only taken holding no other lock.
  */
 typedef struct BM_MgmtData {
-    SM_FileHandle *fHandle;
+    SM_FileHandle **files;
+    int numFiles;
+    int *fileFrames;
+    struct BM_BufferPool *owner;
     char *buffPoolAddr;
+    int pageSize;
     BufferHeader* buffPoolHeaders;
     BufferStats buffStats;
-    HashTable * buffTable;
+    PageTablePartition * buffTable;
+    unsigned long hitClock;
+    BufferedHit * hitBatch;
     FreeList * freeBuffList;
     int * fixCount;
     void * strategyData;
+    AdmissionData * admission;
+    BgWriterData * bgWriter;
+    ReadAheadData * readAhead;
+    QuotaData * quotas;
+    bool readingAhead;
+    bool probingVictims;
+    pthread_mutex_t strategyLock;
+    pthread_mutex_t ioLock;
 } BM_MgmtData;
 
 
+/*
+ * A handle on a pool and one of its files. initBufferPool makes a pool for one file, initSharedBufferPool a pool
+ * without files that many handles share: openPoolFile adds a file to it and fills in a handle for that file.
+ * Pages are pinned, allocated and freed in the file of the handle, frames are replaced over all files.
+ *
+ * fileId : Id of the file of the handle in the pool, NO_FILE for the handle of a shared pool itself
+ */
 typedef struct BM_BufferPool {
     char *pageFile;
     int numPages;
     ReplacementStrategy strategy;
     BM_MgmtData *mgmtData; // use this one to store the bookkeeping info your buffer
     // manager needs for a buffer pool
+    int fileId;
 } BM_BufferPool;
 
 
@@ -107,9 +592,31 @@ typedef struct BM_PageHandle {
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
                   const int numPages, ReplacementStrategy strategy,
                   void *stratData);
+RC initBufferPoolIOMode(BM_BufferPool *const bm, const char *const pageFileName, const int numPages,
+                        ReplacementStrategy strategy, void *stratData, SM_IOMode ioMode);
+
+// A pool of numPages frames of PAGE_SIZE bytes for the files added with openPoolFile
+RC initSharedBufferPool(BM_BufferPool *const bm, const int numPages, ReplacementStrategy strategy, void *stratData);
+// Add pageFileName to the pool of pool, bm becomes the handle for the file. Shut bm down to remove the file again.
+RC openPoolFile(BM_BufferPool *const bm, BM_BufferPool *const pool, const char *const pageFileName);
 
+// Shutting down the handle of a file added with openPoolFile writes and drops the pages of the file only,
+// a pool itself is shut down once all files added to it are removed again
 RC shutdownBufferPool(BM_BufferPool *const bm);
 
+RC enableAdmissionFilter(BM_BufferPool *const bm, int windowPercent);
+
+// Flush dirty frames ahead of demand on a thread of the pool, config NULL selects the defaults
+RC startBackgroundWriter(BM_BufferPool *const bm, BgWriterConfig *config);
+RC stopBackgroundWriter(BM_BufferPool *const bm);
+
+// Read the pages after a sequential run of pins ahead on a thread of the pool, numPages <= 0 selects the default
+RC startReadAhead(BM_BufferPool *const bm, int numPages);
+RC stopReadAhead(BM_BufferPool *const bm);
+
+// Reserve minPages frames for the file of bm, cap it at maxPages (<= 0 for no cap) and set its class
+RC setPoolFileQuota(BM_BufferPool *const bm, int minPages, int maxPages, PoolPriority priority);
+
 RC forceFlushPool(BM_BufferPool *const bm);
 
 // Buffer Manager Interface Access Pages
@@ -122,6 +629,11 @@ RC forcePage(BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage(BM_BufferPool *const bm, BM_PageHandle *const page,
            const PageNumber pageNum);
 
+// Pin pageNums[i] in to pages[i] for the numPages pages, all of them or none
+RC pinPages(BM_BufferPool *const bm, BM_PageHandle *const pages, const PageNumber *pageNums, int numPages);
+
+RC unpinPages(BM_BufferPool *const bm, BM_PageHandle *const pages, int numPages);
+
 // Statistics Interface
 PageNumber *getFrameContents(BM_BufferPool *const bm);
 
@@ -133,5 +645,26 @@ int getNumReadIO(BM_BufferPool *const bm);
 
 int getNumWriteIO(BM_BufferPool *const bm);
 
+int getNumRecencyGhostHits(BM_BufferPool *const bm);
+
+int getNumFrequencyGhostHits(BM_BufferPool *const bm);
+
+int getNumBackgroundWrites(BM_BufferPool *const bm);
+
+int getNumReadAheadPages(BM_BufferPool *const bm);
+
+int getArcTargetSize(BM_BufferPool *const bm);
+
 int getNumPagesInFile(BM_BufferPool *const bm);
+
+// Number of frames of the pool holding pages of the file of bm
+int getNumPoolFileFrames(BM_BufferPool *const bm);
+
+// Bytes per page of the pool's page file, the size of BM_PageHandle.data
+int getPoolPageSize(BM_BufferPool *const bm);
+
+// Reusing pages of the page file, see allocatePage and freePage in storage_mgr.h
+RC allocatePoolPage(BM_BufferPool *const bm, PageNumber *pageNum);
+RC freePoolPage(BM_BufferPool *const bm, PageNumber pageNum);
+bool isPoolPageFree(BM_BufferPool *const bm, PageNumber pageNum);
 #endif
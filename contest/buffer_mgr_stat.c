@@ -98,6 +98,12 @@ printStrat (BM_BufferPool *const bm)
     case RS_LRU_K:
       printf("LRU-K");
       break;
+    case RS_ARC:
+      printf("ARC");
+      break;
+    case RS_2Q:
+      printf("2Q");
+      break;
     default:
       printf("%i", bm->strategy);
       break;
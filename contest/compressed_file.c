@@ -0,0 +1,324 @@
+#define _GNU_SOURCE
+
+#include "compressed_file.h"
+#include "lz_codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+/*
+ * Book-keeping of a compressed page file.
+ *
+ * lock      : Protects slots, chunkMap and chunkHint. Pages are read and written without it.
+ * mapFd     : File descriptor of the page map
+ * slots     : The page map, one slot per page
+ * numSlots  : Slots allocated, at least the number of pages
+ * chunkMap  : Bitmap of the chunks in use, chunks past its end are free
+ * mapBytes  : Bytes allocated for chunkMap
+ * chunkHint : No chunk before it is free
+ */
+struct SM_Compression {
+    pthread_mutex_t lock;
+    int mapFd;
+    SM_PageSlot *slots;
+    int numSlots;
+    unsigned char *chunkMap;
+    int mapBytes;
+    int chunkHint;
+};
+
+static int getNumChunks(int length);
+static off_t getChunkOffset(SM_FileHandle *fHandle, unsigned int chunk);
+static RC reserveSlots(SM_Compression *compression, int numPages);
+static RC reserveChunkMap(SM_Compression *compression, int numChunks);
+static void markChunks(SM_Compression *compression, int chunk, int numChunks, bool inUse);
+static int allocateChunks(SM_Compression *compression, int numChunks);
+static RC storeSlot(SM_Compression *compression, int pageNum, SM_PageSlot slot);
+
+char *getPageMapName(const char *fileName) {
+    char *name = malloc(strlen(fileName) + 6);
+    sprintf(name, "%s.pmap", fileName);
+    return name;
+}
+
+RC createPageMap(const char *fileName) {
+    char *mapName = getPageMapName(fileName);
+    int fd = open(mapName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    free(mapName);
+    if (fd < 0) {
+        return RC_CREATE_FAILED;
+    }
+
+    int rc = ftruncate(fd, sizeof(SM_PageSlot));
+    close(fd);
+    return rc == 0 ? RC_OK : RC_CREATE_FAILED;
+}
+
+RC openCompressedFile(SM_FileHandle *fHandle) {
+    SM_Compression *compression = calloc(1, sizeof(SM_Compression));
+    struct stat st;
+    int i;
+
+    char *mapName = getPageMapName(fHandle->fileName);
+    compression->mapFd = open(mapName, O_RDWR);
+    free(mapName);
+    if (compression->mapFd < 0 || fstat(compression->mapFd, &st) != 0) {
+        if (compression->mapFd >= 0) {
+            close(compression->mapFd);
+        }
+        free(compression);
+        return RC_OPEN_FAILED;
+    }
+
+    int numPages = (int) (st.st_size / sizeof(SM_PageSlot));
+    if (reserveSlots(compression, numPages) != RC_OK
+        || readFully(compression->mapFd, (char *) compression->slots, (size_t) numPages * sizeof(SM_PageSlot), 0) != RC_OK) {
+        close(compression->mapFd);
+        free(compression->slots);
+        free(compression);
+        return RC_OPEN_FAILED;
+    }
+
+    // every chunk a page points to is in use, the others are free
+    for (i = 0; i < numPages; ++i) {
+        SM_PageSlot slot = compression->slots[i];
+        if (slot.length > 0) {
+            int numChunks = getNumChunks((int) slot.length);
+            if (reserveChunkMap(compression, (int) slot.chunk + numChunks) != RC_OK) {
+                close(compression->mapFd);
+                free(compression->slots);
+                free(compression->chunkMap);
+                free(compression);
+                return RC_OPEN_FAILED;
+            }
+            markChunks(compression, (int) slot.chunk, numChunks, TRUE);
+        }
+    }
+    compression->chunkHint = 0;
+    pthread_mutex_init(&compression->lock, NULL);
+
+    fHandle->totalNumPages = numPages;
+    fHandle->mgmtInfo->compression = compression;
+    return RC_OK;
+}
+
+void closeCompressedFile(SM_FileHandle *fHandle) {
+    SM_Compression *compression = fHandle->mgmtInfo->compression;
+
+    pthread_mutex_destroy(&compression->lock);
+    close(compression->mapFd);
+    free(compression->slots);
+    free(compression->chunkMap);
+    free(compression);
+    fHandle->mgmtInfo->compression = NULL;
+}
+
+RC readCompressedPage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage) {
+    SM_Compression *compression = fHandle->mgmtInfo->compression;
+    int pageSize = fHandle->mgmtInfo->pageSize;
+
+    pthread_mutex_lock(&compression->lock);
+    SM_PageSlot slot = compression->slots[pageNum];
+    pthread_mutex_unlock(&compression->lock);
+
+    if (slot.length == 0) {
+        memset(memPage, 0, (size_t) pageSize);
+        return RC_OK;
+    }
+    off_t offset = getChunkOffset(fHandle, slot.chunk);
+    if (slot.length == (unsigned int) pageSize) {
+        return readFully(fHandle->mgmtInfo->fd, memPage, (size_t) pageSize, offset);
+    }
+
+    char *compressed = malloc(slot.length);
+    RC rc = readFully(fHandle->mgmtInfo->fd, compressed, slot.length, offset);
+    if (rc == RC_OK && lzDecompress(compressed, (int) slot.length, memPage, pageSize) != pageSize) {
+        rc = RC_READ_FAILED;
+    }
+    free(compressed);
+    return rc;
+}
+
+/*
+ * Compress the page and write it to its chunks. A page that does not save at least one chunk is stored as is.
+ * The page map is changed once the page is written, so a failed write leaves the old page readable
+ * unless it was rewritten in place.
+ */
+RC writeCompressedPage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage) {
+    SM_Compression *compression = fHandle->mgmtInfo->compression;
+    int pageSize = fHandle->mgmtInfo->pageSize;
+
+    char *compressed = malloc(LZ_MAX_COMPRESSED_SIZE(pageSize));
+    char *data = compressed;
+    int length = lzCompress(memPage, pageSize, compressed, pageSize - SM_CHUNK_SIZE);
+    if (length == 0) {
+        data = memPage;
+        length = pageSize;
+    }
+    int numChunks = getNumChunks(length);
+
+    pthread_mutex_lock(&compression->lock);
+    SM_PageSlot old = compression->slots[pageNum];
+    int oldChunks = old.length > 0 ? getNumChunks((int) old.length) : 0;
+    int chunk;
+    if (numChunks <= oldChunks) {
+        chunk = (int) old.chunk;
+    } else {
+        chunk = allocateChunks(compression, numChunks);
+    }
+    pthread_mutex_unlock(&compression->lock);
+
+    RC rc = chunk < 0 ? RC_WRITE_FAILED
+                      : writeFully(fHandle->mgmtInfo->fd, data, (size_t) length, getChunkOffset(fHandle, (unsigned int) chunk));
+    free(compressed);
+
+    pthread_mutex_lock(&compression->lock);
+    if (rc == RC_OK) {
+        SM_PageSlot slot = {(unsigned int) chunk, (unsigned int) length};
+        rc = storeSlot(compression, pageNum, slot);
+    }
+    if (numChunks <= oldChunks) {
+        // the page shrank in place, the old slot covers its tail until the new one is stored
+        if (rc == RC_OK) {
+            markChunks(compression, chunk + numChunks, oldChunks - numChunks, FALSE);
+        }
+    } else if (chunk >= 0) {
+        // the page moved, free the run it left, or the new run if it could not be used
+        if (rc == RC_OK) {
+            markChunks(compression, (int) old.chunk, oldChunks, FALSE);
+        } else {
+            markChunks(compression, chunk, numChunks, FALSE);
+        }
+    }
+    pthread_mutex_unlock(&compression->lock);
+    return rc;
+}
+
+RC growCompressedFile(SM_FileHandle *fHandle, int numPages) {
+    SM_Compression *compression = fHandle->mgmtInfo->compression;
+
+    pthread_mutex_lock(&compression->lock);
+    RC rc = reserveSlots(compression, numPages);
+    if (rc == RC_OK && ftruncate(compression->mapFd, (off_t) numPages * (off_t) sizeof(SM_PageSlot)) != 0) {
+        rc = RC_ALLOCATION_FAILED;
+    }
+    pthread_mutex_unlock(&compression->lock);
+    return rc;
+}
+
+RC releaseCompressedPage(SM_FileHandle *fHandle, int pageNum) {
+    SM_Compression *compression = fHandle->mgmtInfo->compression;
+    SM_PageSlot empty = {0, 0};
+
+    pthread_mutex_lock(&compression->lock);
+    SM_PageSlot old = compression->slots[pageNum];
+    RC rc = storeSlot(compression, pageNum, empty);
+    if (rc == RC_OK && old.length > 0) {
+        markChunks(compression, (int) old.chunk, getNumChunks((int) old.length), FALSE);
+    }
+    pthread_mutex_unlock(&compression->lock);
+    return rc;
+}
+
+static int getNumChunks(int length) {
+    return (length + SM_CHUNK_SIZE - 1) / SM_CHUNK_SIZE;
+}
+
+static off_t getChunkOffset(SM_FileHandle *fHandle, unsigned int chunk) {
+    return (off_t) fHandle->mgmtInfo->headerSize + (off_t) chunk * SM_CHUNK_SIZE;
+}
+
+// Make room for numPages slots, the new ones are empty pages
+static RC reserveSlots(SM_Compression *compression, int numPages) {
+    if (numPages <= compression->numSlots) {
+        return RC_OK;
+    }
+    int newSlots = compression->numSlots * 2 > numPages ? compression->numSlots * 2 : numPages;
+    SM_PageSlot *slots = realloc(compression->slots, (size_t) newSlots * sizeof(SM_PageSlot));
+    if (slots == NULL) {
+        return RC_ALLOCATION_FAILED;
+    }
+    memset(slots + compression->numSlots, 0, (size_t) (newSlots - compression->numSlots) * sizeof(SM_PageSlot));
+    compression->slots = slots;
+    compression->numSlots = newSlots;
+    return RC_OK;
+}
+
+// Make chunkMap cover numChunks chunks
+static RC reserveChunkMap(SM_Compression *compression, int numChunks) {
+    int bytes = (numChunks + 7) / 8;
+    if (bytes <= compression->mapBytes) {
+        return RC_OK;
+    }
+    int newBytes = compression->mapBytes * 2 > bytes ? compression->mapBytes * 2 : bytes;
+    unsigned char *chunkMap = realloc(compression->chunkMap, (size_t) newBytes);
+    if (chunkMap == NULL) {
+        return RC_ALLOCATION_FAILED;
+    }
+    memset(chunkMap + compression->mapBytes, 0, (size_t) (newBytes - compression->mapBytes));
+    compression->chunkMap = chunkMap;
+    compression->mapBytes = newBytes;
+    return RC_OK;
+}
+
+static void markChunks(SM_Compression *compression, int chunk, int numChunks, bool inUse) {
+    int i;
+
+    for (i = chunk; i < chunk + numChunks; ++i) {
+        if (inUse) {
+            compression->chunkMap[i / 8] |= (unsigned char) (1 << (i % 8));
+        } else {
+            compression->chunkMap[i / 8] &= (unsigned char) ~(1 << (i % 8));
+        }
+    }
+    if (!inUse && numChunks > 0 && chunk < compression->chunkHint) {
+        compression->chunkHint = chunk;
+    }
+}
+
+// First fit: the first run of numChunks free chunks, at the end of the file if no run between pages fits
+static int allocateChunks(SM_Compression *compression, int numChunks) {
+    int start = compression->chunkHint;
+    int chunk = start;
+
+    while (chunk < start + numChunks) {
+        if (chunk / 8 >= compression->mapBytes) {
+            break;
+        }
+        if (chunk % 8 == 0 && compression->chunkMap[chunk / 8] == 0xff) {
+            chunk += 8;
+            start = chunk;
+        } else if (compression->chunkMap[chunk / 8] & (1 << (chunk % 8))) {
+            chunk++;
+            start = chunk;
+        } else {
+            chunk++;
+        }
+    }
+
+    if (reserveChunkMap(compression, start + numChunks) != RC_OK) {
+        return -1;
+    }
+    if (start == compression->chunkHint) {
+        compression->chunkHint = start + numChunks;
+    }
+    markChunks(compression, start, numChunks, TRUE);
+    return start;
+}
+
+// Set the slot of pageNum and write it to the page map
+static RC storeSlot(SM_Compression *compression, int pageNum, SM_PageSlot slot) {
+    SM_PageSlot old = compression->slots[pageNum];
+
+    compression->slots[pageNum] = slot;
+    if (writeFully(compression->mapFd, (char *) &compression->slots[pageNum], sizeof(SM_PageSlot),
+                   (off_t) pageNum * (off_t) sizeof(SM_PageSlot)) != RC_OK) {
+        compression->slots[pageNum] = old;
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
@@ -0,0 +1,58 @@
+#ifndef COMPRESSED_FILE_H
+#define COMPRESSED_FILE_H
+
+#include "storage_mgr.h"
+#include <sys/types.h>
+
+/*
+ * Pages of a compressed page file (createCompressedPageFile) are compressed with lz_codec when written
+ * and decompressed when read. After the file header the file is a heap of SM_CHUNK_SIZE byte chunks,
+ * a page takes a run of as many chunks as its compressed size needs:
+ *
+ *      | header | chunk 0 | chunk 1 | chunk 2 | ... |
+ *                 \__ page 3 ___/    \ page 0 /
+ *
+ * The page map, kept in fileName.pmap, has one SM_PageSlot per page telling where the page is.
+ * A page rewritten to a smaller size stays in place, a larger one moves to the first run of free chunks
+ * that fits. The chunks not named by the page map are free, they are found again when the file is opened.
+ *
+ * These are called by the storage manager, the other calls on a page file work as on any page file.
+ * Reads and writes from several threads are safe as long as no two of them are on the same page at once,
+ * which the buffer manager guarantees.
+ */
+
+#define SM_CHUNK_SIZE 512
+
+/*
+ * Place of one page in a compressed file
+ *
+ * chunk  : First chunk of the page
+ * length : Bytes stored. 0 for a page never written, it reads as zeros.
+ *          The page size for a page that did not compress, it is stored as is.
+ */
+typedef struct SM_PageSlot {
+    unsigned int chunk;
+    unsigned int length;
+} SM_PageSlot;
+
+// pread/pwrite until all of size is moved, from storage_mgr.c
+extern RC readFully(int fd, char *memPage, size_t size, off_t offset);
+extern RC writeFully(int fd, char *memPage, size_t size, off_t offset);
+
+// Name of the page map of fileName
+extern char *getPageMapName(const char *fileName);
+// Create the page map of a new compressed file holding one empty page
+extern RC createPageMap(const char *fileName);
+
+// Read the page map and set up fHandle->mgmtInfo->compression, totalNumPages is set to the pages in the map
+extern RC openCompressedFile(SM_FileHandle *fHandle);
+extern void closeCompressedFile(SM_FileHandle *fHandle);
+
+extern RC readCompressedPage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage);
+extern RC writeCompressedPage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage);
+// Add empty pages to the page map up to numPages, nothing is written to the file
+extern RC growCompressedFile(SM_FileHandle *fHandle, int numPages);
+// Free the chunks of a page, it reads as zeros again
+extern RC releaseCompressedPage(SM_FileHandle *fHandle, int pageNum);
+
+#endif
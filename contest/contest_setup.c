@@ -8,6 +8,7 @@
 #include "btree_mgr.h"
 
 BM_BufferPool *bm;
+static BM_BufferPool sharedPool;
 int BTREE_BUFF_SIZE;
 int RM_BUFF_SIZE;
 /* set up record, buffer, pagefile, and index managers */
@@ -15,12 +16,17 @@ RC
 setUpContest (int numPages)
 {
   initStorageManager();
-  initRecordManager(NULL);
-    initIndexManager (NULL);
     BTREE_BUFF_SIZE = (int) (numPages * 0.3);
     RM_BUFF_SIZE = (int) (numPages);
     #define CONTEST_SETUP
 
+    // tables and indexes cache their pages in one pool, as large as a pool of each
+    RC rc = initSharedBufferPool(&sharedPool, RM_BUFF_SIZE + BTREE_BUFF_SIZE, RS_LRU, NULL);
+    if (rc != RC_OK)
+        return rc;
+  initRecordManager(&sharedPool);
+    initIndexManager (&sharedPool);
+
   return RC_OK;
 }
 
@@ -30,7 +36,7 @@ shutdownContest (void)
 {
   shutdownRecordManager();
     shutdownIndexManager();
-  return RC_OK;
+  return shutdownBufferPool(&sharedPool);
 }
 
 /* return the total number of I/O operations used after setUpContest */
@@ -4,6 +4,7 @@
 #include "stdio.h"
 
 /* module wide constants */
+// default page size, a page file can be created with another one (see createPageFileWithPageSize)
 #define PAGE_SIZE 4096
 
 /* return code definitions */
@@ -19,11 +20,18 @@ typedef int RC;
 #define RC_OPEN_FAILED -6
 #define RC_READ_FAILED -7
 #define RC_ALLOCATION_FAILED -8
+#define RC_FILE_NOT_MAPPED -18
+#define RC_ASYNC_QUEUE_FULL -19
+#define RC_INVALID_PAGE_SIZE -20
+#define RC_PAGE_ALREADY_FREE -21
+#define RC_ASYNC_IO_FAILED -22
 
 #define RC_BUFF_SHUT_FAILED -9
 #define RC_FLUSH_FAILED -10
 #define RC_DIRTY_FAILED -11
 #define RC_UNPIN_FAILED -12
+#define RC_BUFF_STRATEGY_NOT_SUPPORTED -16
+#define RC_BUFF_POOL_IN_USE -17
 
 #define RC_RM_INIT_FAILED -13
 #define RC_RM_NO_SPACE_PAGE -14
@@ -0,0 +1,103 @@
+#include "frame_heap.h"
+
+static void swapHeapSlots(FrameHeap *fHeap, int i, int j);
+static void siftUp(FrameHeap *fHeap, int i);
+static void siftDown(FrameHeap *fHeap, int i);
+
+// Create an empty heap for frames 0..size-1
+FrameHeap *createFrameHeap(size_t size) {
+    FrameHeap *fHeap = malloc(sizeof(FrameHeap));
+    fHeap->heap = malloc(sizeof(int) * size);
+    fHeap->pos = malloc(sizeof(int) * size);
+    fHeap->key = calloc(size, sizeof(unsigned long long));
+    fHeap->heapLen = 0;
+    fHeap->size = size;
+
+    for (size_t i = 0; i < size; ++i) {
+        fHeap->pos[i] = NO_FRAME;
+    }
+    return fHeap;
+}
+
+// Delete the heap from memory
+void destroyFrameHeap(FrameHeap *fHeap) {
+    free(fHeap->heap);
+    free(fHeap->pos);
+    free(fHeap->key);
+    free(fHeap);
+}
+
+// Insert frame id, which is not in the heap yet, with the given key
+void pushHeapFrame(FrameHeap *fHeap, int id, unsigned long long key) {
+    int i = fHeap->heapLen++;
+
+    fHeap->heap[i] = id;
+    fHeap->pos[id] = i;
+    fHeap->key[id] = key;
+    siftUp(fHeap, i);
+}
+
+// Remove and return the frame with the smallest key, NO_FRAME if the heap is empty
+int popHeapFrame(FrameHeap *fHeap) {
+    if (fHeap->heapLen == 0)
+        return NO_FRAME;
+
+    int id = fHeap->heap[0];
+    removeHeapFrame(fHeap, id);
+    return id;
+}
+
+// Remove frame id from the heap, the caller guarantees that it is in the heap
+void removeHeapFrame(FrameHeap *fHeap, int id) {
+    int i = fHeap->pos[id];
+    int last = --fHeap->heapLen;
+
+    if (i != last) {
+        swapHeapSlots(fHeap, i, last);
+        siftUp(fHeap, i);
+        siftDown(fHeap, i);
+    }
+    fHeap->pos[id] = NO_FRAME;
+}
+
+// Change the key of frame id, which is in the heap
+void updateHeapFrame(FrameHeap *fHeap, int id, unsigned long long key) {
+    fHeap->key[id] = key;
+    siftUp(fHeap, fHeap->pos[id]);
+    siftDown(fHeap, fHeap->pos[id]);
+}
+
+static void swapHeapSlots(FrameHeap *fHeap, int i, int j) {
+    int tmp = fHeap->heap[i];
+    fHeap->heap[i] = fHeap->heap[j];
+    fHeap->heap[j] = tmp;
+    fHeap->pos[fHeap->heap[i]] = i;
+    fHeap->pos[fHeap->heap[j]] = j;
+}
+
+static void siftUp(FrameHeap *fHeap, int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (fHeap->key[fHeap->heap[parent]] <= fHeap->key[fHeap->heap[i]])
+            return;
+        swapHeapSlots(fHeap, i, parent);
+        i = parent;
+    }
+}
+
+static void siftDown(FrameHeap *fHeap, int i) {
+    while (1) {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+
+        if (left < fHeap->heapLen && fHeap->key[fHeap->heap[left]] < fHeap->key[fHeap->heap[smallest]])
+            smallest = left;
+        if (right < fHeap->heapLen && fHeap->key[fHeap->heap[right]] < fHeap->key[fHeap->heap[smallest]])
+            smallest = right;
+        if (smallest == i)
+            return;
+        swapHeapSlots(fHeap, i, smallest);
+        i = smallest;
+    }
+}
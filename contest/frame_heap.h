@@ -0,0 +1,28 @@
+#ifndef FRAME_HEAP_H
+#define FRAME_HEAP_H
+
+#include <stdlib.h>
+#include "frame_list.h"
+
+/*
+  Binary min-heap of buffer frames, ordered by a 64 bit key per frame.
+  pos[] remembers where each frame sits in the heap, so a frame can be removed or
+  have its key changed in O(log n) without searching for it.
+*/
+typedef struct FrameHeap{
+    int *heap;
+    int *pos;
+    unsigned long long *key;
+    int heapLen;
+    size_t size;
+} FrameHeap;
+
+FrameHeap* createFrameHeap(size_t size);
+void destroyFrameHeap(FrameHeap* fHeap);
+
+void pushHeapFrame(FrameHeap* fHeap, int id, unsigned long long key);
+int popHeapFrame(FrameHeap* fHeap);
+void removeHeapFrame(FrameHeap* fHeap, int id);
+void updateHeapFrame(FrameHeap* fHeap, int id, unsigned long long key);
+
+#endif
@@ -0,0 +1,93 @@
+#include "frame_list.h"
+
+// Create link storage for frames 0..size-1, none of them is on a list yet
+FrameLinks *createFrameLinks(size_t size) {
+    FrameLinks *links = malloc(sizeof(FrameLinks));
+    links->prev = malloc(sizeof(int) * size);
+    links->next = malloc(sizeof(int) * size);
+    links->size = size;
+
+    for (size_t i = 0; i < size; ++i) {
+        links->prev[i] = NO_FRAME;
+        links->next[i] = NO_FRAME;
+    }
+    return links;
+}
+
+// Delete the link storage from memory
+void destroyFrameLinks(FrameLinks *links) {
+    free(links->prev);
+    free(links->next);
+    free(links);
+}
+
+// Make the list empty
+void initFrameList(FrameList *list) {
+    list->head = NO_FRAME;
+    list->tail = NO_FRAME;
+    list->listLen = 0;
+}
+
+// Insert frame id at the end of the list
+void appendFrame(FrameLinks *links, FrameList *list, int id) {
+    links->prev[id] = list->tail;
+    links->next[id] = NO_FRAME;
+
+    if (list->tail == NO_FRAME)
+        list->head = id;
+    else
+        links->next[list->tail] = id;
+
+    list->tail = id;
+    list->listLen += 1;
+}
+
+// Insert frame id at the beginning of the list
+void prependFrame(FrameLinks *links, FrameList *list, int id) {
+    links->prev[id] = NO_FRAME;
+    links->next[id] = list->head;
+
+    if (list->head == NO_FRAME)
+        list->tail = id;
+    else
+        links->prev[list->head] = id;
+
+    list->head = id;
+    list->listLen += 1;
+}
+
+// Unlink frame id from the list, the caller guarantees that it is on this list
+void removeFrame(FrameLinks *links, FrameList *list, int id) {
+    int prev = links->prev[id];
+    int next = links->next[id];
+
+    if (prev == NO_FRAME)
+        list->head = next;
+    else
+        links->next[prev] = next;
+
+    if (next == NO_FRAME)
+        list->tail = prev;
+    else
+        links->prev[next] = prev;
+
+    links->prev[id] = NO_FRAME;
+    links->next[id] = NO_FRAME;
+    list->listLen -= 1;
+}
+
+// Move frame id (already on the list) to the end of the list
+void moveFrameToTail(FrameLinks *links, FrameList *list, int id) {
+    if (list->tail == id)
+        return;
+    removeFrame(links, list, id);
+    appendFrame(links, list, id);
+}
+
+// Remove and return the first frame of the list, NO_FRAME if the list is empty
+int popFrameListHead(FrameLinks *links, FrameList *list) {
+    int id = list->head;
+    if (id != NO_FRAME)
+        removeFrame(links, list, id);
+    return id;
+}
@@ -0,0 +1,43 @@
+#ifndef FRAME_LIST_H
+#define FRAME_LIST_H
+
+#include <stdlib.h>
+
+#define NO_FRAME -1
+
+/*
+  Intrusive doubly linked lists over buffer frames.
+  The links are kept in two arrays indexed directly by buff_id, so a frame can be
+  found, unlinked and re-linked in O(1) without searching and without any allocation.
+  Several lists can share one FrameLinks, a frame is on at most one of them at a time.
+
+        prev[]  : | 1 | -1 | 3 | 0 |        list: head=1 -> 0 -> 3 -> 2=tail
+        next[]  : | 3 |  0 |-1 | 2 |
+                    0    1   2   3    <- buff_id
+*/
+
+// Link storage shared by all lists built over the same set of frames
+typedef struct FrameLinks{
+    int *prev;
+    int *next;
+    size_t size;
+} FrameLinks;
+
+// One list, the nodes live in the FrameLinks it is used with.
+typedef struct FrameList{
+    int head;
+    int tail;
+    int listLen;
+} FrameList;
+
+FrameLinks* createFrameLinks(size_t size);
+void destroyFrameLinks(FrameLinks* links);
+
+void initFrameList(FrameList* list);
+void appendFrame(FrameLinks* links, FrameList* list, int id);
+void prependFrame(FrameLinks* links, FrameList* list, int id);
+void removeFrame(FrameLinks* links, FrameList* list, int id);
+void moveFrameToTail(FrameLinks* links, FrameList* list, int id);
+int popFrameListHead(FrameLinks* links, FrameList* list);
+
+#endif
@@ -0,0 +1,71 @@
+#include "freq_sketch.h"
+
+// Odd multipliers, one independent hash function per row
+static const unsigned long long sketchSeeds[SKETCH_DEPTH] = {
+    0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL
+};
+
+static size_t sketchIndex(FreqSketch *sketch, long long key, int row);
+static void halveCounters(FreqSketch *sketch);
+
+// Create a sketch sized for tracking about numItems distinct keys
+FreqSketch *createFreqSketch(size_t numItems) {
+    FreqSketch *sketch = malloc(sizeof(FreqSketch));
+
+    // Width is a power of two so that the row index is a simple mask
+    sketch->width = 64;
+    while (sketch->width < numItems) {
+        sketch->width <<= 1;
+    }
+    sketch->counters = calloc(sketch->width * SKETCH_DEPTH, sizeof(unsigned char));
+    sketch->sampleSize = 10 * (numItems > 0 ? numItems : 1);
+    sketch->numIncrements = 0;
+    return sketch;
+}
+
+// Delete the sketch from memory
+void destroyFreqSketch(FreqSketch *sketch) {
+    free(sketch->counters);
+    free(sketch);
+}
+
+// Count one more occurrence of key
+void incrementFreq(FreqSketch *sketch, long long key) {
+    int row;
+
+    for (row = 0; row < SKETCH_DEPTH; ++row) {
+        unsigned char *counter = &sketch->counters[row * sketch->width + sketchIndex(sketch, key, row)];
+        if (*counter < SKETCH_MAX_COUNT)
+            *counter += 1;
+    }
+    if (++sketch->numIncrements >= sketch->sampleSize)
+        halveCounters(sketch);
+}
+
+// Estimated number of occurrences of key since the counters were last halved
+int estimateFreq(FreqSketch *sketch, long long key) {
+    int row;
+    int minCount = SKETCH_MAX_COUNT;
+
+    for (row = 0; row < SKETCH_DEPTH; ++row) {
+        int count = sketch->counters[row * sketch->width + sketchIndex(sketch, key, row)];
+        if (count < minCount)
+            minCount = count;
+    }
+    return minCount;
+}
+
+static size_t sketchIndex(FreqSketch *sketch, long long key, int row) {
+    unsigned long long h = ((unsigned long long) key + 1) * sketchSeeds[row];
+    h ^= h >> 32;
+    return (size_t) (h & (sketch->width - 1));
+}
+
+static void halveCounters(FreqSketch *sketch) {
+    size_t i;
+
+    for (i = 0; i < sketch->width * SKETCH_DEPTH; ++i) {
+        sketch->counters[i] >>= 1;
+    }
+    sketch->numIncrements /= 2;
+}
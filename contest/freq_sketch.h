@@ -0,0 +1,27 @@
+#ifndef FREQ_SKETCH_H
+#define FREQ_SKETCH_H
+
+#include <stdlib.h>
+
+#define SKETCH_DEPTH 4
+#define SKETCH_MAX_COUNT 15
+
+/*
+  Count-min sketch estimating how often a page was requested recently.
+  Every page maps to one small saturating counter in each of SKETCH_DEPTH rows, its estimate
+  is the smallest of those counters. After sampleSize increments all counters are halved,
+  so the estimates follow the recent history instead of growing forever.
+*/
+typedef struct FreqSketch{
+    unsigned char *counters;
+    size_t width;
+    size_t sampleSize;
+    size_t numIncrements;
+} FreqSketch;
+
+FreqSketch* createFreqSketch(size_t numItems);
+void destroyFreqSketch(FreqSketch* sketch);
+void incrementFreq(FreqSketch* sketch, long long key);
+int estimateFreq(FreqSketch* sketch, long long key);
+
+#endif
@@ -1,144 +1,220 @@
 #include "hash_table.h"
-#include <math.h>
 #include <stdio.h>
 
-//Create a hash table of give size
+#define MIN_TABLE_SIZE 8
+// Number of old slots moved to the new table on every insert or delete while growing
+#define MIGRATE_STEP 4
+
+// Hash function taken from Introduction to Algorithms by cormen, s = floor(A * 2^32) with A = (sqrt(5) - 1) / 2
+#define HASH_MULTIPLIER 2654435769u
+
+static size_t hashWithBits(HashKey key, int p);
+static HashNode *findNode(HashNode *nodes, size_t size, int p, HashKey key);
+static int removeNode(HashNode *nodes, size_t size, int p, HashKey key);
+static void placeNode(HashNode *nodes, size_t size, int p, HashKey key, int value);
+static void startGrowing(HashTable *hashTable);
+static void migrateNodes(HashTable *hashTable);
+
+//Create a hash table for about tableSize keys, the size is rounded up to a power of two
 HashTable *createHashTable(size_t tableSize) {
 
     HashTable *hTable = malloc(sizeof(HashTable));
 
-    hTable->hashNode = malloc(sizeof(HashNode) * tableSize);
-	hTable->size = tableSize;
-    hTable->p = (int) (log(hTable->size) / log(2));
-    for (size_t i = 0; i < tableSize; ++i) {
+    hTable->size = MIN_TABLE_SIZE;
+    hTable->p = 3;
+    while (hTable->size < tableSize) {
+        hTable->size <<= 1;
+        hTable->p++;
+    }
+    hTable->hashNode = malloc(sizeof(HashNode) * hTable->size);
+    for (size_t i = 0; i < hTable->size; ++i) {
         hTable->hashNode[i].key = NO_KEY;
-        hTable->hashNode[i].next = NULL;
     }
+    hTable->numKeys = 0;
+
+    hTable->oldHashNode = NULL;
+    hTable->oldSize = 0;
+    hTable->oldNumKeys = 0;
+    hTable->oldP = 0;
+    hTable->migratePos = 0;
     return hTable;
 }
 
-// Given a key value pair, insert in to the hash table
-void insertHashNode(HashTable *hashTable, int key, int value) {
-    size_t hashValue = hashOfKey(hashTable, key);
-    if (hashTable->hashNode[hashValue].key == NO_KEY) {
-        hashTable->hashNode[hashValue].key = key;
-        hashTable->hashNode[hashValue].value = value;
+// Given a key value pair, insert in to the hash table. The value of an existing key is replaced.
+void insertHashNode(HashTable *hashTable, HashKey key, int value) {
+    HashNode *node = findNode(hashTable->hashNode, hashTable->size, hashTable->p, key);
+    if (node != NULL) {
+        node->value = value;
         return;
     }
 
-    HashNode *hNode = malloc(sizeof(HashNode));
-    hNode->next = NULL;
-    hNode->key = key;
-    hNode->value = value;
-
-    hNode->next = hashTable->hashNode[hashValue].next;
-    hashTable->hashNode[hashValue].next = hNode;
+    if (hashTable->oldHashNode != NULL) {
+        if (removeNode(hashTable->oldHashNode, hashTable->oldSize, hashTable->oldP, key)) {
+            hashTable->oldNumKeys--;
+        }
+        migrateNodes(hashTable);
+    } else if ((hashTable->numKeys + 1) * 4 > hashTable->size * 3) {
+        startGrowing(hashTable);
+    }
 
+    placeNode(hashTable->hashNode, hashTable->size, hashTable->p, key, value);
+    hashTable->numKeys++;
 }
 
 // Compute the hash value of the given key
-size_t hashOfKey(HashTable *hTable, int key) {
-    // Hash function taken from Introduction to Algorithms by cormen
-    double A = (sqrt(5) - 1) / 2;
-    int wordSize = 32;
-    unsigned int s = (unsigned) floor(A * 2 * ((unsigned int) 2 << (wordSize - 2)));
-    unsigned int x = key * s;
-    size_t hashValue = x >> (wordSize - hTable->p);
-
-    // The above hash method gaurentees the size to be less than table size, but let's double check;
-    if (hashValue > hTable->size) {
-        printf("Waring: Problem with hash function");
-        hashValue = hashValue % hTable->size;
-    }
-	//printf("Key: %d, HashValue: %lu\n", key, hashValue);
-    return hashValue;
+size_t hashOfKey(HashTable *hTable, HashKey key) {
+    return hashWithBits(key, hTable->p);
 }
 
 // Given a key, search for it in the hash table,
 //      if found return the value in node else return NOT_FOUND
-int searchHashTable(HashTable *hashTable, int key) {
-    size_t hashValue = hashOfKey(hashTable, key);
-
-    if(hashTable->hashNode[hashValue].key == key){
-        return hashTable->hashNode[hashValue].value ;
-    }
-
-    HashNode * searchNode = hashTable->hashNode[hashValue].next;
+int searchHashTable(HashTable *hashTable, HashKey key) {
+    HashNode *node = getHashNode(hashTable, key);
 
-    while (searchNode != NULL){
-        if(searchNode->key == key){
-            return searchNode->value;
-        }
-        searchNode = searchNode->next;
-    }
-
-    return NOT_FOUND;
+    return node != NULL ? node->value : NOT_FOUND;
 }
 
 // Given a key, delete the node from the hashtable if exists
-void deleteHashNode(HashTable *hashTable, int key) {
-    size_t hashValue = hashOfKey(hashTable, key);
-
-    if(hashTable->hashNode[hashValue].key == key){
-        hashTable->hashNode[hashValue].key = NO_KEY;
+void deleteHashNode(HashTable *hashTable, HashKey key) {
+    if (removeNode(hashTable->hashNode, hashTable->size, hashTable->p, key)) {
+        hashTable->numKeys--;
+    } else if (hashTable->oldHashNode != NULL
+               && removeNode(hashTable->oldHashNode, hashTable->oldSize, hashTable->oldP, key)) {
+        hashTable->oldNumKeys--;
     }
 
-    HashNode * currNode = hashTable->hashNode[hashValue].next;
-	HashNode * prevNode = &(hashTable->hashNode[hashValue]);
-
-    while (currNode!=NULL){
-        if(currNode->key == key){
-			prevNode->next = currNode->next;
-            currNode->key = NO_KEY;
-			free(currNode);
-            return;
-        }
-		prevNode = currNode;
-        currNode = currNode->next;
+    if (hashTable->oldHashNode != NULL) {
+        migrateNodes(hashTable);
     }
-
 }
 
 // Delete the hash table from memory
 void destroyHashTable(HashTable *hashTable) {
-    HashNode* currNode,*prevNode;
-    for (size_t i = 0; i < hashTable->size; ++i) {
-        currNode = hashTable->hashNode[i].next;
-        while ( currNode != NULL){
-            prevNode = currNode;
-            currNode = currNode->next;
-            free(prevNode);
-        }
-    }
-
+    free(hashTable->oldHashNode);
     free(hashTable->hashNode);
     free(hashTable);
 }
 
 // This function deletes the hash node with key=oldKey and Inserts a new node with (newKey, newValue) in the hash table
-void delsertHashNode(HashTable *hashTable, int oldKey, int newKey, int newValue) {
+void delsertHashNode(HashTable *hashTable, HashKey oldKey, HashKey newKey, int newValue) {
     deleteHashNode(hashTable, oldKey);
     insertHashNode(hashTable,newKey,newValue);
 }
 
-// Returns the node (not value) from hashTable with the given key
-HashNode *getHashNode(HashTable *hashTable, int key) {
-    size_t hashValue = hashOfKey(hashTable, key);
+// Returns the node (not value) from hashTable with the given key.
+// The node is only valid until the table is changed again.
+HashNode *getHashNode(HashTable *hashTable, HashKey key) {
+    HashNode *node = findNode(hashTable->hashNode, hashTable->size, hashTable->p, key);
 
-    if(hashTable->hashNode[hashValue].key == key){
-        return &(hashTable->hashNode[hashValue]);
+    if (node == NULL && hashTable->oldHashNode != NULL) {
+        node = findNode(hashTable->oldHashNode, hashTable->oldSize, hashTable->oldP, key);
     }
+    return node;
+}
+
+// Fibonacci hashing: the top p bits of key * s, the high half of the key is folded in to the low half first
+static size_t hashWithBits(HashKey key, int p) {
+    unsigned int x = ((unsigned int) key ^ (unsigned int) ((unsigned long long) key >> 32)) * HASH_MULTIPLIER;
+    return x >> (32 - p);
+}
 
-    HashNode * searchNode = hashTable->hashNode[hashValue].next;
+// Probe from the home slot of key until the key or an empty node is found
+static HashNode *findNode(HashNode *nodes, size_t size, int p, HashKey key) {
+    size_t mask = size - 1;
+    size_t i = hashWithBits(key, p);
 
-    while (searchNode != NULL){
-        if(searchNode->key == key){
-            return searchNode;
+    while (nodes[i].key != NO_KEY) {
+        if (nodes[i].key == key) {
+            return &nodes[i];
         }
-        searchNode = searchNode->next;
+        i = (i + 1) & mask;
     }
-
     return NULL;
+}
+
+// Put key in the first empty node of its probe sequence, the key must not be in the table
+static void placeNode(HashNode *nodes, size_t size, int p, HashKey key, int value) {
+    size_t mask = size - 1;
+    size_t i = hashWithBits(key, p);
 
+    while (nodes[i].key != NO_KEY) {
+        i = (i + 1) & mask;
+    }
+    nodes[i].key = key;
+    nodes[i].value = value;
 }
 
+/*
+ * Remove key and close the gap: every following node of the run whose home slot
+ * does not lie between the gap and the node is moved back in to the gap.
+ * Returns 1 if the key was found.
+ */
+static int removeNode(HashNode *nodes, size_t size, int p, HashKey key) {
+    size_t mask = size - 1;
+    HashNode *node = findNode(nodes, size, p, key);
+    if (node == NULL) {
+        return 0;
+    }
+
+    size_t gap = (size_t) (node - nodes);
+    size_t i = gap;
+    while (1) {
+        i = (i + 1) & mask;
+        if (nodes[i].key == NO_KEY) {
+            break;
+        }
+        size_t home = hashWithBits(nodes[i].key, p);
+        // distance from home to i is at least the distance from gap to i: the node may move to the gap
+        if (((i - home) & mask) >= ((i - gap) & mask)) {
+            nodes[gap] = nodes[i];
+            gap = i;
+        }
+    }
+    nodes[gap].key = NO_KEY;
+    return 1;
+}
+
+// Make a table of double size the current one, the current one is moved over by migrateNodes
+static void startGrowing(HashTable *hashTable) {
+    hashTable->oldHashNode = hashTable->hashNode;
+    hashTable->oldSize = hashTable->size;
+    hashTable->oldNumKeys = hashTable->numKeys;
+    hashTable->oldP = hashTable->p;
+    hashTable->migratePos = 0;
+
+    hashTable->size <<= 1;
+    hashTable->p++;
+    hashTable->hashNode = malloc(sizeof(HashNode) * hashTable->size);
+    for (size_t i = 0; i < hashTable->size; ++i) {
+        hashTable->hashNode[i].key = NO_KEY;
+    }
+    hashTable->numKeys = 0;
+}
+
+/*
+ * Move up to MIGRATE_STEP slots of the old table to the new one.
+ * Nodes are taken out of the old table in slot order. Removing a node only moves nodes of the old
+ * table back to the slot being emptied, never before it, so the slots before migratePos stay empty.
+ */
+static void migrateNodes(HashTable *hashTable) {
+    int step;
+
+    for (step = 0; step < MIGRATE_STEP && hashTable->oldNumKeys > 0; ++step) {
+        HashNode node = hashTable->oldHashNode[hashTable->migratePos];
+        if (node.key == NO_KEY) {
+            hashTable->migratePos++;
+            continue;
+        }
+        removeNode(hashTable->oldHashNode, hashTable->oldSize, hashTable->oldP, node.key);
+        hashTable->oldNumKeys--;
+        placeNode(hashTable->hashNode, hashTable->size, hashTable->p, node.key, node.value);
+        hashTable->numKeys++;
+    }
+
+    if (hashTable->oldNumKeys == 0) {
+        free(hashTable->oldHashNode);
+        hashTable->oldHashNode = NULL;
+        hashTable->oldSize = 0;
+        hashTable->oldP = 0;
+    }
+}
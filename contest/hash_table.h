@@ -1,52 +1,64 @@
 
-#include <stdlib.h>
-
 #ifndef HASH_TABLE_H
 #define HASH_TABLE_H
-#endif
+
+#include <stdlib.h>
 
 #define NO_KEY -1
 #define NOT_FOUND -1
 /*
-  Intially a hash table is created with a given size. We don't change the size since. 
-  In case of collision we simply chain it at the position determined by the hash function.
+  Open addressing hash table with linear probing. The nodes are stored inline in one array
+  whose size is a power of two, so a lookup touches one or two cache lines and never allocates.
   					+---------+
-  					|  key    |---> next
+  					|  key    |  <- hashOfKey(key)
   					|  value  |
   					+---------+
-  					|  key    |--> next
+  					|  key    |  <- next probe on collision
   					|  value  |
   					+---------+
   					.         .
-   "size" elements  .         .
+   "size" nodes     .         .
   					.         .
   					+---------+
-  					|  key    |
-  					|  Value  |---> next
+  					|  NO_KEY |  <- end of the probe sequence
+  					|         |
   					+---------+
+  Deleting a node shifts the following nodes of its probe sequence back, so there are no tombstones.
+  Once the table is more than 3/4 full a table of double size is created. New keys go to the new table
+  and every insert or delete moves a few nodes of the old table over, until the old table is empty.
 */
 
-// Each Node in the hash table contains a key, value and pointer to next node.
-// The next node points to the head of chain (The chain is formed in case of collision).
-// 
+// Keys are 64 bits wide, so a key can combine two ints (see PageKey in buffer_mgr.h)
+typedef long long HashKey;
+
+// Each Node in the hash table contains a key and a value, key is NO_KEY if the node is empty.
 typedef struct HashNode{
-    int key;
+    HashKey key;
     int value;
-    struct HashNode* next;
 } HashNode;
 
-// Hash table which contains a array of hash nodes as depicted above
+// Hash table as depicted above
 typedef struct HashTable{
     HashNode * hashNode;
     size_t size;
-    int p; // Used in hash computation
+    size_t numKeys;
+    int p; // log2 of size, used in hash computation
+
+    // the table being moved in to hashNode while growing, NULL otherwise
+    HashNode * oldHashNode;
+    size_t oldSize;
+    size_t oldNumKeys;
+    int oldP;
+    size_t migratePos; // nodes of the old table before this position are already moved
 } HashTable;
 
 HashTable* createHashTable(size_t tableSize);
-void insertHashNode(HashTable* hashTable, int key, int value);
-int searchHashTable(HashTable* hashTable, int key);
-void deleteHashNode(HashTable* hashTable, int key);
-void delsertHashNode(HashTable* hashTable, int oldKey, int newKey, int newValue);
-HashNode* getHashNode(HashTable* hashTable, int key);
-size_t hashOfKey(HashTable *hashTable, int key);
-void destroyHashTable(HashTable* hashTable);
\ No newline at end of file
+void insertHashNode(HashTable* hashTable, HashKey key, int value);
+int searchHashTable(HashTable* hashTable, HashKey key);
+void deleteHashNode(HashTable* hashTable, HashKey key);
+void delsertHashNode(HashTable* hashTable, HashKey oldKey, HashKey newKey, int newValue);
+HashNode* getHashNode(HashTable* hashTable, HashKey key);
+size_t hashOfKey(HashTable *hashTable, HashKey key);
+void destroyHashTable(HashTable* hashTable);
+
+#endif
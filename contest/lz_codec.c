@@ -0,0 +1,163 @@
+#include "lz_codec.h"
+#include <string.h>
+
+// Fibonacci hashing of the 4 bytes at a position, as in hash_table.c
+#define LZ_HASH_MULTIPLIER 2654435769u
+
+static unsigned int hashBytes(const unsigned char *p);
+static unsigned char *writeLength(unsigned char *op, const unsigned char *opEnd, int length);
+static int readLength(const unsigned char **ip, const unsigned char *ipEnd, int length);
+static unsigned char *writeSequence(unsigned char *op, const unsigned char *opEnd, const unsigned char *literals,
+                                    int numLiterals, int offset, int matchLength);
+
+/*
+ * Greedy parse: the last position of every 4 byte sequence is kept in a hash table,
+ * a position whose bytes match the ones at the remembered position starts a match.
+ */
+int lzCompress(const char *src, int srcSize, char *dst, int dstCapacity) {
+    const unsigned char *in = (const unsigned char *) src;
+    unsigned char *op = (unsigned char *) dst;
+    const unsigned char *opEnd = op + dstCapacity;
+    int table[1 << LZ_HASH_BITS];
+    int pos = 0;
+    int anchor = 0;
+
+    memset(table, -1, sizeof(table));
+    while (pos + LZ_MIN_MATCH <= srcSize) {
+        unsigned int h = hashBytes(in + pos);
+        int candidate = table[h];
+        table[h] = pos;
+
+        if (candidate < 0 || pos - candidate > LZ_MAX_OFFSET || memcmp(in + candidate, in + pos, LZ_MIN_MATCH) != 0) {
+            pos++;
+            continue;
+        }
+
+        int length = LZ_MIN_MATCH;
+        while (pos + length < srcSize && in[candidate + length] == in[pos + length]) {
+            length++;
+        }
+        op = writeSequence(op, opEnd, in + anchor, pos - anchor, pos - candidate, length);
+        if (op == NULL) {
+            return 0;
+        }
+        pos += length;
+        anchor = pos;
+    }
+
+    op = writeSequence(op, opEnd, in + anchor, srcSize - anchor, 0, 0);
+    if (op == NULL) {
+        return 0;
+    }
+    return (int) (op - (unsigned char *) dst);
+}
+
+int lzDecompress(const char *src, int srcSize, char *dst, int dstCapacity) {
+    const unsigned char *ip = (const unsigned char *) src;
+    const unsigned char *ipEnd = ip + srcSize;
+    unsigned char *op = (unsigned char *) dst;
+    unsigned char *opEnd = op + dstCapacity;
+
+    while (ip < ipEnd) {
+        int token = *ip++;
+
+        int numLiterals = readLength(&ip, ipEnd, token >> 4);
+        if (numLiterals < 0 || numLiterals > ipEnd - ip || numLiterals > opEnd - op) {
+            return -1;
+        }
+        memcpy(op, ip, (size_t) numLiterals);
+        ip += numLiterals;
+        op += numLiterals;
+        if (ip == ipEnd) {
+            break;
+        }
+
+        if (ipEnd - ip < 2) {
+            return -1;
+        }
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        int length = readLength(&ip, ipEnd, token & 15);
+        if (length < 0 || offset == 0 || offset > op - (unsigned char *) dst || length + LZ_MIN_MATCH > opEnd - op) {
+            return -1;
+        }
+        length += LZ_MIN_MATCH;
+
+        // byte by byte, the match may overlap the bytes it produces
+        const unsigned char *match = op - offset;
+        while (length-- > 0) {
+            *op++ = *match++;
+        }
+    }
+    return (int) (op - (unsigned char *) dst);
+}
+
+static unsigned int hashBytes(const unsigned char *p) {
+    unsigned int v;
+    memcpy(&v, p, sizeof(v));
+    return (v * LZ_HASH_MULTIPLIER) >> (32 - LZ_HASH_BITS);
+}
+
+// The bytes following a 4 bit length of 15, returns the end of the output or NULL if it does not fit
+static unsigned char *writeLength(unsigned char *op, const unsigned char *opEnd, int length) {
+    if (length < 15) {
+        return op;
+    }
+    length -= 15;
+    while (length >= 255) {
+        if (op >= opEnd) {
+            return NULL;
+        }
+        *op++ = 255;
+        length -= 255;
+    }
+    if (op >= opEnd) {
+        return NULL;
+    }
+    *op++ = (unsigned char) length;
+    return op;
+}
+
+// Add the bytes following a 4 bit length of 15 to it, -1 if the input ends first
+static int readLength(const unsigned char **ip, const unsigned char *ipEnd, int length) {
+    if (length < 15) {
+        return length;
+    }
+    while (1) {
+        if (*ip >= ipEnd) {
+            return -1;
+        }
+        int b = *(*ip)++;
+        length += b;
+        if (b != 255) {
+            return length;
+        }
+    }
+}
+
+// One sequence, a matchLength of 0 writes the last sequence of literals only
+static unsigned char *writeSequence(unsigned char *op, const unsigned char *opEnd, const unsigned char *literals,
+                                    int numLiterals, int offset, int matchLength) {
+    int matchCode = matchLength > 0 ? matchLength - LZ_MIN_MATCH : 0;
+
+    if (op >= opEnd) {
+        return NULL;
+    }
+    *op++ = (unsigned char) (((numLiterals < 15 ? numLiterals : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+    op = writeLength(op, opEnd, numLiterals);
+    if (op == NULL || numLiterals > opEnd - op) {
+        return NULL;
+    }
+    memcpy(op, literals, (size_t) numLiterals);
+    op += numLiterals;
+
+    if (matchLength == 0) {
+        return op;
+    }
+    if (opEnd - op < 2) {
+        return NULL;
+    }
+    *op++ = (unsigned char) (offset & 0xff);
+    *op++ = (unsigned char) (offset >> 8);
+    return writeLength(op, opEnd, matchCode);
+}
@@ -0,0 +1,28 @@
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+/*
+ * A small LZ77 codec in the style of LZ4, fast enough to run on every page written out.
+ * The compressed data is a sequence of
+ *
+ *      token | literal length bytes | literals | offset (2 bytes) | match length bytes
+ *
+ * The high 4 bits of the token are the number of literals, the low 4 bits the match length minus
+ * LZ_MIN_MATCH. A value of 15 is followed by bytes adding to it, up to the first byte that is not 255.
+ * The match copies match length bytes from offset bytes back in the output. The last sequence has
+ * literals only and ends the data.
+ */
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+
+// Largest compressed size of srcSize bytes, for data that does not compress
+#define LZ_MAX_COMPRESSED_SIZE(srcSize) ((srcSize) + (srcSize) / 255 + 16)
+
+// Compress srcSize bytes of src in to dst. Returns the compressed size, 0 if it exceeds dstCapacity.
+extern int lzCompress(const char *src, int srcSize, char *dst, int dstCapacity);
+// Decompress srcSize bytes of src in to dst. Returns the decompressed size, -1 if src is corrupt or dst too small.
+extern int lzDecompress(const char *src, int srcSize, char *dst, int dstCapacity);
+
+#endif
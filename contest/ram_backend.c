@@ -0,0 +1,336 @@
+#define _GNU_SOURCE
+
+#include "storage_mgr.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Pages are kept in blocks of RAM_BLOCK_PAGES pages. A block never moves, so the pages do not move as the file grows.
+#define RAM_BLOCK_PAGES 64
+
+/*
+ * A page file kept in memory
+ *
+ * name         : Name the file was created under
+ * pageSize     : Bytes per page
+ * blocks       : The pages, page p is at blocks[p / RAM_BLOCK_PAGES] + (p % RAM_BLOCK_PAGES) * pageSize
+ * numBlocks    : Blocks allocated, the pages in them read as zeros until written
+ * maxBlocks    : Entries allocated for blocks
+ * numPages     : Pages in the file
+ * lock         : Held for reading to reach a page, for writing to add blocks or change freeMap
+ * freeMap      : Bitmap of the free pages, the handles on the file write the bytes they change to it
+ * freeMapBytes : Bytes allocated for freeMap
+ * openCount    : Handles open on the file
+ * destroyed    : Destroyed or created again while open, freed once the last handle is closed
+ * next         : Next file in the registry
+ */
+typedef struct RamFile {
+    char *name;
+    int pageSize;
+    char **blocks;
+    int numBlocks;
+    int maxBlocks;
+    int numPages;
+    pthread_rwlock_t lock;
+    unsigned char *freeMap;
+    int freeMapBytes;
+    int openCount;
+    bool destroyed;
+    struct RamFile *next;
+} RamFile;
+
+static RC ramCreate(char *fileName, int pageSize, int segmentPages, bool compressed);
+static RC ramDestroy(char *fileName);
+static RC ramOpen(char *fileName, SM_FileHandle *fHandle, SM_IOMode ioMode);
+static RC ramClose(SM_FileHandle *fHandle);
+static RC ramReadPage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage);
+static RC ramWritePage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage);
+static RC ramReadPages(SM_FileHandle *fHandle, int startPage, int numPages, SM_PageHandle *memPages);
+static RC ramWritePages(SM_FileHandle *fHandle, int startPage, int numPages, SM_PageHandle *memPages);
+static RC ramMapPage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle *memPage);
+static RC ramGrow(SM_FileHandle *fHandle, int numPages);
+static RC ramDiscardPage(SM_FileHandle *fHandle, int pageNum);
+static int ramLocatePage(SM_FileHandle *fHandle, int pageNum, long long *offset);
+static RC ramLoadFreeMap(SM_FileHandle *fHandle);
+static RC ramStoreFreeMap(SM_FileHandle *fHandle, int byte);
+
+static RamFile **findFile(const char *fileName);
+static void unlinkFile(RamFile **link);
+static void freeFile(RamFile *file);
+static RC reserveBlocks(RamFile *file, int numPages);
+static char *getPage(RamFile *file, int pageNum);
+
+const SM_Backend SM_RAM_BACKEND = {
+        "ram",
+        ramCreate,
+        ramDestroy,
+        ramOpen,
+        ramClose,
+        ramReadPage,
+        ramWritePage,
+        ramReadPages,
+        ramWritePages,
+        ramMapPage,
+        ramGrow,
+        ramDiscardPage,
+        ramLocatePage,
+        ramLoadFreeMap,
+        ramStoreFreeMap
+};
+
+// The files by name, registryLock guards the list and the open counts
+static RamFile *registry = NULL;
+static pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+
+// A file of the name is replaced, handles still open on it keep the old file
+static RC ramCreate(char *fileName, int pageSize, int segmentPages, bool compressed) {
+    RamFile *file = calloc(1, sizeof(RamFile));
+    if (file == NULL) {
+        return RC_CREATE_FAILED;
+    }
+    file->name = strdup(fileName);
+    file->pageSize = pageSize;
+    pthread_rwlock_init(&file->lock, NULL);
+    if (file->name == NULL || reserveBlocks(file, 1) != RC_OK) {
+        freeFile(file);
+        return RC_CREATE_FAILED;
+    }
+    file->numPages = 1;
+
+    pthread_mutex_lock(&registryLock);
+    RamFile **link = findFile(fileName);
+    if (*link != NULL) {
+        unlinkFile(link);
+    }
+    file->next = registry;
+    registry = file;
+    pthread_mutex_unlock(&registryLock);
+    return RC_OK;
+}
+
+static RC ramDestroy(char *fileName) {
+    pthread_mutex_lock(&registryLock);
+    RamFile **link = findFile(fileName);
+    if (*link == NULL) {
+        pthread_mutex_unlock(&registryLock);
+        return RC_FILE_NOT_FOUND;
+    }
+    unlinkFile(link);
+    pthread_mutex_unlock(&registryLock);
+    return RC_OK;
+}
+
+static RC ramOpen(char *fileName, SM_FileHandle *fHandle, SM_IOMode ioMode) {
+    pthread_mutex_lock(&registryLock);
+    RamFile *file = *findFile(fileName);
+    if (file == NULL) {
+        pthread_mutex_unlock(&registryLock);
+        return RC_FILE_NOT_FOUND;
+    }
+    file->openCount++;
+    pthread_mutex_unlock(&registryLock);
+
+    pthread_rwlock_rdlock(&file->lock);
+    fHandle->totalNumPages = file->numPages;
+    pthread_rwlock_unlock(&file->lock);
+    fHandle->mgmtInfo->backendData = file;
+    fHandle->mgmtInfo->pageSize = file->pageSize;
+    return RC_OK;
+}
+
+static RC ramClose(SM_FileHandle *fHandle) {
+    RamFile *file = fHandle->mgmtInfo->backendData;
+
+    pthread_mutex_lock(&registryLock);
+    bool isLast = --file->openCount == 0 && file->destroyed;
+    pthread_mutex_unlock(&registryLock);
+    if (isLast) {
+        freeFile(file);
+    }
+    return RC_OK;
+}
+
+static RC ramReadPage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage) {
+    RamFile *file = fHandle->mgmtInfo->backendData;
+
+    pthread_rwlock_rdlock(&file->lock);
+    memcpy(memPage, getPage(file, pageNum), (size_t) file->pageSize);
+    pthread_rwlock_unlock(&file->lock);
+    return RC_OK;
+}
+
+static RC ramWritePage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage) {
+    RamFile *file = fHandle->mgmtInfo->backendData;
+
+    pthread_rwlock_rdlock(&file->lock);
+    memcpy(getPage(file, pageNum), memPage, (size_t) file->pageSize);
+    pthread_rwlock_unlock(&file->lock);
+    return RC_OK;
+}
+
+static RC ramReadPages(SM_FileHandle *fHandle, int startPage, int numPages, SM_PageHandle *memPages) {
+    RamFile *file = fHandle->mgmtInfo->backendData;
+    int i;
+
+    pthread_rwlock_rdlock(&file->lock);
+    for (i = 0; i < numPages; ++i) {
+        memcpy(memPages[i], getPage(file, startPage + i), (size_t) file->pageSize);
+    }
+    pthread_rwlock_unlock(&file->lock);
+    return RC_OK;
+}
+
+static RC ramWritePages(SM_FileHandle *fHandle, int startPage, int numPages, SM_PageHandle *memPages) {
+    RamFile *file = fHandle->mgmtInfo->backendData;
+    int i;
+
+    pthread_rwlock_rdlock(&file->lock);
+    for (i = 0; i < numPages; ++i) {
+        memcpy(getPage(file, startPage + i), memPages[i], (size_t) file->pageSize);
+    }
+    pthread_rwlock_unlock(&file->lock);
+    return RC_OK;
+}
+
+static RC ramMapPage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle *memPage) {
+    RamFile *file = fHandle->mgmtInfo->backendData;
+
+    pthread_rwlock_rdlock(&file->lock);
+    *memPage = getPage(file, pageNum);
+    pthread_rwlock_unlock(&file->lock);
+    return RC_OK;
+}
+
+static RC ramGrow(SM_FileHandle *fHandle, int numPages) {
+    RamFile *file = fHandle->mgmtInfo->backendData;
+
+    pthread_rwlock_wrlock(&file->lock);
+    RC rc = reserveBlocks(file, numPages);
+    if (rc == RC_OK && numPages > file->numPages) {
+        file->numPages = numPages;
+    }
+    pthread_rwlock_unlock(&file->lock);
+    return rc;
+}
+
+// The page reads as zeros again if hole punching is on, as a punched page on disk
+static RC ramDiscardPage(SM_FileHandle *fHandle, int pageNum) {
+    RamFile *file = fHandle->mgmtInfo->backendData;
+
+    if (fHandle->mgmtInfo->punchHoles) {
+        pthread_rwlock_rdlock(&file->lock);
+        memset(getPage(file, pageNum), 0, (size_t) file->pageSize);
+        pthread_rwlock_unlock(&file->lock);
+    }
+    return RC_OK;
+}
+
+static int ramLocatePage(SM_FileHandle *fHandle, int pageNum, long long *offset) {
+    *offset = 0;
+    return -1;
+}
+
+static RC ramLoadFreeMap(SM_FileHandle *fHandle) {
+    RamFile *file = fHandle->mgmtInfo->backendData;
+    SM_MgmtInfo *mgmtInfo = fHandle->mgmtInfo;
+
+    pthread_rwlock_rdlock(&file->lock);
+    if (file->freeMapBytes > 0) {
+        mgmtInfo->freeMap = malloc((size_t) file->freeMapBytes);
+        if (mgmtInfo->freeMap == NULL) {
+            pthread_rwlock_unlock(&file->lock);
+            return RC_OPEN_FAILED;
+        }
+        memcpy(mgmtInfo->freeMap, file->freeMap, (size_t) file->freeMapBytes);
+        mgmtInfo->freeMapBytes = file->freeMapBytes;
+    }
+    pthread_rwlock_unlock(&file->lock);
+    return RC_OK;
+}
+
+static RC ramStoreFreeMap(SM_FileHandle *fHandle, int byte) {
+    RamFile *file = fHandle->mgmtInfo->backendData;
+    RC rc = RC_OK;
+
+    pthread_rwlock_wrlock(&file->lock);
+    if (byte >= file->freeMapBytes) {
+        int newBytes = fHandle->mgmtInfo->freeMapBytes;
+        unsigned char *newMap = realloc(file->freeMap, (size_t) newBytes);
+        if (newMap == NULL) {
+            rc = RC_WRITE_FAILED;
+        } else {
+            memset(newMap + file->freeMapBytes, 0, (size_t) (newBytes - file->freeMapBytes));
+            file->freeMap = newMap;
+            file->freeMapBytes = newBytes;
+        }
+    }
+    if (rc == RC_OK) {
+        file->freeMap[byte] = fHandle->mgmtInfo->freeMap[byte];
+    }
+    pthread_rwlock_unlock(&file->lock);
+    return rc;
+}
+
+// Link to the file named fileName in the registry, or to the NULL at its end if there is none
+static RamFile **findFile(const char *fileName) {
+    RamFile **link = &registry;
+
+    while (*link != NULL && strcmp((*link)->name, fileName) != 0) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+// Take the file out of the registry, it is freed now or by the last close. Called with registryLock held.
+static void unlinkFile(RamFile **link) {
+    RamFile *file = *link;
+
+    *link = file->next;
+    if (file->openCount > 0) {
+        file->destroyed = TRUE;
+    } else {
+        freeFile(file);
+    }
+}
+
+static void freeFile(RamFile *file) {
+    int block;
+
+    for (block = 0; block < file->numBlocks; ++block) {
+        free(file->blocks[block]);
+    }
+    free(file->blocks);
+    free(file->freeMap);
+    free(file->name);
+    pthread_rwlock_destroy(&file->lock);
+    free(file);
+}
+
+// Allocate the blocks holding numPages pages, zeroed
+static RC reserveBlocks(RamFile *file, int numPages) {
+    int neededBlocks = (numPages + RAM_BLOCK_PAGES - 1) / RAM_BLOCK_PAGES;
+
+    if (neededBlocks > file->maxBlocks) {
+        int maxBlocks = file->maxBlocks * 2 > neededBlocks ? file->maxBlocks * 2 : neededBlocks;
+        char **blocks = realloc(file->blocks, (size_t) maxBlocks * sizeof(char *));
+        if (blocks == NULL) {
+            return RC_ALLOCATION_FAILED;
+        }
+        file->blocks = blocks;
+        file->maxBlocks = maxBlocks;
+    }
+    while (file->numBlocks < neededBlocks) {
+        char *block;
+        // aligned as the frames of a buffer pool, so pages can be handed out in place
+        if (posix_memalign((void **) &block, PAGE_SIZE, (size_t) RAM_BLOCK_PAGES * file->pageSize) != 0) {
+            return RC_ALLOCATION_FAILED;
+        }
+        memset(block, 0, (size_t) RAM_BLOCK_PAGES * file->pageSize);
+        file->blocks[file->numBlocks++] = block;
+    }
+    return RC_OK;
+}
+
+static char *getPage(RamFile *file, int pageNum) {
+    return file->blocks[pageNum / RAM_BLOCK_PAGES] + (size_t) (pageNum % RAM_BLOCK_PAGES) * file->pageSize;
+}
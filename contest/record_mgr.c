@@ -17,6 +17,7 @@ int RM_BUFF_SIZE = 20;
 extern int RM_BUFF_SIZE;
 #endif
 static BM_BufferPool *contestPool = NULL;
+static BM_BufferPool *sharedPool = NULL;
 static BM_PageHandle * globalPh;
 
 bool initPage(char *page);
@@ -37,11 +38,20 @@ typedef struct RM_ScanMgmt {
 
 } RM_ScanMgmt;
 
+// mgmtData is a pool made with initSharedBufferPool the tables add their files to, NULL gives each table a pool
 RC initRecordManager(void *mgmtData) {
     contestPool = NULL;
+    sharedPool = mgmtData;
     return RC_OK;
 }
 
+// Open the page file of a table in the shared pool, or in a pool of its own
+static RC openTablePool(BM_BufferPool *bm, char *fileName) {
+    if (sharedPool != NULL)
+        return openPoolFile(bm, sharedPool, fileName);
+    return initBufferPool(bm, fileName, RM_BUFF_SIZE, RS_LRU, NULL);
+}
+
 // Block 0 of the file always holds the Table metadata
 //  We assume that metadata fits in 1 page, if not we throw an error
 RC createTable(char *name, Schema *schema) {
@@ -78,7 +88,7 @@ RC createTable(char *name, Schema *schema) {
     strcat(fileName, ".bin");
     createPageFile(fileName);
     BM_BufferPool *buffPool = malloc(sizeof(BM_BufferPool));
-    initBufferPool(buffPool, fileName, RM_BUFF_SIZE, RS_LRU, NULL);
+    openTablePool(buffPool, fileName);
 
     // Allocate the Page Handle
     BM_PageHandle *pHandle = malloc(sizeof(BM_PageHandle));
@@ -127,10 +137,13 @@ Schema *createSchema(int numAttr, char **attrNames, DataType *dataTypes, int *ty
     return schema;
 }
 
-// Returns next empty pageNumber that can be used
+// Returns next empty pageNumber that can be used, a page freed before or a new one at the end of the file
 int getNewPagePos(BM_BufferPool *buff) {
-    int totPages = getNumPagesInFile(buff);
-    return totPages;
+    PageNumber pageNum;
+    if (allocatePoolPage(buff, &pageNum) != RC_OK) {
+        return -1;
+    }
+    return pageNum;
 }
 
 // Open the file with name name + '.bin'
@@ -148,11 +161,13 @@ RC openTable(RM_TableData *rel, char *name) {
     memcpy(fileName, name, (strlen(name) + 1) * sizeof(char));
     strcat(fileName, ".bin");
 
-    RC rc = initBufferPool(buff, fileName, RM_BUFF_SIZE, RS_LRU, NULL);
+    RC rc = openTablePool(buff, fileName);
 
     if (rc != RC_OK) {
         return rc;
     }
+    // scans pin the pages of the table one after the other
+    startReadAhead(buff, 0);
 
     BM_PageHandle *pageHandle = malloc(sizeof(BM_PageHandle));
 
@@ -297,6 +312,7 @@ RC insertRecord(RM_TableData *rel, Record *record) {
 
 RC shutdownRecordManager() {
     contestPool = NULL;
+    sharedPool = NULL;
     return RC_OK;
 }
 
@@ -352,10 +368,16 @@ RC deleteRecord(RM_TableData *rel, RID id) {
 
     // Decrease the number of counter in page
     pageHeader->totRecInPage -= 1;
+    bool pageEmpty = pageHeader->totRecInPage == 0;
 
     markDirty(bm, ph);
     unpinPage(bm, ph);
 
+    // The last record of the page is gone, give the page back to the file so a later insert reuses it
+    if (pageEmpty) {
+        freePoolPage(bm, pageNumber);
+    }
+
     free(ph);
     return RC_OK;
 }
@@ -698,8 +720,11 @@ PageNumber getNextFreePage(BM_BufferPool *buff, int recSize) {
     PageNumber emptyPage = -1;
     RM_PageHeader *pageHeader;
 
-    // Scan all pages in buffer
+    // Scan all pages in buffer, free pages are left to getNewPagePos
     for (int i = 1; i < totPages; ++i) {
+        if (isPoolPageFree(buff, i)) {
+            continue;
+        }
         pinPage(buff, ph, i);
         pageHeader = (RM_PageHeader *) ph->data;
         // If header is marked full, then fetch nextPage
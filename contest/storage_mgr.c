@@ -1,7 +1,109 @@
+#define _GNU_SOURCE
+
 #include "storage_mgr.h"
+#include "async_io.h"
+#include "compressed_file.h"
 #include <stdlib.h>
 #include <errno.h>
 #include <error.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+// Step in which a file in SM_IO_MMAP mode is mapped over its reservation, pages past the end of the file are never touched.
+#define MIN_MAP_SIZE ((size_t) 64 << 20)
+// Address space reserved for the mapping of a file in SM_IO_MMAP mode, a file does not grow past it
+#define MAP_RESERVE_SIZE ((size_t) 64 << 30)
+
+// The header starts with FILE_MAGIC followed by the page size and the FILE_ flags as ints, the rest of it is zeros
+#define FILE_MAGIC "DBPAGES1"
+#define FILE_MAGIC_LEN 8
+#define FILE_COMPRESSED 1
+
+/*
+ * The free page bitmap starts in the header at FREE_MAP_OFFSET, with room for the bits of HEADER_MAP_PAGES pages.
+ * Past them a bitmap page for the next pageSize * 8 pages comes before those pages, so the slot of a page in the
+ * file is its number plus the bitmap pages before it. A file without header has no bitmap.
+ */
+#define FREE_MAP_OFFSET 64
+#define HEADER_MAP_BYTES (SM_FILE_HEADER_SIZE - FREE_MAP_OFFSET)
+#define HEADER_MAP_PAGES (HEADER_MAP_BYTES * 8)
+
+static bool isValidPageSize(int pageSize);
+static RC createFile(char *fileName, int pageSize, int segmentPages, bool compressed);
+static RC growFile(SM_FileHandle *fHandle, int numPages);
+static RC setFreeBit(SM_FileHandle *fHandle, int pageNum, bool isFree);
+static int getTotalNumPages(SM_FileHandle *fHandle);
+static RC transferBlocks(int startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages, bool isWrite);
+
+static RC posixCreate(char *fileName, int pageSize, int segmentPages, bool compressed);
+static RC posixDestroy(char *fileName);
+static RC posixOpen(char *fileName, SM_FileHandle *fHandle, SM_IOMode ioMode);
+static RC posixClose(SM_FileHandle *fHandle);
+static RC posixReadPage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage);
+static RC posixWritePage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage);
+static RC posixReadPages(SM_FileHandle *fHandle, int startPage, int numPages, SM_PageHandle *memPages);
+static RC posixWritePages(SM_FileHandle *fHandle, int startPage, int numPages, SM_PageHandle *memPages);
+static RC posixMapPage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle *memPage);
+static RC posixGrow(SM_FileHandle *fHandle, int numPages);
+static RC posixDiscardPage(SM_FileHandle *fHandle, int pageNum);
+static int posixLocatePage(SM_FileHandle *fHandle, int pageNum, long long *offset);
+static int locateSlot(SM_MgmtInfo *mgmtInfo, int slot, long long *offset);
+static RC readSlot(SM_FileHandle *fHandle, int slot, SM_PageHandle memPage);
+static RC writeSlot(SM_FileHandle *fHandle, int slot, SM_PageHandle memPage);
+static RC posixLoadFreeMap(SM_FileHandle *fHandle);
+static RC posixStoreFreeMap(SM_FileHandle *fHandle, int byte);
+
+static RC writeFileHeader(int fd, int pageSize, int flags);
+static int readFileHeader(int fd, int *flags);
+static int getFileSlot(SM_MgmtInfo *mgmtInfo, int pageNum);
+static int getNumSlots(SM_MgmtInfo *mgmtInfo, int numPages);
+static int getNumPagesInSlots(SM_MgmtInfo *mgmtInfo, int numSlots);
+static int getNumMapPages(SM_MgmtInfo *mgmtInfo, int numPages);
+static int getMapPageSlot(SM_MgmtInfo *mgmtInfo, int mapPage);
+static int getContiguousPages(SM_MgmtInfo *mgmtInfo, int pageNum);
+static size_t getSegmentStart(SM_MgmtInfo *mgmtInfo, int segment);
+static char *getMappedPage(SM_MgmtInfo *mgmtInfo, int slot);
+static RC mapFile(SM_MgmtInfo *mgmtInfo, size_t fileSize);
+static RC extendMapping(SM_MgmtInfo *mgmtInfo, size_t fileSize);
+static RC extendFile(SM_MgmtInfo *mgmtInfo, int fd, size_t newSize, size_t maxReserve);
+static char *getSegmentName(const char *fileName, int segment);
+static int readSegmentPages(const char *fileName);
+static RC openSegments(SM_FileHandle *fHandle, int flags);
+static void closeSegments(SM_MgmtInfo *mgmtInfo);
+static bool needsAlignedCopy(SM_FileHandle *fHandle, SM_PageHandle memPage);
+static RC transferPagesVectored(int startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages,
+                                bool isWrite);
+static RC transferVector(int fd, struct iovec *iov, int iovCount, off_t offset, bool isWrite);
+
+const SM_Backend SM_POSIX_BACKEND = {
+        "posix",
+        posixCreate,
+        posixDestroy,
+        posixOpen,
+        posixClose,
+        posixReadPage,
+        posixWritePage,
+        posixReadPages,
+        posixWritePages,
+        posixMapPage,
+        posixGrow,
+        posixDiscardPage,
+        posixLocatePage,
+        posixLoadFreeMap,
+        posixStoreFreeMap
+};
+
+// Backend of the files created, opened and destroyed, set once at start up and read without a lock
+static const SM_Backend *storageBackend = &SM_POSIX_BACKEND;
 
 // Storage manager Initialization
 //  Reserved for future use
@@ -9,128 +111,146 @@ void initStorageManager(void) {
     printf("\nStorage Manager");
 }
 
+void setStorageBackend(const SM_Backend *backend) {
+    storageBackend = backend != NULL ? backend : &SM_POSIX_BACKEND;
+}
+
+const SM_Backend *getStorageBackend(void) {
+    return storageBackend;
+}
+
 // Creates a pagefile with name given in *filename.
 //  Add an empty page of size PAGE_SIZE to the file.
 RC createPageFile(char *filename) {
-    FILE *fp;
-    fp = fopen(filename, "w");
-    if (fp == NULL) {
-        return RC_FILE_NOT_FOUND;
-    }
-
-    size_t i;
-    for (i = 0; i < PAGE_SIZE; i++) {
-        fprintf(fp, "%c", '\0');
-    }
+    return createPageFileWithPageSize(filename, PAGE_SIZE);
+}
 
-    fclose(fp);
-    return RC_OK;
+// Creates a pagefile of pages of pageSize bytes.
+//  The header recording pageSize is written, followed by an empty page.
+RC createPageFileWithPageSize(char *fileName, int pageSize) {
+    return createFile(fileName, pageSize, 0, FALSE);
 }
 
-// Open pageFile with name *fileName and store book-keeping details in *fHandle
-RC openPageFile(char *fileName, SM_FileHandle *fHandle) {
-    FILE *fp;
+// Creates a pagefile of pages of pageSize bytes stored compressed, see compressed_file.h.
+//  Its page map holds an empty page.
+RC createCompressedPageFile(char *fileName, int pageSize) {
+    return createFile(fileName, pageSize, 0, TRUE);
+}
 
-    fp = fopen(fileName, "r+");
-    if (fp == NULL) {
-        return RC_FILE_NOT_FOUND;
+// Creates a pagefile of pages of pageSize bytes split in to segment files of segmentPages pages.
+//  The first segment holds an empty page, more segments are added as the file grows.
+RC createSegmentedPageFile(char *fileName, int pageSize, int segmentPages) {
+    if (segmentPages < 1) {
+        return RC_CREATE_FAILED;
     }
+    return createFile(fileName, pageSize, segmentPages, FALSE);
+}
 
-    //struct stat st;
-    //int rc = stat(fileName, &st);
-    int rc = fseek(fp, 0, SEEK_END);
-    if (rc < 0) {
-        return RC_OPEN_FAILED;
-    }
+// Open pageFile with name *fileName and store book-keeping details in *fHandle
+RC openPageFile(char *fileName, SM_FileHandle *fHandle) {
+    return openPageFileMode(fileName, fHandle, SM_IO_PREAD);
+}
 
-    //fHandle->totalNumPages = (int) (st.st_size / PAGE_SIZE);
-    fHandle->totalNumPages = (int) (ftell(fp) / PAGE_SIZE);
+// Open pageFile like openPageFile, accessing its pages as given by ioMode
+RC openPageFileMode(char *fileName, SM_FileHandle *fHandle, SM_IOMode ioMode) {
+    SM_MgmtInfo *mgmtInfo = malloc(sizeof(SM_MgmtInfo));
+    int byte;
 
-    rc = fseek(fp, 0, SEEK_SET);
-    if (rc < 0) {
-        return RC_OPEN_FAILED;
-    }
+    mgmtInfo->backend = getStorageBackend();
+    mgmtInfo->backendData = NULL;
+    mgmtInfo->fd = -1;
+    mgmtInfo->ioMode = ioMode;
+    mgmtInfo->map = NULL;
+    mgmtInfo->mapSize = 0;
+    mgmtInfo->mapReserved = 0;
+    mgmtInfo->asyncIO = NULL;
+    mgmtInfo->growthFactor = SM_DEFAULT_GROWTH_FACTOR;
+    mgmtInfo->reservedSize = 0;
+    mgmtInfo->segmentPages = 0;
+    mgmtInfo->numSegments = 1;
+    mgmtInfo->segmentFds = NULL;
+    mgmtInfo->pageSize = PAGE_SIZE;
+    mgmtInfo->headerSize = 0;
+    mgmtInfo->freeMap = NULL;
+    mgmtInfo->freeMapBytes = 0;
+    mgmtInfo->headerFd = -1;
+    mgmtInfo->numFreePages = 0;
+    mgmtInfo->freeHint = 0;
+    mgmtInfo->punchHoles = FALSE;
+    mgmtInfo->compression = NULL;
 
+    fHandle->totalNumPages = 0;
     fHandle->curPagePos = 0;
     fHandle->fileName = fileName;
-    fHandle->mgmtInfo = malloc(sizeof(SM_MgmtInfo));
-    fHandle->mgmtInfo->fd = fp;
+    fHandle->mgmtInfo = mgmtInfo;
 
+    RC rc = mgmtInfo->backend->open(fileName, fHandle, ioMode);
+    if (rc != RC_OK) {
+        free(mgmtInfo);
+        fHandle->mgmtInfo = NULL;
+        return rc;
+    }
+
+    if (mgmtInfo->backend->loadFreeMap(fHandle) != RC_OK) {
+        closePageFile(fHandle);
+        return RC_OPEN_FAILED;
+    }
+    for (byte = 0; byte < mgmtInfo->freeMapBytes; ++byte) {
+        mgmtInfo->numFreePages += __builtin_popcount(mgmtInfo->freeMap[byte]);
+    }
     return RC_OK;
 
 }
 
 // closePage file with file handle pointed by the fHandle.
 RC closePageFile(SM_FileHandle *fHandle) {
+    SM_MgmtInfo *mgmtInfo = fHandle->mgmtInfo;
 
-    if (fHandle->mgmtInfo->fd == NULL) {
+    if (mgmtInfo == NULL) {
         return RC_FILE_HANDLE_NOT_INIT;
     }
-    fflush(fHandle->mgmtInfo->fd);
-    int rc = fclose(fHandle->mgmtInfo->fd);
-
-    if (rc == 0) {
-        free(fHandle->mgmtInfo);
-        return RC_OK;
-    } else {
-        return RC_FILE_NOT_FOUND;
+    if (mgmtInfo->asyncIO != NULL) {
+        shutdownAsyncIO(fHandle);
     }
+    RC rc = mgmtInfo->backend->close(fHandle);
+
+    free(mgmtInfo->freeMap);
+    free(mgmtInfo);
+    fHandle->mgmtInfo = NULL;
+    return rc;
 }
 
 // Delete the pageFile with name fileName
 RC destroyPageFile(char *fileName) {
-    if (remove(fileName) != 0) {
-        switch (errno){
-
-            case EACCES:
-                printf("Write permission is denied for the directory from which the file is to be removed, or the directory has the sticky bit set and you do not own the file.");
-                break;
-            case EBUSY:
-                printf("This error indicates that the file is being used by the system in such a way that it can’t be unlinked. For example, you might see this error if the file name specifies the root directory or a mount point for a file system.");
-                break;
-            case ENOENT:
-                printf("The file name to be deleted doesn’t exist.");
-                break;
-            case EPERM:
-                printf("On some systems unlink cannot be used to delete the name of a directory, or at least can only be used this way by a privileged user. To avoid such problems, use rmdir to delete directories. (On GNU/Linux and GNU/Hurd systems unlink can never delete the name of a directory.)");
-                break;
-            case EROFS:
-                printf("The directory containing the file name to be deleted is on a read-only file system and can’t be modified.");
-                break;
-            default:
-                printf("Unknown error deleting file");
-
-        }
-        return RC_FILE_NOT_FOUND;
-    } else {
-        return RC_OK;
-    }
+    return getStorageBackend()->destroy(fileName);
 }
 
 
 // Read a page with number pageNum, from file pointed by fHandle.
 // Store the page data in the buffer memPage.
 RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
-    if (pageNum < 0 || pageNum > ((fHandle->totalNumPages)) - 1) {
-        return RC_READ_FAILED;
+    RC rc = preadBlock(pageNum, fHandle, memPage);
+    if (rc != RC_OK) {
+        return rc;
     }
+    fHandle->curPagePos = pageNum + 1;
+    return RC_OK;
+}
 
-    if (fHandle->curPagePos != pageNum) {
-        long offSet = pageNum * PAGE_SIZE;
-        int rc = fseek(fHandle->mgmtInfo->fd, offSet, SEEK_SET);
-
-        if (rc != 0) {
-            return RC_READ_FAILED;
-        }
-        fHandle->curPagePos = pageNum;
+// Read the page pageNum in to memPage without moving the current page position.
+RC preadBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    if (pageNum < 0 || pageNum > getTotalNumPages(fHandle) - 1) {
+        return RC_READ_FAILED;
     }
+    return fHandle->mgmtInfo->backend->readPage(fHandle, pageNum, memPage);
+}
 
-    size_t num_items = fread(memPage, PAGE_SIZE, 1, fHandle->mgmtInfo->fd);
-    if (num_items != 1) {
+// Point *memPage at page pageNum where the backend keeps it, in the mapping of the file on disk, nothing is copied.
+RC readMappedBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle *memPage) {
+    if (pageNum < 0 || pageNum > getTotalNumPages(fHandle) - 1) {
         return RC_READ_FAILED;
     }
-    fHandle->curPagePos = pageNum + 1;
-    return RC_OK;
+    return fHandle->mgmtInfo->backend->mapPage(fHandle, pageNum, memPage);
 }
 
 // Get the page number to which the fHandle is currently pointing.
@@ -184,81 +304,941 @@ RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
 // Write to the page of number 'pageNum' with data in memPage.
 // The file to write is given by fHandle
 RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    RC rc = pwriteBlock(pageNum, fHandle, memPage);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    fHandle->curPagePos = pageNum + 1;
+    return RC_OK;
+
+}
+
+// Write memPage to the page pageNum without moving the current page position.
+RC pwriteBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
 
-    if (fHandle->mgmtInfo->fd == NULL) {
+    if (fHandle->mgmtInfo == NULL) {
         return RC_WRITE_FAILED;
-    } else if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
+    } else if (pageNum < 0 || pageNum >= getTotalNumPages(fHandle)) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    return fHandle->mgmtInfo->backend->writePage(fHandle, pageNum, memPage);
+}
+
+// Read the numPages pages from startPage, page startPage + i in to memPages[i]
+RC readBlocks(int startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages) {
+    return transferBlocks(startPage, numPages, fHandle, memPages, FALSE);
+}
+
+// Write memPages[i] to page startPage + i for the numPages pages from startPage
+RC writeBlocks(int startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages) {
+    return transferBlocks(startPage, numPages, fHandle, memPages, TRUE);
+}
+
+// Write to the currentPage pointed by fHandle with data from memPage
+RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    return writeBlock(getBlockPos(fHandle), fHandle, memPage);
+}
+
+// Add an empty page to the end of the file pointed by fHandle.
+RC appendEmptyBlock(SM_FileHandle *fHandle) {
+
+    if (fHandle->mgmtInfo == NULL) {
+        return RC_FILE_NOT_FOUND;
+    }
+
+    RC rc = growFile(fHandle, fHandle->totalNumPages + 1);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    fHandle->curPagePos = (fHandle->totalNumPages + 1);
+    return RC_OK;
+
+}
+
+// If there are less than numberOfPages, increase the number of pages to numberOfPages by appending empty pages.
+// If there are more (or equal) pages than numberOfPages, we are good.!!, do nothing.
+RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle) {
+
+    if (fHandle->totalNumPages < numberOfPages) {
+        return growFile(fHandle, numberOfPages);
+    }
+    return RC_OK;
+}
+
+// Set by how much the disk space reserved for the file grows, once the file outgrows it
+RC setFileGrowthFactor(SM_FileHandle *fHandle, double growthFactor) {
+    if (growthFactor < 1.0) {
+        return RC_ALLOCATION_FAILED;
+    }
+    fHandle->mgmtInfo->growthFactor = growthFactor;
+    return RC_OK;
+}
+
+// Hand out the lowest free page in *pageNum, or add a page to the end of the file if no page is free
+RC allocatePage(SM_FileHandle *fHandle, int *pageNum) {
+    SM_MgmtInfo *mgmtInfo = fHandle->mgmtInfo;
+    int byte;
+
+    for (byte = mgmtInfo->freeHint / 8; mgmtInfo->numFreePages > 0 && byte < mgmtInfo->freeMapBytes; ++byte) {
+        if (mgmtInfo->freeMap[byte] != 0) {
+            int page = byte * 8 + __builtin_ctz(mgmtInfo->freeMap[byte]);
+            RC rc = setFreeBit(fHandle, page, FALSE);
+            if (rc != RC_OK) {
+                return rc;
+            }
+            mgmtInfo->freeHint = page + 1;
+            *pageNum = page;
+            return RC_OK;
+        }
+    }
+
+    int numPages = fHandle->totalNumPages;
+    RC rc = growFile(fHandle, numPages + 1);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    *pageNum = numPages;
+    return RC_OK;
+}
+
+// Mark page pageNum free so allocatePage can hand it out again, the backend may give its space back
+RC freePage(SM_FileHandle *fHandle, int pageNum) {
+    SM_MgmtInfo *mgmtInfo = fHandle->mgmtInfo;
+
+    if (pageNum < 0 || pageNum >= getTotalNumPages(fHandle)) {
         return RC_READ_NON_EXISTING_PAGE;
     }
+    if (isPageFree(fHandle, pageNum)) {
+        return RC_PAGE_ALREADY_FREE;
+    }
+
+    RC rc = setFreeBit(fHandle, pageNum, TRUE);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (pageNum < mgmtInfo->freeHint) {
+        mgmtInfo->freeHint = pageNum;
+    }
+    return mgmtInfo->backend->discardPage(fHandle, pageNum);
+}
+
+bool isPageFree(SM_FileHandle *fHandle, int pageNum) {
+    SM_MgmtInfo *mgmtInfo = fHandle->mgmtInfo;
+
+    if (pageNum < 0 || pageNum / 8 >= mgmtInfo->freeMapBytes) {
+        return FALSE;
+    }
+    return (mgmtInfo->freeMap[pageNum / 8] & (1 << (pageNum % 8))) != 0;
+}
 
+int getNumFreePages(SM_FileHandle *fHandle) {
+    return fHandle->mgmtInfo->numFreePages;
+}
 
-    if (fHandle->curPagePos != pageNum) {
+RC setHolePunching(SM_FileHandle *fHandle, bool punchHoles) {
+    fHandle->mgmtInfo->punchHoles = punchHoles;
+    return RC_OK;
+}
+
+int getNumPages(SM_FileHandle *fHandle) {
+    return fHandle->totalNumPages;
+}
+
+int getPageSize(SM_FileHandle *fHandle) {
+    return fHandle->mgmtInfo->pageSize;
+}
+
+int getPageLocation(SM_FileHandle *fHandle, int pageNum, long long *offset) {
+    return fHandle->mgmtInfo->backend->locatePage(fHandle, pageNum, offset);
+}
+
+// Page sizes are powers of two, so a page never straddles a block of a smaller size
+static bool isValidPageSize(int pageSize) {
+    return pageSize >= SM_MIN_PAGE_SIZE && pageSize <= SM_MAX_PAGE_SIZE && (pageSize & (pageSize - 1)) == 0;
+}
+
+static RC createFile(char *fileName, int pageSize, int segmentPages, bool compressed) {
+    if (!isValidPageSize(pageSize)) {
+        return RC_INVALID_PAGE_SIZE;
+    }
+    return getStorageBackend()->create(fileName, pageSize, segmentPages, compressed);
+}
 
-        int offset = pageNum * PAGE_SIZE;
-        int rc = fseek(fHandle->mgmtInfo->fd, offset, SEEK_SET);
-        if (rc < 0) {
+// Grow the file to numPages pages. The new pages read as zeros, nothing is written.
+static RC growFile(SM_FileHandle *fHandle, int numPages) {
+    RC rc = fHandle->mgmtInfo->backend->grow(fHandle, numPages);
+    if (rc != RC_OK) {
+        return rc;
+    }
+
+    // Positional reads and writes on other threads check the page count, publish it once the pages exist
+    __atomic_store_n(&fHandle->totalNumPages, numPages, __ATOMIC_RELEASE);
+    return RC_OK;
+}
+
+/*
+ * Set or clear the bit of pageNum in the bitmap and have the backend keep its byte.
+ * The bitmap is allocated with the first free page and grows to hold the bit.
+ */
+static RC setFreeBit(SM_FileHandle *fHandle, int pageNum, bool isFree) {
+    SM_MgmtInfo *mgmtInfo = fHandle->mgmtInfo;
+    int byte = pageNum / 8;
+    unsigned char bit = (unsigned char) (1 << (pageNum % 8));
+
+    if (byte >= mgmtInfo->freeMapBytes) {
+        int newBytes = mgmtInfo->freeMapBytes * 2 > byte + 1 ? mgmtInfo->freeMapBytes * 2 : byte + 1;
+        unsigned char *newMap = realloc(mgmtInfo->freeMap, (size_t) newBytes);
+        if (newMap == NULL) {
             return RC_WRITE_FAILED;
         }
+        memset(newMap + mgmtInfo->freeMapBytes, 0, (size_t) (newBytes - mgmtInfo->freeMapBytes));
+        mgmtInfo->freeMap = newMap;
+        mgmtInfo->freeMapBytes = newBytes;
     }
 
-    size_t num_items = fwrite(memPage, PAGE_SIZE, 1, fHandle->mgmtInfo->fd);
-    if (num_items != 1) {
+    unsigned char old = mgmtInfo->freeMap[byte];
+    mgmtInfo->freeMap[byte] = isFree ? (unsigned char) (old | bit) : (unsigned char) (old & ~bit);
+    if (mgmtInfo->backend->storeFreeMap(fHandle, byte) != RC_OK) {
+        mgmtInfo->freeMap[byte] = old;
         return RC_WRITE_FAILED;
     }
-    fHandle->curPagePos = pageNum + 1;
+    mgmtInfo->numFreePages += isFree ? 1 : -1;
     return RC_OK;
+}
+
+static RC transferBlocks(int startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages, bool isWrite) {
+    if (fHandle->mgmtInfo == NULL) {
+        return isWrite ? RC_WRITE_FAILED : RC_READ_FAILED;
+    }
+    if (startPage < 0 || numPages < 0 || startPage + numPages > getTotalNumPages(fHandle)) {
+        return isWrite ? RC_READ_NON_EXISTING_PAGE : RC_READ_FAILED;
+    }
 
+    const SM_Backend *backend = fHandle->mgmtInfo->backend;
+    return isWrite ? backend->writePages(fHandle, startPage, numPages, memPages)
+                   : backend->readPages(fHandle, startPage, numPages, memPages);
 }
 
-// Write to the currentPage pointed by fHandle with data from memPage
-RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-    return writeBlock(getBlockPos(fHandle), fHandle, memPage);
+static int getTotalNumPages(SM_FileHandle *fHandle) {
+    return __atomic_load_n(&fHandle->totalNumPages, __ATOMIC_ACQUIRE);
 }
 
-// Add an empty page to the end of the file pointed by fHandle.
-RC appendEmptyBlock(SM_FileHandle *fHandle) {
+/************************************************************
+ *                    POSIX backend                         *
+ ************************************************************/
 
-    size_t i;
+// Create the file with its header and the room for an empty page, dropping the forks of a file created before under the name
+static RC posixCreate(char *fileName, int pageSize, int segmentPages, bool compressed) {
+    int flags = compressed ? FILE_COMPRESSED : 0;
+    int fd;
 
-    FILE *fp = fHandle->mgmtInfo->fd;
+    fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        return RC_FILE_NOT_FOUND;
+    }
+    char *pageMapName = getPageMapName(fileName);
+    remove(pageMapName);
+    free(pageMapName);
 
-    if (fp == NULL) {
+    RC rc = writeFileHeader(fd, pageSize, flags);
+    // the page reads back as zeros, a compressed file keeps its pages in chunks written later
+    if (rc == RC_OK && !compressed && ftruncate(fd, (off_t) SM_FILE_HEADER_SIZE + pageSize) != 0) {
+        rc = RC_CREATE_FAILED;
+    }
+    close(fd);
+    if (rc != RC_OK) {
+        return rc;
+    }
+
+    if (compressed) {
+        return createPageMap(fileName);
+    }
+    if (segmentPages > 0) {
+        char *segmentsName = getSegmentName(fileName, -1);
+        FILE *fp = fopen(segmentsName, "w");
+        free(segmentsName);
+        if (fp == NULL) {
+            return RC_CREATE_FAILED;
+        }
+        fprintf(fp, "%d\n", segmentPages);
+        fclose(fp);
+    }
+    return RC_OK;
+}
+
+static RC posixDestroy(char *fileName) {
+    if (readSegmentPages(fileName) > 0) {
+        int segment;
+        for (segment = 1; segment < SM_MAX_SEGMENTS; ++segment) {
+            char *segmentName = getSegmentName(fileName, segment);
+            int removed = remove(segmentName);
+            free(segmentName);
+            if (removed != 0) {
+                break;
+            }
+        }
+        char *segmentsName = getSegmentName(fileName, -1);
+        remove(segmentsName);
+        free(segmentsName);
+    }
+    char *pageMapName = getPageMapName(fileName);
+    remove(pageMapName);
+    free(pageMapName);
+
+    if (remove(fileName) != 0) {
+        switch (errno){
+
+            case EACCES:
+                printf("Write permission is denied for the directory from which the file is to be removed, or the directory has the sticky bit set and you do not own the file.");
+                break;
+            case EBUSY:
+                printf("This error indicates that the file is being used by the system in such a way that it can’t be unlinked. For example, you might see this error if the file name specifies the root directory or a mount point for a file system.");
+                break;
+            case ENOENT:
+                printf("The file name to be deleted doesn’t exist.");
+                break;
+            case EPERM:
+                printf("On some systems unlink cannot be used to delete the name of a directory, or at least can only be used this way by a privileged user. To avoid such problems, use rmdir to delete directories. (On GNU/Linux and GNU/Hurd systems unlink can never delete the name of a directory.)");
+                break;
+            case EROFS:
+                printf("The directory containing the file name to be deleted is on a read-only file system and can’t be modified.");
+                break;
+            default:
+                printf("Unknown error deleting file");
+
+        }
+        return RC_FILE_NOT_FOUND;
+    } else {
+        return RC_OK;
+    }
+}
+
+static RC posixOpen(char *fileName, SM_FileHandle *fHandle, SM_IOMode ioMode) {
+    SM_MgmtInfo *mgmtInfo = fHandle->mgmtInfo;
+    int fd;
+
+    int flags = O_RDWR | (ioMode == SM_IO_DIRECT ? O_DIRECT : 0);
+    fd = open(fileName, O_RDWR);
+    if (fd < 0) {
         return RC_FILE_NOT_FOUND;
     }
 
-    int rc = fseek(fp, 0, SEEK_END);
-    if (rc < 0) {
+    // The header is read before O_DIRECT is set, it is smaller than a block
+    int fileFlags = 0;
+    int pageSize = readFileHeader(fd, &fileFlags);
+    size_t headerSize = SM_FILE_HEADER_SIZE;
+    if (pageSize == 0) {
+        pageSize = PAGE_SIZE;
+        headerSize = 0;
+    }
+    // the file system may not support O_DIRECT, compressed pages are neither mapped nor block aligned
+    if (!isValidPageSize(pageSize) || ((fileFlags & FILE_COMPRESSED) && ioMode != SM_IO_PREAD)
+        || (flags != O_RDWR && fcntl(fd, F_SETFL, flags) != 0)) {
+        close(fd);
+        return RC_OPEN_FAILED;
+    }
+
+    struct stat st;
+    int rc = fstat(fd, &st);
+    if (rc < 0 || (size_t) st.st_size < headerSize) {
+        close(fd);
+        return RC_OPEN_FAILED;
+    }
+
+    // counted in slots until the bitmap pages are taken out below
+    fHandle->totalNumPages = (int) (((size_t) st.st_size - headerSize) / pageSize);
+    mgmtInfo->fd = fd;
+    mgmtInfo->headerFd = fd;
+    mgmtInfo->reservedSize = (size_t) st.st_size;
+    mgmtInfo->segmentPages = readSegmentPages(fileName);
+    mgmtInfo->pageSize = pageSize;
+    mgmtInfo->headerSize = headerSize;
+
+    // a segmented file is not mapped, its segments would need one mapping each
+    if ((mgmtInfo->segmentPages > 0 && (ioMode == SM_IO_MMAP || openSegments(fHandle, flags) != RC_OK))
+        || (ioMode == SM_IO_MMAP && mapFile(mgmtInfo, (size_t) st.st_size) != RC_OK)
+        || ((fileFlags & FILE_COMPRESSED) && openCompressedFile(fHandle) != RC_OK)) {
+        posixClose(fHandle);
+        return RC_OPEN_FAILED;
+    }
+    // the bitmap bytes in the header are too small for an O_DIRECT write, they go through a second descriptor
+    if (flags != O_RDWR && headerSize > 0 && (mgmtInfo->headerFd = open(fileName, O_RDWR)) < 0) {
+        mgmtInfo->headerFd = fd;
+        posixClose(fHandle);
+        return RC_OPEN_FAILED;
+    }
+    fHandle->totalNumPages = getNumPagesInSlots(mgmtInfo, fHandle->totalNumPages);
+    return RC_OK;
+}
+
+static RC posixClose(SM_FileHandle *fHandle) {
+    SM_MgmtInfo *mgmtInfo = fHandle->mgmtInfo;
+
+    if (mgmtInfo->map != NULL) {
+        munmap(mgmtInfo->map, mgmtInfo->mapReserved);
+    }
+    closeSegments(mgmtInfo);
+    if (mgmtInfo->compression != NULL) {
+        closeCompressedFile(fHandle);
+    }
+    if (mgmtInfo->headerFd != mgmtInfo->fd) {
+        close(mgmtInfo->headerFd);
+    }
+    return close(mgmtInfo->fd) == 0 ? RC_OK : RC_FILE_NOT_FOUND;
+}
+
+static RC posixReadPage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage) {
+    return readSlot(fHandle, getFileSlot(fHandle->mgmtInfo, pageNum), memPage);
+}
+
+static RC posixWritePage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage) {
+    return writeSlot(fHandle, getFileSlot(fHandle->mgmtInfo, pageNum), memPage);
+}
+
+// Read the page or bitmap page at slot
+static RC readSlot(SM_FileHandle *fHandle, int slot, SM_PageHandle memPage) {
+    size_t pageSize = (size_t) fHandle->mgmtInfo->pageSize;
+    if (fHandle->mgmtInfo->map != NULL) {
+        memcpy(memPage, getMappedPage(fHandle->mgmtInfo, slot), pageSize);
+        return RC_OK;
+    }
+    if (fHandle->mgmtInfo->compression != NULL) {
+        return readCompressedPage(fHandle, slot, memPage);
+    }
+    long long offset;
+    int fd = locateSlot(fHandle->mgmtInfo, slot, &offset);
+    if (needsAlignedCopy(fHandle, memPage)) {
+        char *aligned;
+        if (posix_memalign((void **) &aligned, PAGE_SIZE, pageSize) != 0) {
+            return RC_READ_FAILED;
+        }
+        RC rc = readFully(fd, aligned, pageSize, (off_t) offset);
+        memcpy(memPage, aligned, pageSize);
+        free(aligned);
+        return rc;
+    }
+    return readFully(fd, memPage, pageSize, (off_t) offset);
+}
+
+// Write the page or bitmap page at slot
+static RC writeSlot(SM_FileHandle *fHandle, int slot, SM_PageHandle memPage) {
+    size_t pageSize = (size_t) fHandle->mgmtInfo->pageSize;
+    if (fHandle->mgmtInfo->map != NULL) {
+        memcpy(getMappedPage(fHandle->mgmtInfo, slot), memPage, pageSize);
+        return RC_OK;
+    }
+    if (fHandle->mgmtInfo->compression != NULL) {
+        return writeCompressedPage(fHandle, slot, memPage);
+    }
+    long long offset;
+    int fd = locateSlot(fHandle->mgmtInfo, slot, &offset);
+    if (needsAlignedCopy(fHandle, memPage)) {
+        char *aligned;
+        if (posix_memalign((void **) &aligned, PAGE_SIZE, pageSize) != 0) {
+            return RC_WRITE_FAILED;
+        }
+        memcpy(aligned, memPage, pageSize);
+        RC rc = writeFully(fd, aligned, pageSize, (off_t) offset);
+        free(aligned);
+        return rc;
+    }
+    return writeFully(fd, memPage, pageSize, (off_t) offset);
+}
+
+static RC posixReadPages(SM_FileHandle *fHandle, int startPage, int numPages, SM_PageHandle *memPages) {
+    return transferPagesVectored(startPage, numPages, fHandle, memPages, FALSE);
+}
+
+static RC posixWritePages(SM_FileHandle *fHandle, int startPage, int numPages, SM_PageHandle *memPages) {
+    return transferPagesVectored(startPage, numPages, fHandle, memPages, TRUE);
+}
+
+static RC posixMapPage(SM_FileHandle *fHandle, int pageNum, SM_PageHandle *memPage) {
+    if (fHandle->mgmtInfo->map == NULL) {
+        return RC_FILE_NOT_MAPPED;
+    }
+    *memPage = getMappedPage(fHandle->mgmtInfo, getFileSlot(fHandle->mgmtInfo, pageNum));
+    return RC_OK;
+}
+
+// A segmented file fills its last segment, then adds segment files. The bitmap pages added read as zeros.
+static RC posixGrow(SM_FileHandle *fHandle, int numPages) {
+    SM_MgmtInfo *mgmtInfo = fHandle->mgmtInfo;
+    size_t pageSize = (size_t) mgmtInfo->pageSize;
+    int numSlots = getNumSlots(mgmtInfo, numPages);
+    RC rc;
+
+    if (mgmtInfo->compression != NULL) {
+        rc = growCompressedFile(fHandle, numSlots);
+    } else if (mgmtInfo->segmentPages == 0) {
+        size_t newSize = mgmtInfo->headerSize + (size_t) numSlots * pageSize;
+        if (mgmtInfo->map != NULL && newSize > mgmtInfo->mapSize && extendMapping(mgmtInfo, newSize) != RC_OK) {
+            return RC_ALLOCATION_FAILED;
+        }
+        rc = extendFile(mgmtInfo, mgmtInfo->fd, newSize, 0);
+    } else {
+        int lastSegment = (numSlots - 1) / mgmtInfo->segmentPages;
+        int segment;
+
+        if (lastSegment >= SM_MAX_SEGMENTS) {
+            return RC_ALLOCATION_FAILED;
+        }
+        rc = RC_OK;
+        for (segment = mgmtInfo->numSegments - 1; segment <= lastSegment && rc == RC_OK; ++segment) {
+            if (segment == mgmtInfo->numSegments) {
+                char *segmentName = getSegmentName(fHandle->fileName, segment);
+                int fd = open(segmentName, O_RDWR | O_CREAT | (mgmtInfo->ioMode == SM_IO_DIRECT ? O_DIRECT : 0), 0666);
+                free(segmentName);
+                if (fd < 0) {
+                    return RC_ALLOCATION_FAILED;
+                }
+                mgmtInfo->segmentFds[segment] = fd;
+                mgmtInfo->numSegments++;
+                mgmtInfo->reservedSize = 0;
+            }
+            int pagesInSegment = segment < lastSegment ? mgmtInfo->segmentPages
+                                                       : numSlots - segment * mgmtInfo->segmentPages;
+            size_t start = getSegmentStart(mgmtInfo, segment);
+            rc = extendFile(mgmtInfo, mgmtInfo->segmentFds[segment], start + (size_t) pagesInSegment * pageSize,
+                            start + (size_t) mgmtInfo->segmentPages * pageSize);
+        }
+    }
+    return rc;
+}
+
+// Release the chunks of a compressed page, or punch a hole for the page if asked to
+static RC posixDiscardPage(SM_FileHandle *fHandle, int pageNum) {
+    SM_MgmtInfo *mgmtInfo = fHandle->mgmtInfo;
+
+    if (mgmtInfo->compression != NULL) {
+        // the chunks of the page are reused by the next pages written
+        return releaseCompressedPage(fHandle, getFileSlot(mgmtInfo, pageNum));
+    }
+    if (mgmtInfo->punchHoles) {
+        long long offset;
+        int fd = posixLocatePage(fHandle, pageNum, &offset);
+        if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t) offset, mgmtInfo->pageSize) != 0
+            && errno != EOPNOTSUPP) {
+            return RC_WRITE_FAILED;
+        }
+    }
+    return RC_OK;
+}
+
+static int posixLocatePage(SM_FileHandle *fHandle, int pageNum, long long *offset) {
+    return locateSlot(fHandle->mgmtInfo, getFileSlot(fHandle->mgmtInfo, pageNum), offset);
+}
+
+// File descriptor and offset of slot, -1 for a compressed file
+static int locateSlot(SM_MgmtInfo *mgmtInfo, int slot, long long *offset) {
+    if (mgmtInfo->compression != NULL) {
+        *offset = 0;
+        return -1;
+    }
+    if (mgmtInfo->segmentPages == 0) {
+        *offset = (long long) mgmtInfo->headerSize + (long long) slot * mgmtInfo->pageSize;
+        return mgmtInfo->fd;
+    }
+    int segment = slot / mgmtInfo->segmentPages;
+    *offset = (long long) getSegmentStart(mgmtInfo, segment)
+              + (long long) (slot % mgmtInfo->segmentPages) * mgmtInfo->pageSize;
+    return mgmtInfo->segmentFds[segment];
+}
+
+// Read the free page bitmap from the header and the bitmap pages of the file, a file without header has none
+static RC posixLoadFreeMap(SM_FileHandle *fHandle) {
+    SM_MgmtInfo *mgmtInfo = fHandle->mgmtInfo;
+    int pageSize = mgmtInfo->pageSize;
+    int mapPage;
+
+    if (mgmtInfo->headerSize == 0) {
+        return RC_OK;
+    }
+    int numMapPages = getNumMapPages(mgmtInfo, fHandle->totalNumPages);
+    mgmtInfo->freeMap = malloc((size_t) HEADER_MAP_BYTES + (size_t) numMapPages * pageSize);
+    if (mgmtInfo->freeMap == NULL) {
+        return RC_OPEN_FAILED;
+    }
+    mgmtInfo->freeMapBytes = HEADER_MAP_BYTES + numMapPages * pageSize;
+    if (readFully(mgmtInfo->headerFd, (char *) mgmtInfo->freeMap, HEADER_MAP_BYTES, FREE_MAP_OFFSET) != RC_OK) {
+        return RC_OPEN_FAILED;
+    }
+    for (mapPage = 0; mapPage < numMapPages; ++mapPage) {
+        char *bytes = (char *) mgmtInfo->freeMap + HEADER_MAP_BYTES + (size_t) mapPage * pageSize;
+        if (readSlot(fHandle, getMapPageSlot(mgmtInfo, mapPage), bytes) != RC_OK) {
+            return RC_OPEN_FAILED;
+        }
+    }
+    return RC_OK;
+}
+
+/*
+ * Write the byte to the header, or rewrite the bitmap page holding it. The bitmap page exists as the
+ * page the byte covers does, its bytes past the end of freeMap are zeros.
+ * A file without header cannot keep free pages.
+ */
+static RC posixStoreFreeMap(SM_FileHandle *fHandle, int byte) {
+    SM_MgmtInfo *mgmtInfo = fHandle->mgmtInfo;
+    int pageSize = mgmtInfo->pageSize;
+
+    if (mgmtInfo->headerSize == 0) {
+        return RC_WRITE_FAILED;
+    }
+    if (byte < HEADER_MAP_BYTES) {
+        return writeFully(mgmtInfo->headerFd, (char *) &mgmtInfo->freeMap[byte], 1, (off_t) (FREE_MAP_OFFSET + byte));
+    }
+
+    int mapPage = (byte - HEADER_MAP_BYTES) / pageSize;
+    int start = HEADER_MAP_BYTES + mapPage * pageSize;
+    int length = mgmtInfo->freeMapBytes - start < pageSize ? mgmtInfo->freeMapBytes - start : pageSize;
+    char *bytes = calloc(1, (size_t) pageSize);
+    if (bytes == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    memcpy(bytes, mgmtInfo->freeMap + start, (size_t) length);
+    RC rc = writeSlot(fHandle, getMapPageSlot(mgmtInfo, mapPage), bytes);
+    free(bytes);
+    return rc;
+}
+
+/*
+ * Extend the file fd, the file (segment) at the end of the page file, to newSize.
+ * Disk space is reserved beyond the end of the file in extents: once the file outgrows the reserved space,
+ * growthFactor times the file size is reserved (at least SM_MIN_EXTENT_PAGES more, at most maxReserve if it
+ * is not 0) with fallocate, without changing the file size. Then the file size is set with ftruncate.
+ * If the file system cannot reserve space the file is only extended.
+ */
+static RC extendFile(SM_MgmtInfo *mgmtInfo, int fd, size_t newSize, size_t maxReserve) {
+    if (newSize > mgmtInfo->reservedSize) {
+        size_t reserve = (size_t) (newSize * mgmtInfo->growthFactor);
+        size_t minExtent = (size_t) SM_MIN_EXTENT_PAGES * mgmtInfo->pageSize;
+        if (reserve < newSize + minExtent) {
+            reserve = newSize + minExtent;
+        }
+        reserve -= reserve % PAGE_SIZE;
+        if (maxReserve > 0 && reserve > maxReserve) {
+            reserve = maxReserve;
+        }
+        if (fallocate(fd, FALLOC_FL_KEEP_SIZE, (off_t) mgmtInfo->reservedSize,
+                      (off_t) (reserve - mgmtInfo->reservedSize)) == 0 || errno == EOPNOTSUPP) {
+            mgmtInfo->reservedSize = reserve;
+        } else {
+            return RC_ALLOCATION_FAILED;
+        }
+    }
+
+    if (ftruncate(fd, (off_t) newSize) != 0) {
         return RC_ALLOCATION_FAILED;
     }
+    return RC_OK;
+}
 
-    for (i = 0; i < PAGE_SIZE; i++) {
-        fprintf(fp, "%c", '\0');
+// Name of segment file number segment of fileName, segment -1 names the file holding the segment size
+static char *getSegmentName(const char *fileName, int segment) {
+    char *name = malloc(strlen(fileName) + 16);
+    if (segment < 0) {
+        sprintf(name, "%s.segments", fileName);
+    } else {
+        sprintf(name, "%s.%d", fileName, segment);
     }
-    fflush(fHandle->mgmtInfo->fd);
-    fHandle->totalNumPages += 1;
-    fHandle->curPagePos = (fHandle->totalNumPages + 1);
+    return name;
+}
+
+// Pages per segment of the page file fileName, 0 if it is not segmented
+static int readSegmentPages(const char *fileName) {
+    char *segmentsName = getSegmentName(fileName, -1);
+    FILE *fp = fopen(segmentsName, "r");
+    free(segmentsName);
+    if (fp == NULL) {
+        return 0;
+    }
+
+    int segmentPages = 0;
+    if (fscanf(fp, "%d", &segmentPages) != 1 || segmentPages < 0) {
+        segmentPages = 0;
+    }
+    fclose(fp);
+    return segmentPages;
+}
+
+// Open the segments after the first one, count the pages of all of them
+static RC openSegments(SM_FileHandle *fHandle, int flags) {
+    SM_MgmtInfo *mgmtInfo = fHandle->mgmtInfo;
+    struct stat st;
+
+    mgmtInfo->segmentFds = malloc(SM_MAX_SEGMENTS * sizeof(int));
+    mgmtInfo->segmentFds[0] = mgmtInfo->fd;
+    while (mgmtInfo->numSegments < SM_MAX_SEGMENTS) {
+        char *segmentName = getSegmentName(fHandle->fileName, mgmtInfo->numSegments);
+        int fd = open(segmentName, flags);
+        free(segmentName);
+        if (fd < 0) {
+            break;
+        }
+        mgmtInfo->segmentFds[mgmtInfo->numSegments++] = fd;
+    }
+
+    if (fstat(mgmtInfo->segmentFds[mgmtInfo->numSegments - 1], &st) != 0) {
+        return RC_OPEN_FAILED;
+    }
+    size_t start = getSegmentStart(mgmtInfo, mgmtInfo->numSegments - 1);
+    if ((size_t) st.st_size < start) {
+        return RC_OPEN_FAILED;
+    }
+    fHandle->totalNumPages = (mgmtInfo->numSegments - 1) * mgmtInfo->segmentPages
+                             + (int) (((size_t) st.st_size - start) / mgmtInfo->pageSize);
+    mgmtInfo->reservedSize = (size_t) st.st_size;
     return RC_OK;
+}
+
+static void closeSegments(SM_MgmtInfo *mgmtInfo) {
+    int segment;
 
+    if (mgmtInfo->segmentFds == NULL) {
+        return;
+    }
+    for (segment = 1; segment < mgmtInfo->numSegments; ++segment) {
+        close(mgmtInfo->segmentFds[segment]);
+    }
+    free(mgmtInfo->segmentFds);
+    mgmtInfo->segmentFds = NULL;
 }
 
-// If there are less than numberOfPages, increase the number of pages to numberOfPages by appending empty pages.
-// If there are more (or equal) pages than numberOfPages, we are good.!!, do nothing.
-RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle) {
+static RC writeFileHeader(int fd, int pageSize, int flags) {
+    char header[SM_FILE_HEADER_SIZE];
 
-    if (fHandle->totalNumPages < numberOfPages) {
-        int numPages = numberOfPages - fHandle->totalNumPages;
-        size_t i;
-        RC rc;
-        for (i = 0; i < numPages; i++) {
-            rc = appendEmptyBlock(fHandle);
+    memset(header, 0, SM_FILE_HEADER_SIZE);
+    memcpy(header, FILE_MAGIC, FILE_MAGIC_LEN);
+    memcpy(header + FILE_MAGIC_LEN, &pageSize, sizeof(int));
+    memcpy(header + FILE_MAGIC_LEN + sizeof(int), &flags, sizeof(int));
+    return writeFully(fd, header, SM_FILE_HEADER_SIZE, 0) == RC_OK ? RC_OK : RC_CREATE_FAILED;
+}
+
+// Page size recorded in the header of the file fd and its flags, 0 if the file has no header
+static int readFileHeader(int fd, int *flags) {
+    char header[FILE_MAGIC_LEN + 2 * sizeof(int)];
+    int pageSize;
+
+    if (readFully(fd, header, sizeof(header), 0) != RC_OK || memcmp(header, FILE_MAGIC, FILE_MAGIC_LEN) != 0) {
+        return 0;
+    }
+    memcpy(&pageSize, header + FILE_MAGIC_LEN, sizeof(int));
+    memcpy(flags, header + FILE_MAGIC_LEN + sizeof(int), sizeof(int));
+    return pageSize;
+}
+
+// Offset of the first page in segment file number segment, the header comes before it in the first segment
+static size_t getSegmentStart(SM_MgmtInfo *mgmtInfo, int segment) {
+    return segment == 0 ? mgmtInfo->headerSize : 0;
+}
+
+// Slot of page pageNum in the file, after the bitmap pages that come before it
+static int getFileSlot(SM_MgmtInfo *mgmtInfo, int pageNum) {
+    if (mgmtInfo->headerSize == 0 || pageNum < HEADER_MAP_PAGES) {
+        return pageNum;
+    }
+    return pageNum + (pageNum - HEADER_MAP_PAGES) / (mgmtInfo->pageSize * 8) + 1;
+}
+
+// Slots of a file of numPages pages and its bitmap pages
+static int getNumSlots(SM_MgmtInfo *mgmtInfo, int numPages) {
+    return numPages + getNumMapPages(mgmtInfo, numPages);
+}
+
+// Pages of a file of numSlots slots, a bitmap page in the last slot has no page after it yet
+static int getNumPagesInSlots(SM_MgmtInfo *mgmtInfo, int numSlots) {
+    if (mgmtInfo->headerSize == 0 || numSlots <= HEADER_MAP_PAGES) {
+        return numSlots;
+    }
+    return numSlots - ((numSlots - HEADER_MAP_PAGES - 1) / (mgmtInfo->pageSize * 8 + 1) + 1);
+}
+
+// Bitmap pages of a file of numPages pages, the header holds the bits of the first HEADER_MAP_PAGES
+static int getNumMapPages(SM_MgmtInfo *mgmtInfo, int numPages) {
+    if (mgmtInfo->headerSize == 0 || numPages <= HEADER_MAP_PAGES) {
+        return 0;
+    }
+    return (numPages - HEADER_MAP_PAGES - 1) / (mgmtInfo->pageSize * 8) + 1;
+}
+
+// Slot of bitmap page number mapPage, counting from 0
+static int getMapPageSlot(SM_MgmtInfo *mgmtInfo, int mapPage) {
+    return HEADER_MAP_PAGES + mapPage * (mgmtInfo->pageSize * 8 + 1);
+}
+
+// Pages from pageNum on in consecutive slots, up to the next bitmap page
+static int getContiguousPages(SM_MgmtInfo *mgmtInfo, int pageNum) {
+    if (mgmtInfo->headerSize == 0) {
+        return INT_MAX;
+    }
+    if (pageNum < HEADER_MAP_PAGES) {
+        return HEADER_MAP_PAGES - pageNum;
+    }
+    return mgmtInfo->pageSize * 8 - (pageNum - HEADER_MAP_PAGES) % (mgmtInfo->pageSize * 8);
+}
+
+static char *getMappedPage(SM_MgmtInfo *mgmtInfo, int slot) {
+    return mgmtInfo->map + mgmtInfo->headerSize + (size_t) slot * mgmtInfo->pageSize;
+}
+
+/*
+ * Reserve MAP_RESERVE_SIZE bytes of address space for the file, or twice fileSize if that is more, and map
+ * the file at its start. The mapping never moves: mapPage pointers and copies other threads are doing
+ * without ioLock stay valid while the file grows.
+ */
+static RC mapFile(SM_MgmtInfo *mgmtInfo, size_t fileSize) {
+    size_t reserveSize = MAP_RESERVE_SIZE;
+    if (reserveSize < fileSize * 2) {
+        reserveSize = (fileSize * 2 + MIN_MAP_SIZE - 1) / MIN_MAP_SIZE * MIN_MAP_SIZE;
+    }
+
+    void *map = mmap(NULL, reserveSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED) {
+        return RC_ALLOCATION_FAILED;
+    }
+    mgmtInfo->map = map;
+    mgmtInfo->mapReserved = reserveSize;
+    mgmtInfo->mapSize = 0;
+    return extendMapping(mgmtInfo, fileSize);
+}
+
+/*
+ * Map the file over more of its reservation, with room to grow to twice fileSize. Only the part not
+ * mapped yet is replaced (MAP_FIXED), the pages already mapped are not touched.
+ * Fails if the file would outgrow the reservation.
+ */
+static RC extendMapping(SM_MgmtInfo *mgmtInfo, size_t fileSize) {
+    size_t mapSize = (fileSize * 2 + MIN_MAP_SIZE - 1) / MIN_MAP_SIZE * MIN_MAP_SIZE;
+    if (mapSize > mgmtInfo->mapReserved) {
+        mapSize = mgmtInfo->mapReserved;
+    }
+    if (fileSize > mapSize) {
+        return RC_ALLOCATION_FAILED;
+    }
+    if (mapSize <= mgmtInfo->mapSize) {
+        return RC_OK;
+    }
+
+    void *map = mmap(mgmtInfo->map + mgmtInfo->mapSize, mapSize - mgmtInfo->mapSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_FIXED, mgmtInfo->fd, (off_t) mgmtInfo->mapSize);
+    if (map == MAP_FAILED) {
+        return RC_ALLOCATION_FAILED;
+    }
+    mgmtInfo->mapSize = mapSize;
+    return RC_OK;
+}
+
+// O_DIRECT transfers need a buffer aligned to the block size, PAGE_SIZE covers every block size we meet
+static bool needsAlignedCopy(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    return fHandle->mgmtInfo->ioMode == SM_IO_DIRECT && ((unsigned long) memPage % PAGE_SIZE) != 0;
+}
+
+/*
+ * Move a run of pages with as few preadv/pwritev calls as possible, IOV_MAX pages per call.
+ * A run that crosses the end of a segment or a bitmap page is split there.
+ * A mapped or compressed file is moved page by page, as is an O_DIRECT file when a buffer is not aligned.
+ */
+static RC transferPagesVectored(int startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages,
+                                bool isWrite) {
+    int i;
+
+    bool pageByPage = fHandle->mgmtInfo->map != NULL || fHandle->mgmtInfo->compression != NULL;
+    for (i = 0; i < numPages && !pageByPage; ++i) {
+        pageByPage = needsAlignedCopy(fHandle, memPages[i]);
+    }
+    if (pageByPage) {
+        for (i = 0; i < numPages; ++i) {
+            RC rc = isWrite ? posixWritePage(fHandle, startPage + i, memPages[i])
+                            : posixReadPage(fHandle, startPage + i, memPages[i]);
             if (rc != RC_OK) {
-                return RC_ALLOCATION_FAILED;
+                return rc;
             }
         }
+        return RC_OK;
+    }
+
+    struct iovec iov[IOV_MAX];
+    int done = 0;
+    int segmentPages = fHandle->mgmtInfo->segmentPages;
+    while (done < numPages) {
+        int iovCount = numPages - done < IOV_MAX ? numPages - done : IOV_MAX;
+        int slot = getFileSlot(fHandle->mgmtInfo, startPage + done);
+        if (segmentPages > 0 && iovCount > segmentPages - slot % segmentPages) {
+            iovCount = segmentPages - slot % segmentPages;
+        }
+        if (iovCount > getContiguousPages(fHandle->mgmtInfo, startPage + done)) {
+            iovCount = getContiguousPages(fHandle->mgmtInfo, startPage + done);
+        }
+        for (i = 0; i < iovCount; ++i) {
+            iov[i].iov_base = memPages[done + i];
+            iov[i].iov_len = (size_t) fHandle->mgmtInfo->pageSize;
+        }
+        long long offset;
+        int fd = locateSlot(fHandle->mgmtInfo, slot, &offset);
+        RC rc = transferVector(fd, iov, iovCount, (off_t) offset, isWrite);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        done += iovCount;
     }
     return RC_OK;
 }
 
-int getNumPages(SM_FileHandle *fHandle) {
-    return fHandle->totalNumPages;
+// preadv/pwritev until all of iov is moved, skipping over what a short call already did
+static RC transferVector(int fd, struct iovec *iov, int iovCount, off_t offset, bool isWrite) {
+    while (iovCount > 0) {
+        ssize_t numMoved = isWrite ? pwritev(fd, iov, iovCount, offset) : preadv(fd, iov, iovCount, offset);
+        if (numMoved < 0 && errno == EINTR) {
+            continue;
+        }
+        if (numMoved <= 0) {
+            return isWrite ? RC_WRITE_FAILED : RC_READ_FAILED;
+        }
+        offset += numMoved;
+        while (iovCount > 0 && (size_t) numMoved >= iov->iov_len) {
+            numMoved -= iov->iov_len;
+            iov++;
+            iovCount--;
+        }
+        if (iovCount > 0) {
+            iov->iov_base = (char *) iov->iov_base + numMoved;
+            iov->iov_len -= numMoved;
+        }
+    }
+    return RC_OK;
+}
+
+
+// pread until size bytes are read, a read may return less than asked for
+RC readFully(int fd, char *memPage, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t numRead = pread(fd, memPage, size, offset);
+        if (numRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (numRead <= 0) {
+            return RC_READ_FAILED;
+        }
+        memPage += numRead;
+        offset += numRead;
+        size -= (size_t) numRead;
+    }
+    return RC_OK;
+}
+
+// pwrite until size bytes are written
+RC writeFully(int fd, char *memPage, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t numWritten = pwrite(fd, memPage, size, offset);
+        if (numWritten < 0 && errno == EINTR) {
+            continue;
+        }
+        if (numWritten <= 0) {
+            return RC_WRITE_FAILED;
+        }
+        memPage += numWritten;
+        offset += numWritten;
+        size -= (size_t) numWritten;
+    }
+    return RC_OK;
 }
@@ -2,14 +2,92 @@
 #define STORAGE_MGR_H
 
 #include "dberror.h"
+#include "dt.h"
+#include <stddef.h>
 
 /************************************************************
  *                    handle data structures                *
  ************************************************************/
+// How the pages of an open page file are accessed
+typedef enum SM_IOMode {
+    SM_IO_PREAD = 0,    // pread/pwrite on the file descriptor
+    SM_IO_MMAP = 1,     // the file is mapped, pages are copied from/to the mapping or read in place
+    SM_IO_DIRECT = 2    // pread/pwrite with O_DIRECT, bypassing the kernel page cache.
+                        // Buffers not aligned to PAGE_SIZE go through an aligned copy.
+} SM_IOMode;
+
+// Page files start with a header of SM_FILE_HEADER_SIZE bytes recording their page size, a power of two
+// from SM_MIN_PAGE_SIZE to SM_MAX_PAGE_SIZE. A file without the header holds pages of PAGE_SIZE from offset 0.
+#define SM_FILE_HEADER_SIZE 4096
+#define SM_MIN_PAGE_SIZE 4096
+#define SM_MAX_PAGE_SIZE 65536
+
+// Growth of page files, see setFileGrowthFactor
+#define SM_DEFAULT_GROWTH_FACTOR 1.5
+#define SM_MIN_EXTENT_PAGES 16
+
+// A segmented page file is split in to files of segmentPages pages each: fileName, fileName.1, fileName.2, ...
+// The segment size is kept in fileName.segments
+#define SM_MAX_SEGMENTS 4096
+
+// Pages given back with freePage are recorded in a bitmap kept in the page file, a bit is set while the page is free.
+// It starts in the header, bitmap pages are added among the pages as the file grows past what the header holds.
+// A file without header cannot free pages.
+
+// Asynchronous I/O state of a handle, see async_io.h
+typedef struct SM_AsyncIO SM_AsyncIO;
+// Page map and free chunks of a compressed page file, see compressed_file.h
+typedef struct SM_Compression SM_Compression;
+// Where the pages of a page file are kept, see below
+typedef struct SM_Backend SM_Backend;
+
 // This struct is used to store addition book-keeping info.
-// For now this only has file handle. could be updated in future.
+// backend     : the backend the file was opened with, every call on the handle goes through it
+// backendData : state the backend keeps for the open file, NULL for SM_POSIX_BACKEND
+// The fields from fd to segmentFds and compression are only used by SM_POSIX_BACKEND.
+// fd      : raw file descriptor of the page file, pages are read and written at absolute offsets.
+// ioMode  : how pages are accessed
+// map     : start of the address space reserved for the file in SM_IO_MMAP mode, NULL otherwise. It never moves.
+// mapSize : number of bytes of it the file is mapped over, more than the file size so the file can grow in to the mapping
+// mapReserved : number of bytes reserved at map, the file cannot grow past them
+// asyncIO : set up by initAsyncIO, NULL otherwise
+// growthFactor : once the file outgrows reservedSize, growthFactor times its size is reserved
+// reservedSize : bytes of disk space reserved for the file (its last segment), at least the file size
+// segmentPages : pages per segment file of a segmented page file, 0 if the file is not segmented
+// numSegments  : number of segment files, segment 0 is the file itself
+// segmentFds   : file descriptors of the segments, SM_MAX_SEGMENTS entries, NULL if not segmented
+// pageSize     : bytes per page of this file
+// headerSize   : bytes before page 0 in the file (segment 0), SM_FILE_HEADER_SIZE or 0 for a file without header
+// freeMap      : bitmap of the free pages, it may be NULL while no page is free
+// freeMapBytes : bytes allocated for freeMap, pages past it are in use
+// headerFd     : file descriptor the bitmap bytes in the header go through, fd unless it has O_DIRECT (SM_POSIX_BACKEND)
+// numFreePages : number of bits set in freeMap
+// freeHint     : no page before it is free, allocatePage searches from there
+// punchHoles   : the disk space of freed pages is given back to the file system
+// compression  : set for a compressed page file, NULL otherwise
 typedef struct SM_MgmtInfo{
-    FILE* fd;
+    const SM_Backend *backend;
+    void *backendData;
+    int fd;
+    SM_IOMode ioMode;
+    char *map;
+    size_t mapSize;
+    size_t mapReserved;
+    SM_AsyncIO *asyncIO;
+    double growthFactor;
+    size_t reservedSize;
+    int segmentPages;
+    int numSegments;
+    int *segmentFds;
+    int pageSize;
+    size_t headerSize;
+    unsigned char *freeMap;
+    int freeMapBytes;
+    int headerFd;
+    int numFreePages;
+    int freeHint;
+    bool punchHoles;
+    SM_Compression *compression;
 
 } SM_MgmtInfo;
 
@@ -22,13 +100,68 @@ typedef struct SM_FileHandle {
 
 typedef char* SM_PageHandle;
 
+/*
+ * A storage backend keeps the pages of page files. The functions below check their arguments, keep curPagePos,
+ * the page count and the free page bitmap, and call the backend of the handle for the rest.
+ *
+ * name         : Name of the backend
+ * create       : Create fileName holding one empty page of pageSize bytes, replacing a file of the name.
+ *                segmentPages is 0 for a file that is not segmented, compressed is set for createCompressedPageFile.
+ * destroy      : Delete fileName, RC_FILE_NOT_FOUND if there is none
+ * open         : Fill in fHandle->totalNumPages and the fields of fHandle->mgmtInfo the backend uses.
+ *                mgmtInfo is allocated with the other fields set to their defaults. Nothing is left open on failure.
+ * close        : Release what open set up, mgmtInfo is freed by closePageFile
+ * readPage     : Read a page in range in to memPage
+ * writePage    : Write memPage to a page in range
+ * readPages    : Read numPages pages in range from startPage, memPages[i] gets page startPage + i
+ * writePages   : Write them
+ * mapPage      : Point *memPage at the page where the backend keeps it, RC_FILE_NOT_MAPPED if it cannot
+ * grow         : Make room for numPages pages, more than the file has. totalNumPages is set by the caller.
+ * discardPage  : The page was freed, its space may be given back (see setHolePunching)
+ * locatePage   : As getPageLocation
+ * loadFreeMap  : Set mgmtInfo->freeMap and freeMapBytes to the free page bitmap of the file, if it has one
+ * storeFreeMap : Byte number byte of mgmtInfo->freeMap changed, keep it with the file
+ */
+struct SM_Backend {
+    const char *name;
+    RC (*create)(char *fileName, int pageSize, int segmentPages, bool compressed);
+    RC (*destroy)(char *fileName);
+    RC (*open)(char *fileName, SM_FileHandle *fHandle, SM_IOMode ioMode);
+    RC (*close)(SM_FileHandle *fHandle);
+    RC (*readPage)(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage);
+    RC (*writePage)(SM_FileHandle *fHandle, int pageNum, SM_PageHandle memPage);
+    RC (*readPages)(SM_FileHandle *fHandle, int startPage, int numPages, SM_PageHandle *memPages);
+    RC (*writePages)(SM_FileHandle *fHandle, int startPage, int numPages, SM_PageHandle *memPages);
+    RC (*mapPage)(SM_FileHandle *fHandle, int pageNum, SM_PageHandle *memPage);
+    RC (*grow)(SM_FileHandle *fHandle, int numPages);
+    RC (*discardPage)(SM_FileHandle *fHandle, int pageNum);
+    int (*locatePage)(SM_FileHandle *fHandle, int pageNum, long long *offset);
+    RC (*loadFreeMap)(SM_FileHandle *fHandle);
+    RC (*storeFreeMap)(SM_FileHandle *fHandle, int byte);
+};
+
+// Page files on disk, accessed as given by SM_IOMode. The default backend.
+extern const SM_Backend SM_POSIX_BACKEND;
+// Page files in memory, kept by name until destroyPageFile or the end of the process.
+// Pages can always be read in place with readMappedBlock, the pointers stay valid until the file is destroyed.
+// Segments and compression are ignored, the I/O mode makes no difference.
+extern const SM_Backend SM_RAM_BACKEND;
+
 /************************************************************
  *                    interface                             *
  ************************************************************/
 /* manipulating page files */
 extern void initStorageManager (void);
+// Backend of the page files created, opened and destroyed from now on. Open handles keep their backend.
+extern void setStorageBackend (const SM_Backend *backend);
+extern const SM_Backend *getStorageBackend (void);
 extern RC createPageFile (char *fileName);
+extern RC createPageFileWithPageSize (char *fileName, int pageSize);
+extern RC createSegmentedPageFile (char *fileName, int pageSize, int segmentPages);
+// A page file whose pages are compressed on disk, it can only be opened with SM_IO_PREAD
+extern RC createCompressedPageFile (char *fileName, int pageSize);
 extern RC openPageFile (char *fileName, SM_FileHandle *fHandle);
+extern RC openPageFileMode (char *fileName, SM_FileHandle *fHandle, SM_IOMode ioMode);
 extern RC closePageFile (SM_FileHandle *fHandle);
 extern RC destroyPageFile (char *fileName);
 
@@ -41,12 +174,40 @@ extern RC readCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readNextBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readLastBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 
+/* positional I/O: no effect on curPagePos, safe to call from several threads on one handle */
+extern RC preadBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC pwriteBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+
+/* vectored I/O of the numPages contiguous pages from startPage, memPages[i] holds page startPage + i.
+   On disk a run is moved with one preadv/pwritev. Like the positional calls they do not move curPagePos. */
+extern RC readBlocks (int startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages);
+extern RC writeBlocks (int startPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages);
+
+/* zero-copy read in SM_IO_MMAP mode: *memPage points in to the mapping.
+   The pointer stays valid until the file is closed, growing the file does not move the mapping. See SM_RAM_BACKEND for files in memory. */
+extern RC readMappedBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle *memPage);
+
 /* writing blocks to a page file */
 extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
 extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
+extern RC setFileGrowthFactor (SM_FileHandle *fHandle, double growthFactor);
+
+/* reusing pages: allocatePage hands out the lowest free page, or appends one if none is free.
+   The content of a reused page is undefined, it reads as zeros if hole punching was on when it was freed. */
+extern RC allocatePage (SM_FileHandle *fHandle, int *pageNum);
+extern RC freePage (SM_FileHandle *fHandle, int pageNum);
+extern bool isPageFree (SM_FileHandle *fHandle, int pageNum);
+extern int getNumFreePages (SM_FileHandle *fHandle);
+// Punch a hole (FALLOC_FL_PUNCH_HOLE) for every page freed from now on
+extern RC setHolePunching (SM_FileHandle *fHandle, bool punchHoles);
 
 // Get total number of pages in File
 extern int getNumPages (SM_FileHandle *fHandle);
+// Bytes per page of the file, every memPage passed for it must be this large
+extern int getPageSize (SM_FileHandle *fHandle);
+// File descriptor of the (segment) file holding page pageNum, *offset is set to the page's offset in it.
+// -1 for a compressed page file, its pages have no fixed place, and for a file that is not on disk.
+extern int getPageLocation (SM_FileHandle *fHandle, int pageNum, long long *offset);
 #endif
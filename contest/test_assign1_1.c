@@ -1,22 +1,35 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
 #include "storage_mgr.h"
+#include "async_io.h"
 #include "dberror.h"
 
 /* test output files */
 #define TESTPF "test_pagefile.bin"
 
-typedef short bool;
-#define TRUE 1
-#define FALSE 0
-
 /* prototypes for test functions */
 static void checkErrorCode (RC rc, char *message);
 static RC testCreateOpenClose(void);
 static RC testSinglePageContent(void);
+static RC testPositionalReadWrite(void);
+static RC testMappedReadWrite(void);
+static RC testDirectReadWrite(void);
+static RC testVectoredReadWrite(void);
+static RC testFileGrowth(void);
+static RC testSegmentedFile(void);
+static RC testPageSizes(void);
+static RC testFreePages(void);
+static RC testCompressedFile(void);
+static RC testRamBackend(void);
+static RC testAsyncReadWrite(SM_AsyncBackend backend);
+static int findRingFd(void);
 static void myExit (int exitCode);
 
 #define CHECK_RETURN_RC(rc) \
@@ -30,6 +43,18 @@ main (void)
 
   checkErrorCode(testCreateOpenClose(), "creating, opening, and closing");
   checkErrorCode(testSinglePageContent(), "reading and writing single page content");
+  checkErrorCode(testPositionalReadWrite(), "positional reading and writing");
+  checkErrorCode(testMappedReadWrite(), "reading and writing a mapped page file");
+  checkErrorCode(testDirectReadWrite(), "reading and writing with direct I/O");
+  checkErrorCode(testVectoredReadWrite(), "reading and writing runs of pages");
+  checkErrorCode(testFileGrowth(), "growing a page file");
+  checkErrorCode(testSegmentedFile(), "reading and writing a segmented page file");
+  checkErrorCode(testPageSizes(), "page files with other page sizes");
+  checkErrorCode(testFreePages(), "freeing and reusing pages");
+  checkErrorCode(testCompressedFile(), "reading and writing a compressed page file");
+  checkErrorCode(testRamBackend(), "page files kept in memory");
+  checkErrorCode(testAsyncReadWrite(SM_ASYNC_IO_URING), "asynchronous reading and writing");
+  checkErrorCode(testAsyncReadWrite(SM_ASYNC_THREAD_POOL), "asynchronous reading and writing with threads");
 
   myExit(0);
   return 0;
@@ -127,3 +152,682 @@ testSinglePageContent(void)
   free(ph);
   return RC_OK;
 }
+
+/* Write and read pages at absolute positions, the current page position must not move */
+RC
+testPositionalReadWrite(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  int i;
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  CHECK_RETURN_RC(createPageFile (TESTPF));
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  CHECK_RETURN_RC(ensureCapacity (3, &fh));
+  FAIL((fh.totalNumPages == 3), "expected 3 pages after ensuring capacity");
+
+  CHECK_RETURN_RC(readFirstBlock (&fh, ph));
+  int pos = getBlockPos(&fh);
+
+  for (i=0; i < PAGE_SIZE; i++)
+    ph[i] = (i % 7) + 'a';
+  CHECK_RETURN_RC(pwriteBlock (2, &fh, ph));
+  memset(ph, 0, PAGE_SIZE);
+  CHECK_RETURN_RC(preadBlock (2, &fh, ph));
+  for (i=0; i < PAGE_SIZE; i++)
+    FAIL((ph[i] == (i % 7) + 'a'), "character in page read from disk not the one we expected.");
+  FAIL((getBlockPos(&fh) == pos), "positional I/O should not move the current page position");
+
+  // pages beyond the end of the file cannot be read or written
+  FAIL((preadBlock (3, &fh, ph) != RC_OK), "reading a non existing page should return an error.");
+  FAIL((pwriteBlock (3, &fh, ph) != RC_OK), "writing a non existing page should return an error.");
+
+  // the relative API sees the page written at an absolute position
+  CHECK_RETURN_RC(readLastBlock (&fh, ph));
+  FAIL((ph[1] == 'b'), "expected the last page to hold the positionally written data");
+
+  CHECK_RETURN_RC(closePageFile (&fh));
+  CHECK_RETURN_RC(destroyPageFile (TESTPF));
+
+  free(ph);
+  return RC_OK;
+}
+
+/* Access a page file through its mapping, pages read in place must see later writes and stay put while the file grows */
+RC
+testMappedReadWrite(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  SM_PageHandle mapped;
+  SM_PageHandle moved;
+  int i;
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  CHECK_RETURN_RC(createPageFile (TESTPF));
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  FAIL((readMappedBlock (0, &fh, &mapped) == RC_FILE_NOT_MAPPED), "a file opened with pread is not mapped");
+  CHECK_RETURN_RC(closePageFile (&fh));
+
+  CHECK_RETURN_RC(openPageFileMode (TESTPF, &fh, SM_IO_MMAP));
+  CHECK_RETURN_RC(ensureCapacity (3, &fh));
+
+  for (i=0; i < PAGE_SIZE; i++)
+    ph[i] = (i % 5) + 'A';
+  CHECK_RETURN_RC(writeBlock (2, &fh, ph));
+  CHECK_RETURN_RC(readMappedBlock (2, &fh, &mapped));
+  for (i=0; i < PAGE_SIZE; i++)
+    FAIL((mapped[i] == (i % 5) + 'A'), "character in mapped page not the one we expected.");
+
+  ph[0] = 'z';
+  CHECK_RETURN_RC(writeBlock (2, &fh, ph));
+  FAIL((mapped[0] == 'z'), "a page read in place should see a later write");
+  FAIL((readMappedBlock (3, &fh, &mapped) != RC_OK), "reading a non existing page should return an error.");
+
+  // growing the file past its first mapping does not move the pages read in place
+  CHECK_RETURN_RC(readMappedBlock (2, &fh, &mapped));
+  CHECK_RETURN_RC(ensureCapacity (20000, &fh));
+  FAIL((mapped[0] == 'z'), "a page read in place should stay valid while the file grows");
+  CHECK_RETURN_RC(readMappedBlock (2, &fh, &moved));
+  FAIL((moved == mapped), "expected the mapping not to move");
+  CHECK_RETURN_RC(readMappedBlock (19999, &fh, &moved));
+  FAIL((moved[0] == 0), "expected a new page to be empty");
+  CHECK_RETURN_RC(closePageFile (&fh));
+
+  // the data written through the mapping is in the file
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  FAIL((fh.totalNumPages == 20000), "expected 20000 pages in the mapped file");
+  memset(ph, 0, PAGE_SIZE);
+  CHECK_RETURN_RC(readBlock (2, &fh, ph));
+  FAIL((ph[0] == 'z' && ph[1] == 'B'), "expected the page written through the mapping");
+  CHECK_RETURN_RC(closePageFile (&fh));
+  CHECK_RETURN_RC(destroyPageFile (TESTPF));
+
+  free(ph);
+  return RC_OK;
+}
+
+/* Direct I/O works with buffers that are not aligned */
+RC
+testDirectReadWrite(void)
+{
+  SM_FileHandle fh;
+  char *buffer;
+  SM_PageHandle ph;
+  int i;
+
+  // one byte off from an aligned address
+  buffer = malloc(PAGE_SIZE * 2 + 1);
+  ph = buffer + 1;
+
+  CHECK_RETURN_RC(createPageFile (TESTPF));
+  CHECK_RETURN_RC(openPageFileMode (TESTPF, &fh, SM_IO_DIRECT));
+  CHECK_RETURN_RC(appendEmptyBlock (&fh));
+
+  for (i=0; i < PAGE_SIZE; i++)
+    ph[i] = (i % 3) + 'x';
+  CHECK_RETURN_RC(writeBlock (1, &fh, ph));
+  memset(ph, 0, PAGE_SIZE);
+  CHECK_RETURN_RC(readBlock (1, &fh, ph));
+  for (i=0; i < PAGE_SIZE; i++)
+    FAIL((ph[i] == (i % 3) + 'x'), "character in page read with direct I/O not the one we expected.");
+  CHECK_RETURN_RC(readFirstBlock (&fh, ph));
+  FAIL((ph[0] == 0), "expected the first page to be empty");
+
+  CHECK_RETURN_RC(closePageFile (&fh));
+  CHECK_RETURN_RC(destroyPageFile (TESTPF));
+
+  free(buffer);
+  return RC_OK;
+}
+
+/* Write a run of pages with one call and read it back with another */
+#define RUN_TEST_PAGES 5
+
+RC
+testVectoredReadWrite(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[RUN_TEST_PAGES];
+  int i, j;
+
+  for (i=0; i < RUN_TEST_PAGES; i++)
+    pages[i] = malloc(PAGE_SIZE);
+
+  CHECK_RETURN_RC(createPageFile (TESTPF));
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  CHECK_RETURN_RC(ensureCapacity (RUN_TEST_PAGES + 1, &fh));
+
+  for (i=0; i < RUN_TEST_PAGES; i++)
+    memset(pages[i], '0' + i, PAGE_SIZE);
+  CHECK_RETURN_RC(writeBlocks (1, RUN_TEST_PAGES, &fh, pages));
+
+  for (i=0; i < RUN_TEST_PAGES; i++)
+    memset(pages[i], 0, PAGE_SIZE);
+  CHECK_RETURN_RC(readBlocks (1, RUN_TEST_PAGES, &fh, pages));
+  for (i=0; i < RUN_TEST_PAGES; i++)
+    for (j=0; j < PAGE_SIZE; j++)
+      FAIL((pages[i][j] == '0' + i), "character in page of the run not the one we expected.");
+
+  // single pages see the pages written as a run
+  CHECK_RETURN_RC(readBlock (3, &fh, pages[0]));
+  FAIL((pages[0][0] == '2'), "expected page 3 to hold the third page of the run");
+  CHECK_RETURN_RC(readFirstBlock (&fh, pages[0]));
+  FAIL((pages[0][0] == 0), "expected the page before the run to be untouched");
+
+  FAIL((readBlocks (2, RUN_TEST_PAGES, &fh, pages) != RC_OK), "reading past the end of the file should return an error.");
+  FAIL((writeBlocks (2, RUN_TEST_PAGES, &fh, pages) != RC_OK), "writing past the end of the file should return an error.");
+
+  CHECK_RETURN_RC(closePageFile (&fh));
+  CHECK_RETURN_RC(destroyPageFile (TESTPF));
+
+  for (i=0; i < RUN_TEST_PAGES; i++)
+    free(pages[i]);
+  return RC_OK;
+}
+
+/* Grow a page file, the file holds exactly the pages asked for and they are empty */
+RC
+testFileGrowth(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  struct stat st;
+  int i;
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  CHECK_RETURN_RC(createPageFile (TESTPF));
+  FAIL((stat(TESTPF, &st) == 0 && st.st_size == SM_FILE_HEADER_SIZE + PAGE_SIZE), "expected a new file to hold the header and one page");
+
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  FAIL((setFileGrowthFactor (&fh, 0.5) != RC_OK), "a growth factor below 1 should return an error.");
+  CHECK_RETURN_RC(setFileGrowthFactor (&fh, 2.0));
+  CHECK_RETURN_RC(appendEmptyBlock (&fh));
+  CHECK_RETURN_RC(ensureCapacity (1000, &fh));
+  FAIL((getNumPages(&fh) == 1000), "expected 1000 pages after ensuring capacity");
+  FAIL((stat(TESTPF, &st) == 0 && st.st_size == SM_FILE_HEADER_SIZE + 1000 * PAGE_SIZE), "expected the file to hold exactly 1000 pages");
+
+  CHECK_RETURN_RC(readLastBlock (&fh, ph));
+  for (i=0; i < PAGE_SIZE; i++)
+    FAIL((ph[i] == 0), "expected zero byte in a page added by growing the file");
+  CHECK_RETURN_RC(closePageFile (&fh));
+
+  // the space reserved beyond the end of the file does not count as pages
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  FAIL((fh.totalNumPages == 1000), "expected 1000 pages after reopening");
+  CHECK_RETURN_RC(closePageFile (&fh));
+  CHECK_RETURN_RC(destroyPageFile (TESTPF));
+
+  free(ph);
+  return RC_OK;
+}
+
+/* A page file split in to segments of 4 pages, runs of pages cross the segment ends */
+#define SEGMENT_TEST_PAGES 10
+
+RC
+testSegmentedFile(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[SEGMENT_TEST_PAGES];
+  SM_AsyncRequest request;
+  SM_AsyncRequest *done;
+  struct stat st;
+  int i;
+
+  for (i=0; i < SEGMENT_TEST_PAGES; i++)
+    pages[i] = malloc(PAGE_SIZE);
+
+  CHECK_RETURN_RC(createSegmentedPageFile (TESTPF, PAGE_SIZE, 4));
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  FAIL((fh.totalNumPages == 1), "expected 1 page in new file");
+  CHECK_RETURN_RC(ensureCapacity (SEGMENT_TEST_PAGES, &fh));
+  FAIL((stat(TESTPF, &st) == 0 && st.st_size == SM_FILE_HEADER_SIZE + 4 * PAGE_SIZE), "expected a full first segment");
+  FAIL((stat(TESTPF ".2", &st) == 0 && st.st_size == 2 * PAGE_SIZE), "expected 2 pages in the last segment");
+
+  for (i=0; i < SEGMENT_TEST_PAGES; i++)
+    memset(pages[i], 'a' + i, PAGE_SIZE);
+  CHECK_RETURN_RC(writeBlocks (0, SEGMENT_TEST_PAGES, &fh, pages));
+  CHECK_RETURN_RC(writeBlock (5, &fh, pages[0]));
+  CHECK_RETURN_RC(closePageFile (&fh));
+
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  FAIL((fh.totalNumPages == SEGMENT_TEST_PAGES), "expected all pages of the segments after reopening");
+  for (i=0; i < SEGMENT_TEST_PAGES; i++)
+    {
+      CHECK_RETURN_RC(readBlock (i, &fh, pages[i]));
+      FAIL((pages[i][0] == (i == 5 ? 'a' : 'a' + i)), "character in segmented page not the one we expected.");
+    }
+
+  CHECK_RETURN_RC(initAsyncIO (&fh, 1, SM_ASYNC_IO_URING));
+  request.pageNum = 9;
+  request.memPage = pages[0];
+  request.isWrite = FALSE;
+  CHECK_RETURN_RC(submitAsyncIO (&fh, &request, 1));
+  FAIL((reapAsyncIO (&fh, &done, 1, 1) == 1), "expected the read to complete");
+  CHECK_RETURN_RC(done->rc);
+  FAIL((pages[0][0] == 'j'), "expected the last page of the last segment");
+
+  CHECK_RETURN_RC(closePageFile (&fh));
+  CHECK_RETURN_RC(destroyPageFile (TESTPF));
+  FAIL((stat(TESTPF ".1", &st) != 0), "expected the segments to be removed");
+
+  for (i=0; i < SEGMENT_TEST_PAGES; i++)
+    free(pages[i]);
+  return RC_OK;
+}
+
+/* Page files of the largest page size, and a file without header read with the default page size */
+#define LARGE_PAGE_SIZE SM_MAX_PAGE_SIZE
+
+RC
+testPageSizes(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[3];
+  SM_IOMode modes[] = { SM_IO_PREAD, SM_IO_MMAP };
+  struct stat st;
+  FILE *fp;
+  int i, j, m;
+
+  for (i=0; i < 3; i++)
+    pages[i] = malloc(LARGE_PAGE_SIZE);
+
+  FAIL((createPageFileWithPageSize (TESTPF, 2048) == RC_INVALID_PAGE_SIZE), "a page size below the minimum should return an error.");
+  FAIL((createPageFileWithPageSize (TESTPF, 6144) == RC_INVALID_PAGE_SIZE), "a page size not a power of two should return an error.");
+  FAIL((createPageFileWithPageSize (TESTPF, 2 * LARGE_PAGE_SIZE) == RC_INVALID_PAGE_SIZE), "a page size above the maximum should return an error.");
+
+  for (m=0; m < 2; m++)
+    {
+      CHECK_RETURN_RC(createPageFileWithPageSize (TESTPF, LARGE_PAGE_SIZE));
+      CHECK_RETURN_RC(openPageFileMode (TESTPF, &fh, modes[m]));
+      FAIL((getPageSize(&fh) == LARGE_PAGE_SIZE), "expected the page size given at creation");
+      FAIL((fh.totalNumPages == 1), "expected 1 page in new file");
+      CHECK_RETURN_RC(ensureCapacity (3, &fh));
+      FAIL((stat(TESTPF, &st) == 0 && st.st_size == SM_FILE_HEADER_SIZE + 3 * LARGE_PAGE_SIZE), "expected the header and 3 large pages");
+
+      for (i=0; i < 3; i++)
+        memset(pages[i], 'a' + i, LARGE_PAGE_SIZE);
+      CHECK_RETURN_RC(writeBlocks (0, 2, &fh, pages));
+      CHECK_RETURN_RC(writeBlock (2, &fh, pages[2]));
+      CHECK_RETURN_RC(closePageFile (&fh));
+
+      CHECK_RETURN_RC(openPageFileMode (TESTPF, &fh, modes[m]));
+      FAIL((getPageSize(&fh) == LARGE_PAGE_SIZE), "expected the page size from the header after reopening");
+      FAIL((fh.totalNumPages == 3), "expected 3 pages after reopening");
+      for (i=0; i < 3; i++)
+        memset(pages[i], 0, LARGE_PAGE_SIZE);
+      CHECK_RETURN_RC(readBlocks (0, 3, &fh, pages));
+      for (i=0; i < 3; i++)
+        for (j=0; j < LARGE_PAGE_SIZE; j++)
+          FAIL((pages[i][j] == 'a' + i), "character in large page not the one we expected.");
+      CHECK_RETURN_RC(closePageFile (&fh));
+      CHECK_RETURN_RC(destroyPageFile (TESTPF));
+    }
+
+  // a file written without the header holds pages of PAGE_SIZE from its start
+  fp = fopen(TESTPF, "w");
+  memset(pages[0], 'x', 2 * PAGE_SIZE);
+  FAIL((fwrite(pages[0], 1, 2 * PAGE_SIZE, fp) == 2 * PAGE_SIZE), "could not write the file without header");
+  fclose(fp);
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  FAIL((getPageSize(&fh) == PAGE_SIZE), "expected the default page size for a file without header");
+  FAIL((fh.totalNumPages == 2), "expected 2 pages in the file without header");
+  memset(pages[1], 0, PAGE_SIZE);
+  CHECK_RETURN_RC(readFirstBlock (&fh, pages[1]));
+  FAIL((pages[1][0] == 'x'), "expected page 0 at the start of the file without header");
+  CHECK_RETURN_RC(closePageFile (&fh));
+  CHECK_RETURN_RC(destroyPageFile (TESTPF));
+
+  for (i=0; i < 3; i++)
+    free(pages[i]);
+  return RC_OK;
+}
+
+/* Free pages are remembered across opening the file, reused lowest first, and punched when asked to.
+ * The bitmap outgrows the header of a file of FREE_MAP_TEST_PAGES pages, a bitmap page is added among its pages. */
+#define FREE_MAP_TEST_PAGES 40000
+
+RC
+testFreePages(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  SM_PageHandle run[4];
+  struct stat st;
+  int pageNum;
+  int i;
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  for (i=0; i < 4; i++)
+    run[i] = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  CHECK_RETURN_RC(createPageFile (TESTPF));
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  CHECK_RETURN_RC(ensureCapacity (8, &fh));
+  FAIL((getNumFreePages(&fh) == 0), "expected no free page in a new file");
+  CHECK_RETURN_RC(freePage (&fh, 5));
+  CHECK_RETURN_RC(freePage (&fh, 2));
+  FAIL((freePage (&fh, 2) == RC_PAGE_ALREADY_FREE), "freeing a free page should return an error.");
+  FAIL((freePage (&fh, 8) != RC_OK), "freeing a page past the end of the file should return an error.");
+  CHECK_RETURN_RC(closePageFile (&fh));
+
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  FAIL((getNumFreePages(&fh) == 2 && isPageFree(&fh, 2) && isPageFree(&fh, 5) && !isPageFree(&fh, 3)),
+       "expected the free pages after reopening");
+  CHECK_RETURN_RC(allocatePage (&fh, &pageNum));
+  FAIL((pageNum == 2), "expected the lowest free page first");
+  CHECK_RETURN_RC(allocatePage (&fh, &pageNum));
+  FAIL((pageNum == 5), "expected the other free page next");
+  CHECK_RETURN_RC(allocatePage (&fh, &pageNum));
+  FAIL((pageNum == 8 && fh.totalNumPages == 9), "expected a new page once no page is free");
+
+  // a punched page reads as zeros
+  CHECK_RETURN_RC(setHolePunching (&fh, TRUE));
+  memset(ph, 'p', PAGE_SIZE);
+  CHECK_RETURN_RC(writeBlock (3, &fh, ph));
+  CHECK_RETURN_RC(freePage (&fh, 3));
+  CHECK_RETURN_RC(readBlock (3, &fh, ph));
+  for (i=0; i < PAGE_SIZE; i++)
+    FAIL((ph[i] == 0), "expected zero byte in a punched page");
+  FAIL((fh.totalNumPages == 9), "expected punching to leave the file size");
+
+  // pages written around the bitmap page and at the end stay apart from it
+  CHECK_RETURN_RC(ensureCapacity (FREE_MAP_TEST_PAGES, &fh));
+  FAIL((stat(TESTPF, &st) == 0 && st.st_size == SM_FILE_HEADER_SIZE + (FREE_MAP_TEST_PAGES + 1) * (off_t) PAGE_SIZE),
+       "expected the pages and one bitmap page");
+  for (i=0; i < 4; i++)
+    memset(run[i], 'a' + i, PAGE_SIZE);
+  CHECK_RETURN_RC(writeBlocks (32254, 4, &fh, run));
+  memset(ph, 'z', PAGE_SIZE);
+  CHECK_RETURN_RC(writeBlock (FREE_MAP_TEST_PAGES - 1, &fh, ph));
+  CHECK_RETURN_RC(setHolePunching (&fh, FALSE));
+  CHECK_RETURN_RC(freePage (&fh, 33000));
+  CHECK_RETURN_RC(freePage (&fh, 100));
+  CHECK_RETURN_RC(closePageFile (&fh));
+
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  FAIL((fh.totalNumPages == FREE_MAP_TEST_PAGES), "expected the bitmap page not to count as a page");
+  FAIL((getNumFreePages(&fh) == 3 && isPageFree(&fh, 3) && isPageFree(&fh, 100) && isPageFree(&fh, 33000) && !isPageFree(&fh, 32256)),
+       "expected the free pages in the header and the bitmap page after reopening");
+  for (i=0; i < 4; i++)
+    CHECK_RETURN_RC(readBlock (32254 + i, &fh, run[i]));
+  for (i=0; i < 4; i++)
+    FAIL((run[i][0] == 'a' + i && run[i][PAGE_SIZE - 1] == 'a' + i), "page next to the bitmap page not the one we expected.");
+  memset(run[0], 0, PAGE_SIZE);
+  CHECK_RETURN_RC(readBlocks (32255, 2, &fh, run));
+  FAIL((run[0][0] == 'b' && run[1][0] == 'c'), "pages read across the bitmap page not the ones we expected.");
+  CHECK_RETURN_RC(readBlock (FREE_MAP_TEST_PAGES - 1, &fh, ph));
+  FAIL((ph[0] == 'z' && ph[PAGE_SIZE - 1] == 'z'), "last page not the one we expected.");
+  CHECK_RETURN_RC(allocatePage (&fh, &pageNum));
+  CHECK_RETURN_RC(allocatePage (&fh, &pageNum));
+  FAIL((pageNum == 100), "expected the free pages of the header first");
+  CHECK_RETURN_RC(allocatePage (&fh, &pageNum));
+  FAIL((pageNum == 33000 && getNumFreePages(&fh) == 0), "expected the free page of the bitmap page next");
+  CHECK_RETURN_RC(closePageFile (&fh));
+
+  CHECK_RETURN_RC(destroyPageFile (TESTPF));
+
+  for (i=0; i < 4; i++)
+    free(run[i]);
+  free(ph);
+  return RC_OK;
+}
+
+/* Pages of a compressed file read back as written, whether they compress or not, and take less space */
+#define COMPRESS_TEST_PAGES 64
+
+static void
+fillTestPage(SM_PageHandle page, int pageNum, bool compressible)
+{
+  int i;
+
+  memset(page, 0, PAGE_SIZE);
+  for (i=0; i < PAGE_SIZE; i++)
+    page[i] = compressible ? (i % 100 < 20 ? 'a' + (pageNum + i / 100) % 26 : 0) : (char) (rand() & 0xff);
+}
+
+RC
+testCompressedFile(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[COMPRESS_TEST_PAGES];
+  SM_PageHandle expected;
+  SM_AsyncRequest request;
+  SM_AsyncRequest *done;
+  struct stat st;
+  int i;
+
+  expected = malloc(PAGE_SIZE);
+  for (i=0; i < COMPRESS_TEST_PAGES; i++)
+    pages[i] = malloc(PAGE_SIZE);
+  srand(42);
+
+  CHECK_RETURN_RC(createCompressedPageFile (TESTPF, PAGE_SIZE));
+  FAIL((openPageFileMode (TESTPF, &fh, SM_IO_MMAP) == RC_OPEN_FAILED), "mapping a compressed file should return an error.");
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  FAIL((fh.totalNumPages == 1), "expected 1 page in new file");
+  CHECK_RETURN_RC(readFirstBlock (&fh, pages[0]));
+  for (i=0; i < PAGE_SIZE; i++)
+    FAIL((pages[0][i] == 0), "expected zero byte in first page of freshly initialized page");
+
+  // every 8th page is random and does not compress
+  CHECK_RETURN_RC(ensureCapacity (COMPRESS_TEST_PAGES, &fh));
+  for (i=0; i < COMPRESS_TEST_PAGES; i++)
+    fillTestPage(pages[i], i, i % 8 != 7);
+  CHECK_RETURN_RC(writeBlocks (0, COMPRESS_TEST_PAGES, &fh, pages));
+  CHECK_RETURN_RC(closePageFile (&fh));
+  FAIL((stat(TESTPF, &st) == 0 && st.st_size < SM_FILE_HEADER_SIZE + COMPRESS_TEST_PAGES * PAGE_SIZE / 2),
+       "expected the compressed pages to take less than half the space");
+
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  FAIL((fh.totalNumPages == COMPRESS_TEST_PAGES), "expected all pages after reopening");
+  for (i=0; i < COMPRESS_TEST_PAGES; i++)
+    {
+      memcpy(expected, pages[i], PAGE_SIZE);
+      CHECK_RETURN_RC(readBlock (i, &fh, pages[i]));
+      FAIL((memcmp(expected, pages[i], PAGE_SIZE) == 0), "compressed page not the one we expected.");
+    }
+
+  // a page growing moves to other chunks, a page shrinking stays, neither disturbs its neighbours
+  fillTestPage(pages[3], 3, FALSE);
+  CHECK_RETURN_RC(writeBlock (3, &fh, pages[3]));
+  fillTestPage(pages[7], 7, TRUE);
+  CHECK_RETURN_RC(writeBlock (7, &fh, pages[7]));
+  for (i=2; i < 9; i++)
+    {
+      memcpy(expected, pages[i], PAGE_SIZE);
+      CHECK_RETURN_RC(readBlock (i, &fh, pages[i]));
+      FAIL((memcmp(expected, pages[i], PAGE_SIZE) == 0), "rewritten compressed page not the one we expected.");
+    }
+
+  // asynchronous reads go through the worker threads
+  CHECK_RETURN_RC(initAsyncIO (&fh, 1, SM_ASYNC_IO_URING));
+  FAIL((getAsyncBackend(&fh) == SM_ASYNC_THREAD_POOL), "expected the thread pool for a compressed file");
+  request.pageNum = 3;
+  request.memPage = expected;
+  request.isWrite = FALSE;
+  CHECK_RETURN_RC(submitAsyncIO (&fh, &request, 1));
+  FAIL((reapAsyncIO (&fh, &done, 1, 1) == 1), "expected the read to complete");
+  CHECK_RETURN_RC(done->rc);
+  FAIL((memcmp(expected, pages[3], PAGE_SIZE) == 0), "asynchronously read compressed page not the one we expected.");
+
+  CHECK_RETURN_RC(freePage (&fh, 5));
+  CHECK_RETURN_RC(readBlock (5, &fh, pages[5]));
+  for (i=0; i < PAGE_SIZE; i++)
+    FAIL((pages[5][i] == 0), "expected zero byte in a freed compressed page");
+
+  CHECK_RETURN_RC(closePageFile (&fh));
+  CHECK_RETURN_RC(destroyPageFile (TESTPF));
+  FAIL((stat(TESTPF ".pmap", &st) != 0), "expected the page map to be removed");
+
+  for (i=0; i < COMPRESS_TEST_PAGES; i++)
+    free(pages[i]);
+  free(expected);
+  return RC_OK;
+}
+
+/* A file in memory keeps its pages and free pages between opens, touches no disk and is gone once destroyed */
+RC
+testRamBackend(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  SM_PageHandle mapped;
+  struct stat st;
+  int pageNum;
+  int i;
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  setStorageBackend(&SM_RAM_BACKEND);
+
+  CHECK_RETURN_RC(createPageFile (TESTPF));
+  FAIL((stat(TESTPF, &st) != 0), "expected no file on disk");
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  FAIL((fh.totalNumPages == 1), "expected 1 page in new file");
+  CHECK_RETURN_RC(readFirstBlock (&fh, ph));
+  for (i=0; i < PAGE_SIZE; i++)
+    FAIL((ph[i] == 0), "expected zero byte in first page of freshly initialized page");
+
+  // grow past one block of pages, write every page with its own number
+  CHECK_RETURN_RC(ensureCapacity (100, &fh));
+  for (i=0; i < 100; i++)
+    {
+      memset(ph, 'a' + i % 26, PAGE_SIZE);
+      CHECK_RETURN_RC(writeBlock (i, &fh, ph));
+    }
+  CHECK_RETURN_RC(freePage (&fh, 42));
+  CHECK_RETURN_RC(closePageFile (&fh));
+
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  FAIL((fh.totalNumPages == 100), "expected all pages after reopening");
+  FAIL((getNumFreePages(&fh) == 1 && isPageFree(&fh, 42)), "expected the free page after reopening");
+  CHECK_RETURN_RC(readMappedBlock (99, &fh, &mapped));
+  FAIL((mapped[0] == 'a' + 99 % 26), "character in page read in place not the one we expected.");
+  CHECK_RETURN_RC(ensureCapacity (300, &fh));
+  FAIL((mapped[PAGE_SIZE - 1] == 'a' + 99 % 26), "expected the page not to move as the file grows");
+  CHECK_RETURN_RC(readBlock (57, &fh, ph));
+  for (i=0; i < PAGE_SIZE; i++)
+    FAIL((ph[i] == 'a' + 57 % 26), "character in page read from memory not the one we expected.");
+  CHECK_RETURN_RC(allocatePage (&fh, &pageNum));
+  FAIL((pageNum == 42), "expected the free page to be reused");
+  FAIL((getPageLocation(&fh, 0, (long long *) &st.st_size) < 0), "expected no file descriptor for a file in memory");
+  CHECK_RETURN_RC(closePageFile (&fh));
+
+  CHECK_RETURN_RC(destroyPageFile (TESTPF));
+  FAIL((openPageFile (TESTPF, &fh) == RC_FILE_NOT_FOUND), "opening a destroyed file should return an error.");
+  FAIL((destroyPageFile (TESTPF) == RC_FILE_NOT_FOUND), "destroying a destroyed file should return an error.");
+
+  setStorageBackend(&SM_POSIX_BACKEND);
+  free(ph);
+  return RC_OK;
+}
+
+/* The file descriptor of the io_uring instance of this process, -1 if there is none */
+int
+findRingFd(void)
+{
+  DIR *dir = opendir("/proc/self/fd");
+  struct dirent *entry;
+  char path[300];
+  char target[64];
+  int fd = -1;
+
+  if (dir == NULL)
+    return -1;
+  while (fd < 0 && (entry = readdir(dir)) != NULL)
+    {
+      ssize_t len;
+      snprintf(path, sizeof(path), "/proc/self/fd/%s", entry->d_name);
+      len = readlink(path, target, sizeof(target) - 1);
+      if (len > 0)
+        {
+          target[len] = '\0';
+          if (strcmp(target, "anon_inode:[io_uring]") == 0)
+            fd = atoi(entry->d_name);
+        }
+    }
+  closedir(dir);
+  return fd;
+}
+
+/* Write and read back several pages at once with the asynchronous API */
+#define ASYNC_TEST_PAGES 8
+
+RC
+testAsyncReadWrite(SM_AsyncBackend backend)
+{
+  SM_FileHandle fh;
+  SM_AsyncRequest requests[ASYNC_TEST_PAGES + 1];
+  SM_AsyncRequest *done[ASYNC_TEST_PAGES + 1];
+  char *pages;
+  int i, j;
+
+  pages = malloc(PAGE_SIZE * ASYNC_TEST_PAGES);
+
+  CHECK_RETURN_RC(createPageFile (TESTPF));
+  CHECK_RETURN_RC(openPageFile (TESTPF, &fh));
+  CHECK_RETURN_RC(ensureCapacity (ASYNC_TEST_PAGES, &fh));
+  CHECK_RETURN_RC(initAsyncIO (&fh, ASYNC_TEST_PAGES, backend));
+  if (backend == SM_ASYNC_THREAD_POOL)
+    FAIL((getAsyncBackend(&fh) == SM_ASYNC_THREAD_POOL), "expected the thread pool backend");
+
+  // write every page with its own number
+  for (i=0; i < ASYNC_TEST_PAGES; i++)
+    {
+      memset(pages + i * PAGE_SIZE, 'a' + i, PAGE_SIZE);
+      requests[i].pageNum = i;
+      requests[i].memPage = pages + i * PAGE_SIZE;
+      requests[i].isWrite = TRUE;
+    }
+  CHECK_RETURN_RC(submitAsyncIO (&fh, requests, ASYNC_TEST_PAGES));
+  FAIL((submitAsyncIO (&fh, requests, 1) == RC_ASYNC_QUEUE_FULL), "expected the queue to be full");
+  FAIL((reapAsyncIO (&fh, done, ASYNC_TEST_PAGES, ASYNC_TEST_PAGES) == ASYNC_TEST_PAGES), "expected all writes to complete");
+  for (i=0; i < ASYNC_TEST_PAGES; i++)
+    CHECK_RETURN_RC(done[i]->rc);
+
+  // read the pages back in reverse order, plus one page past the end of the file
+  memset(pages, 0, PAGE_SIZE * ASYNC_TEST_PAGES);
+  for (i=0; i < ASYNC_TEST_PAGES; i++)
+    {
+      requests[i].pageNum = ASYNC_TEST_PAGES - 1 - i;
+      requests[i].memPage = pages + i * PAGE_SIZE;
+      requests[i].isWrite = FALSE;
+    }
+  CHECK_RETURN_RC(submitAsyncIO (&fh, requests, ASYNC_TEST_PAGES));
+  FAIL((reapAsyncIO (&fh, done, ASYNC_TEST_PAGES, ASYNC_TEST_PAGES) == ASYNC_TEST_PAGES), "expected all reads to complete");
+  FAIL((getNumAsyncInFlight(&fh) == 0), "expected no requests in flight");
+  for (i=0; i < ASYNC_TEST_PAGES; i++)
+    {
+      CHECK_RETURN_RC(done[i]->rc);
+      for (j=0; j < PAGE_SIZE; j++)
+        FAIL((done[i]->memPage[j] == 'a' + done[i]->pageNum), "character in page read asynchronously not the one we expected.");
+    }
+
+  requests[0].pageNum = ASYNC_TEST_PAGES;
+  CHECK_RETURN_RC(submitAsyncIO (&fh, requests, 1));
+  FAIL((reapAsyncIO (&fh, done, 1, 1) == 1), "expected the read to complete");
+  FAIL((done[0]->rc != RC_OK), "reading a non existing page should return an error.");
+
+  // a ring the kernel no longer accepts fails the submit instead of leaving the requests in flight
+  if (getAsyncBackend(&fh) == SM_ASYNC_IO_URING)
+    {
+      int ringFd = findRingFd();
+      FAIL((ringFd >= 0), "expected an io_uring file descriptor");
+      close(ringFd);
+      requests[0].pageNum = 0;
+      FAIL((submitAsyncIO (&fh, requests, 1) == RC_ASYNC_IO_FAILED), "expected submitting to a broken ring to fail");
+      FAIL((getNumAsyncInFlight(&fh) == 0), "expected no requests in flight after a failed submit");
+      FAIL((reapAsyncIO (&fh, done, 1, 1) == 0), "expected nothing to reap after a failed submit");
+    }
+
+  CHECK_RETURN_RC(closePageFile (&fh));
+  CHECK_RETURN_RC(destroyPageFile (TESTPF));
+
+  free(pages);
+  return RC_OK;
+}
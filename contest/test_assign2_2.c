@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "storage_mgr.h"
 #include "buffer_mgr_stat.h"
 #include "buffer_mgr.h"
@@ -6,6 +8,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 
 // var to store the current test's name
 static char *testName;
@@ -94,6 +97,34 @@ static void testFIFO (void);
 
 static void testLRU (void);
 
+static void testCLOCK (void);
+
+static void testLFU (void);
+
+static void testLRU_K (void);
+
+static void testARC (void);
+
+static void test2Q (void);
+
+static void testAdmissionFilter (void);
+
+static void testConcurrentReading (void);
+static void testConcurrentMappedGrowth (void);
+static void testDirectIO (void);
+static void testBackgroundWriter (void);
+static void testReadAhead (void);
+static void testBatchPinning (void);
+static void testSharedPool (void);
+static void testPoolQuotas (void);
+typedef struct ReaderArgs {
+  BM_BufferPool *bm;
+  unsigned int seed;
+  int numPages;
+  int wrongPages;
+} ReaderArgs;
+static void *readDummyPagesConcurrently (void *arg);
+
 static void testError (void);
 
 // main method
@@ -108,6 +139,20 @@ main (void)
   testReadPage();
   testFIFO();
   testLRU();
+  testCLOCK();
+  testLFU();
+  testLRU_K();
+  testARC();
+  test2Q();
+  testAdmissionFilter();
+  testConcurrentReading();
+  testConcurrentMappedGrowth();
+  testDirectIO();
+  testBackgroundWriter();
+  testReadAhead();
+  testBatchPinning();
+  testSharedPool();
+  testPoolQuotas();
   /* testError(); */
 }
 
@@ -418,6 +463,925 @@ testLRU (void)
   TEST_DONE();
 }
 
+// test the CLOCK page replacement strategy
+void
+testCLOCK (void)
+{
+  // expected results
+  const char *poolContents[] = {
+    "[0 0],[-1 0],[-1 0]",
+    "[0 0],[1 0],[-1 0]",
+    "[0 0],[1 0],[2 0]",
+    // every slot gets a second chance, hand wraps around to slot 0
+    "[3 0],[1 0],[2 0]",
+    // hit on page 1 sets its reference bit again
+    "[3 0],[1 0],[2 0]",
+    "[3 0],[1 0],[4 0]",
+    "[3 0],[5 0],[4 0]",
+    // pinned page 3 is skipped by the hand
+    "[3 1],[5 0],[6 0]"
+  };
+  const int requests[] = {0,1,2,3,1,4,5};
+  const int numRequests = 7;
+
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  testName = "Testing CLOCK page replacement";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 100);
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_CLOCK, NULL));
+
+  for(i = 0; i < numRequests; i++)
+    {
+      pinPage(bm, h, requests[i]);
+      unpinPage(bm, h);
+      ASSERT_EQUALS_POOL(poolContents[i], bm, "check pool content");
+    }
+
+  // keep page 3 pinned while another page is read in
+  pinPage(bm, h, 3);
+  pinPage(bm, h, 6);
+  unpinPage(bm, h);
+  ASSERT_EQUALS_POOL(poolContents[i], bm, "check pool content with pinned page");
+
+  h->pageNum = 3;
+  unpinPage(bm, h);
+
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+  ASSERT_EQUALS_INT(7, getNumReadIO(bm), "check number of read I/Os");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// test the LFU page replacement strategy
+void
+testLFU (void)
+{
+  // expected results
+  const char *poolContents[] = {
+    "[0 0],[-1 0],[-1 0]",
+    "[0 0],[1 0],[-1 0]",
+    "[0 0],[1 0],[2 0]",
+    // page 0 is used three times and page 1 twice, so page 2 goes first
+    "[0 0],[1 0],[2 0]",
+    "[0 0],[1 0],[2 0]",
+    "[0 0],[1 0],[2 0]",
+    "[0 0],[1 0],[3 0]",
+    "[0 0],[1 0],[4 0]",
+    // page 4 is used three times, page 1 now has the lowest count
+    "[0 0],[1 0],[4 0]",
+    "[0 0],[1 0],[4 0]",
+    "[0 0],[5 0],[4 0]"
+  };
+  const int requests[] = {0,1,2,0,0,1,3,4,4,4,5};
+  const int numRequests = 11;
+
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  testName = "Testing LFU page replacement";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 100);
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LFU, NULL));
+
+  for(i = 0; i < numRequests; i++)
+    {
+      pinPage(bm, h, requests[i]);
+      unpinPage(bm, h);
+      ASSERT_EQUALS_POOL(poolContents[i], bm, "check pool content");
+    }
+
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+  ASSERT_EQUALS_INT(6, getNumReadIO(bm), "check number of read I/Os");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// test the LRU-K page replacement strategy
+void
+testLRU_K (void)
+{
+  // expected results
+  const char *poolContents[] = {
+    "[0 0],[-1 0],[-1 0]",
+    "[0 0],[1 0],[-1 0]",
+    "[0 0],[1 0],[2 0]",
+    "[0 0],[1 0],[2 0]",
+    "[0 0],[1 0],[2 0]",
+    // pages referenced only once go first
+    "[0 0],[1 0],[3 0]",
+    "[0 0],[1 0],[4 0]",
+    "[0 0],[1 0],[4 0]",
+    // page 0 has the oldest second to last reference
+    "[5 0],[1 0],[4 0]",
+    // a scan only replaces the page of the scan
+    "[6 0],[1 0],[4 0]",
+    "[7 0],[1 0],[4 0]"
+  };
+  const int requests[] = {0,1,2,0,1,3,4,4,5,6,7};
+  const int numRequests = 11;
+  LRUKConfig config = { 2, 0 };
+
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  testName = "Testing LRU-K page replacement";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 100);
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU_K, &config));
+
+  for(i = 0; i < numRequests; i++)
+    {
+      pinPage(bm, h, requests[i]);
+      unpinPage(bm, h);
+      ASSERT_EQUALS_POOL(poolContents[i], bm, "check pool content");
+    }
+
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+  ASSERT_EQUALS_INT(8, getNumReadIO(bm), "check number of read I/Os");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// test the ARC page replacement strategy
+void
+testARC (void)
+{
+  // expected results
+  const char *poolContents[] = {
+    "[0 0],[-1 0],[-1 0]",
+    "[0 0],[1 0],[-1 0]",
+    "[0 0],[1 0],[2 0]",
+    // page 0 moves to T2
+    "[0 0],[1 0],[2 0]",
+    // T1 is above its target, page 1 is evicted to B1
+    "[0 0],[3 0],[2 0]",
+    // hit on B1 grows the target of T1 to 1, page 2 is evicted to B1
+    "[0 0],[3 0],[1 0]",
+    // T1 is at its target, page 0 is evicted from T2 to B2
+    "[4 0],[3 0],[1 0]",
+    // hit on B2 shrinks the target of T1 back to 0
+    "[4 0],[0 0],[1 0]"
+  };
+  const int requests[] = {0,1,2,0,3,1,4,0};
+  const int numRequests = 8;
+
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  testName = "Testing ARC page replacement";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 100);
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_ARC, NULL));
+
+  for(i = 0; i < numRequests; i++)
+    {
+      pinPage(bm, h, requests[i]);
+      unpinPage(bm, h);
+      ASSERT_EQUALS_POOL(poolContents[i], bm, "check pool content");
+      if (i == 5)
+        ASSERT_EQUALS_INT(1, getArcTargetSize(bm), "check target size of T1 after B1 hit");
+    }
+
+  ASSERT_EQUALS_INT(0, getArcTargetSize(bm), "check target size of T1 after B2 hit");
+  ASSERT_EQUALS_INT(1, getNumRecencyGhostHits(bm), "check number of B1 hits");
+  ASSERT_EQUALS_INT(1, getNumFrequencyGhostHits(bm), "check number of B2 hits");
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+  ASSERT_EQUALS_INT(7, getNumReadIO(bm), "check number of read I/Os");
+  CHECK(shutdownBufferPool(bm));
+
+  // the same requests with page 2 dirty, writing it back before its frame is taken keeps the B1 hit on page 1
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_ARC, NULL));
+  for(i = 0; i < numRequests; i++)
+    {
+      pinPage(bm, h, requests[i]);
+      if (requests[i] == 2)
+        markDirty(bm, h);
+      unpinPage(bm, h);
+    }
+  ASSERT_EQUALS_POOL(poolContents[numRequests - 1], bm, "check pool content with a dirty victim");
+  ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "check number of write I/Os");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// test the 2Q page replacement strategy
+void
+test2Q (void)
+{
+  // expected results
+  const char *poolContents[] = {
+    "[0 0],[-1 0],[-1 0],[-1 0]",
+    "[0 0],[1 0],[-1 0],[-1 0]",
+    "[0 0],[1 0],[2 0],[-1 0]",
+    "[0 0],[1 0],[2 0],[3 0]",
+    // A1in is over its target of one page, its oldest page moves to A1out
+    "[4 0],[1 0],[2 0],[3 0]",
+    // pages found on A1out are loaded in to Am
+    "[4 0],[0 0],[2 0],[3 0]",
+    "[4 0],[0 0],[1 0],[3 0]",
+    // a scan only cycles through A1in
+    "[4 0],[0 0],[1 0],[5 0]",
+    "[6 0],[0 0],[1 0],[5 0]",
+    "[6 0],[0 0],[1 0],[7 0]",
+    "[6 0],[0 0],[1 0],[7 0]",
+    "[8 0],[0 0],[1 0],[7 0]"
+  };
+  const int requests[] = {0,1,2,3,4,0,1,5,6,7,0,8};
+  const int numRequests = 12;
+
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  testName = "Testing 2Q page replacement";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 100);
+  CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_2Q, NULL));
+
+  for(i = 0; i < numRequests; i++)
+    {
+      pinPage(bm, h, requests[i]);
+      unpinPage(bm, h);
+      ASSERT_EQUALS_POOL(poolContents[i], bm, "check pool content");
+    }
+
+  ASSERT_EQUALS_INT(2, getNumRecencyGhostHits(bm), "check number of A1out hits");
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+  ASSERT_EQUALS_INT(11, getNumReadIO(bm), "check number of read I/Os");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// test the TinyLFU admission filter in front of LRU
+void
+testAdmissionFilter (void)
+{
+  // expected results
+  const char *poolContents[] = {
+    // the first page fills the one frame admission window, the others go to LRU
+    "[0 0],[-1 0],[-1 0]",
+    "[0 0],[1 0],[-1 0]",
+    "[0 0],[1 0],[2 0]",
+    "[0 0],[1 0],[2 0]",
+    "[0 0],[1 0],[2 0]",
+    "[0 0],[1 0],[2 0]",
+    // cold window pages lose against the LRU victim, page 1, and are evicted themselves
+    "[3 0],[1 0],[2 0]",
+    "[4 0],[1 0],[2 0]",
+    "[4 0],[1 0],[2 0]",
+    "[4 0],[1 0],[2 0]",
+    "[4 0],[1 0],[2 0]",
+    // page 4 is now requested more often than page 1 and replaces it
+    "[4 0],[5 0],[2 0]"
+  };
+  const int requests[] = {0,1,2,1,1,2,3,4,4,4,4,5};
+  const int numRequests = 12;
+
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  testName = "Testing TinyLFU admission filter";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 100);
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+  CHECK(enableAdmissionFilter(bm, 34));
+
+  for(i = 0; i < numRequests; i++)
+    {
+      pinPage(bm, h, requests[i]);
+      unpinPage(bm, h);
+      ASSERT_EQUALS_POOL(poolContents[i], bm, "check pool content");
+    }
+
+  ASSERT_ERROR(enableAdmissionFilter(bm, 0), "enable admission filter on a pool in use");
+  ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+  ASSERT_EQUALS_INT(6, getNumReadIO(bm), "check number of read I/Os");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+#define NUM_READER_THREADS 4
+#define NUM_READS_PER_THREAD 2000
+
+// several threads read random pages through one small pool and check their content
+void
+testConcurrentReading (void)
+{
+  int i;
+  int wrongPages = 0;
+  pthread_t readers[NUM_READER_THREADS];
+  ReaderArgs args[NUM_READER_THREADS];
+  BM_BufferPool *bm = MAKE_POOL();
+  testName = "Reading pages from several threads";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, NUM_DUMMY_PAGES);
+
+  CHECK(initBufferPool(bm, "testbuffer.bin", 10, RS_LRU, NULL));
+
+  for (i = 0; i < NUM_READER_THREADS; i++)
+    {
+      args[i].bm = bm;
+      args[i].seed = i + 1;
+      args[i].numPages = NUM_DUMMY_PAGES;
+      pthread_create(&readers[i], NULL, readDummyPagesConcurrently, &args[i]);
+    }
+  for (i = 0; i < NUM_READER_THREADS; i++)
+    {
+      pthread_join(readers[i], NULL);
+      wrongPages += args[i].wrongPages;
+    }
+
+  ASSERT_EQUALS_INT(0, wrongPages, "check that every thread read the right pages");
+  int *fixCounts = getFixCounts(bm);
+  for (i = 0; i < 10; i++)
+    ASSERT_EQUALS_INT(0, fixCounts[i], "check that no page is left pinned");
+  free(fixCounts);
+
+  CHECK(shutdownBufferPool(bm));
+
+  // only hits: every one reaches LRU, so the pages the threads did not use are evicted first
+  CHECK(initBufferPool(bm, "testbuffer.bin", 10, RS_LRU, NULL));
+  for (i = 0; i < 10; i++)
+    readAndCheckDummyPage(bm, i);
+  for (i = 0; i < NUM_READER_THREADS; i++)
+    {
+      args[i].seed = i + 1;
+      args[i].numPages = 5;
+      pthread_create(&readers[i], NULL, readDummyPagesConcurrently, &args[i]);
+    }
+  for (i = 0; i < NUM_READER_THREADS; i++)
+    {
+      pthread_join(readers[i], NULL);
+      wrongPages += args[i].wrongPages;
+    }
+  ASSERT_EQUALS_INT(0, wrongPages, "check that every thread read the right pages");
+  ASSERT_EQUALS_INT(10, getNumReadIO(bm), "check that the threads only had hits");
+  fixCounts = getFixCounts(bm);
+  for (i = 0; i < 10; i++)
+    ASSERT_EQUALS_INT(0, fixCounts[i], "check that no page is left pinned");
+  free(fixCounts);
+  for (i = 10; i < 15; i++)
+    readAndCheckDummyPage(bm, i);
+  for (i = 0; i < 5; i++)
+    readAndCheckDummyPage(bm, i);
+  ASSERT_EQUALS_INT(15, getNumReadIO(bm), "check that the pages used by the threads stayed");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  TEST_DONE();
+}
+
+#define MAPPED_GROWTH_STEP 12000
+
+// a mapped page file grows past its first mapping while other threads copy pages out of it
+void
+testConcurrentMappedGrowth (void)
+{
+  int i;
+  int wrongPages = 0;
+  pthread_t readers[NUM_READER_THREADS];
+  ReaderArgs args[NUM_READER_THREADS];
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  testName = "Growing a mapped page file while reading it";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, NUM_DUMMY_PAGES);
+
+  CHECK(initBufferPoolIOMode(bm, "testbuffer.bin", 10, RS_LRU, NULL, SM_IO_MMAP));
+  for (i = 0; i < NUM_READER_THREADS; i++)
+    {
+      args[i].bm = bm;
+      args[i].seed = i + 1;
+      args[i].numPages = NUM_DUMMY_PAGES;
+      pthread_create(&readers[i], NULL, readDummyPagesConcurrently, &args[i]);
+    }
+
+  // each pin of a page past the end grows the file, the last two beyond what is mapped
+  for (i = 1; i <= 4; i++)
+    {
+      CHECK(pinPage(bm, h, i * MAPPED_GROWTH_STEP));
+      ASSERT_EQUALS_STRING("", h->data, "check that a new page is empty");
+      CHECK(unpinPage(bm, h));
+    }
+
+  for (i = 0; i < NUM_READER_THREADS; i++)
+    {
+      pthread_join(readers[i], NULL);
+      wrongPages += args[i].wrongPages;
+    }
+  ASSERT_EQUALS_INT(0, wrongPages, "check that every thread read the right pages");
+  ASSERT_EQUALS_INT(4 * MAPPED_GROWTH_STEP + 1, getNumPagesInFile(bm), "check number of pages in the file");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// pin and check random pages below numPages, count the pages that could not be read or had the wrong content
+void *
+readDummyPagesConcurrently (void *arg)
+{
+  int i;
+  ReaderArgs *args = arg;
+  char expected[PAGE_SIZE];
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+
+  args->wrongPages = 0;
+  for (i = 0; i < NUM_READS_PER_THREAD; i++)
+    {
+      int page = rand_r(&args->seed) % args->numPages;
+      if (pinPage(args->bm, h, page) != RC_OK)
+        {
+          args->wrongPages++;
+          continue;
+        }
+      sprintf(expected, "%s-%i", "Page", page);
+      if (strcmp(expected, h->data) != 0)
+        args->wrongPages++;
+      unpinPage(args->bm, h);
+    }
+
+  free(h);
+  return NULL;
+}
+
+// read and write pages through a pool that bypasses the kernel page cache
+void
+testDirectIO (void)
+{
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  testName = "Reading and writing pages with direct I/O";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 20);
+
+  CHECK(initBufferPoolIOMode(bm, "testbuffer.bin", 3, RS_LRU, NULL, SM_IO_DIRECT));
+  ASSERT_EQUALS_INT(0, (int) ((unsigned long) bm->mgmtData->buffPoolAddr % PAGE_SIZE), "check that frames are aligned");
+  for (i = 0; i < 20; i++)
+    readAndCheckDummyPage(bm, i);
+
+  // overwrite a page, evict it and read it back
+  CHECK(pinPage(bm, h, 5));
+  sprintf(h->data, "%s-%i", "Direct", 5);
+  CHECK(markDirty(bm, h));
+  CHECK(unpinPage(bm, h));
+  for (i = 10; i < 13; i++)
+    readAndCheckDummyPage(bm, i);
+  CHECK(pinPage(bm, h, 5));
+  ASSERT_EQUALS_STRING("Direct-5", h->data, "check page written with direct I/O");
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "check number of write I/Os");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// the background writer cleans the dirty frames, so the pins evicting them do not write
+void
+testBackgroundWriter (void)
+{
+  int i;
+  int numDirty;
+  struct timespec pause = {0, 1000000};
+  BgWriterConfig config = {100, 0, 100, 1, 4};
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  char expected[PAGE_SIZE];
+  testName = "Flushing dirty pages in the background";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 20);
+
+  CHECK(initBufferPool(bm, "testbuffer.bin", 10, RS_LRU, NULL));
+  CHECK(startBackgroundWriter(bm, &config));
+  ASSERT_ERROR(startBackgroundWriter(bm, NULL), "start a second background writer");
+
+  for (i = 0; i < 10; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(h->data, "%s-%i", "Background", i);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+
+  // wait up to 5 seconds for the writer to write every frame
+  for (i = 0; i < 5000 && getNumBackgroundWrites(bm) < 10; i++)
+    nanosleep(&pause, NULL);
+  ASSERT_EQUALS_INT(10, getNumBackgroundWrites(bm), "check number of background writes");
+  bool *dirtyFlags = getDirtyFlags(bm);
+  for (numDirty = 0, i = 0; i < 10; i++)
+    numDirty += dirtyFlags[i];
+  free(dirtyFlags);
+  ASSERT_EQUALS_INT(0, numDirty, "check that the background writer cleaned all frames");
+
+  // evicting the clean frames needs no write
+  for (i = 10; i < 20; i++)
+    readAndCheckDummyPage(bm, i);
+  ASSERT_EQUALS_INT(10, getNumWriteIO(bm), "check number of write I/Os");
+  CHECK(stopBackgroundWriter(bm));
+
+  for (i = 0; i < 10; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Background", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "check page written in the background");
+      CHECK(unpinPage(bm, h));
+    }
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+// scan the pages of a file in order with read-ahead, every page is read exactly once
+void
+testReadAhead (void)
+{
+  int i;
+  struct timespec pause = {0, 1000000};
+  BM_PageHandle handles[11];
+  BM_BufferPool *bm = MAKE_POOL();
+  testName = "Reading ahead of a sequential scan";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 30);
+
+  CHECK(initBufferPool(bm, "testbuffer.bin", 10, RS_LRU, NULL));
+  CHECK(startReadAhead(bm, 4));
+  ASSERT_ERROR(startReadAhead(bm, 0), "start read-ahead twice");
+
+  // pins out of order, or of the same page again, read nothing ahead
+  readAndCheckDummyPage(bm, 20);
+  readAndCheckDummyPage(bm, 10);
+  readAndCheckDummyPage(bm, 10);
+  for (i = 0; i < 10; i++)
+    nanosleep(&pause, NULL);
+  ASSERT_EQUALS_INT(0, getNumReadAheadPages(bm), "check that random pins read nothing ahead");
+
+  // two consecutive pages start a run, the next 4 pages are read ahead
+  readAndCheckDummyPage(bm, 0);
+  readAndCheckDummyPage(bm, 1);
+  for (i = 0; i < 5000 && getNumReadAheadPages(bm) < 4; i++)
+    nanosleep(&pause, NULL);
+  ASSERT_EQUALS_INT(4, getNumReadAheadPages(bm), "check number of pages read ahead");
+  ASSERT_EQUALS_INT(8, getNumReadIO(bm), "check number of read I/Os");
+
+  // a scan that works on each page gives the thread time to keep ahead of it,
+  // pages 10 and 20 are evicted before the scan gets to them
+  for (i = 2; i < 30; i++)
+    {
+      readAndCheckDummyPage(bm, i);
+      nanosleep(&pause, NULL);
+    }
+  ASSERT_EQUALS_INT(32, getNumReadIO(bm), "check that the scan read every page once");
+  ASSERT_EQUALS_INT(1, getNumReadAheadPages(bm) > 4, "check that the scan kept reading ahead");
+
+  // a scan that pins every frame waits for the frames being read ahead, one more pin is an error
+  for (i = 0; i < 10; i++)
+    CHECK(pinPage(bm, &handles[i], i));
+  ASSERT_ERROR(pinPage(bm, &handles[10], 10), "try to pin page when pool is full of pinned pages");
+  for (i = 0; i < 10; i++)
+    CHECK(unpinPage(bm, &handles[i]));
+
+  CHECK(stopReadAhead(bm));
+  CHECK(shutdownBufferPool(bm));
+
+  // ARC: page 2 is on B1 when it is read ahead, that is no ghost hit and the page goes to T1
+  CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_ARC, NULL));
+  CHECK(startReadAhead(bm, 2));
+  readAndCheckDummyPage(bm, 2);
+  for (i = 5; i < 14; i += 3)
+    {
+      readAndCheckDummyPage(bm, i);
+      readAndCheckDummyPage(bm, i);
+    }
+  readAndCheckDummyPage(bm, 14);
+  readAndCheckDummyPage(bm, 0);
+  readAndCheckDummyPage(bm, 1);
+  for (i = 0; i < 5000 && getNumReadAheadPages(bm) < 2; i++)
+    nanosleep(&pause, NULL);
+  ASSERT_EQUALS_INT(2, getNumReadAheadPages(bm), "check number of pages read ahead");
+  ASSERT_EQUALS_INT(0, getNumRecencyGhostHits(bm), "check that reading ahead is no B1 hit");
+  CHECK(stopReadAhead(bm));
+  ASSERT_EQUALS_INT(9, getNumReadIO(bm), "check number of read I/Os");
+  readAndCheckDummyPage(bm, 2);
+  ASSERT_EQUALS_INT(9, getNumReadIO(bm), "check that the page read ahead is a hit");
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  TEST_DONE();
+}
+
+// pin and unpin batches of pages, a batch that does not fit in the pool pins nothing
+void
+testBatchPinning (void)
+{
+  int i;
+  int numPinned;
+  int *fixCounts;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle h[11];
+  PageNumber batch[] = {7, 3, 5, 6, 4, 12};
+  PageNumber repeated[] = {27, 24, 25, 27, 26};
+  PageNumber tooLarge[11];
+  char expected[PAGE_SIZE];
+  testName = "Pinning batches of pages";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 30);
+
+  CHECK(initBufferPool(bm, "testbuffer.bin", 10, RS_LRU, NULL));
+  readAndCheckDummyPage(bm, 3);
+
+  // page 3 is a hit, the others are read
+  CHECK(pinPages(bm, h, batch, 6));
+  for (i = 0; i < 6; i++)
+    {
+      sprintf(expected, "%s-%i", "Page", batch[i]);
+      ASSERT_EQUALS_INT(batch[i], h[i].pageNum, "check page number of batch handle");
+      ASSERT_EQUALS_STRING(expected, h[i].data, "check page content of batch handle");
+    }
+  ASSERT_EQUALS_INT(6, getNumReadIO(bm), "check that only the misses were read");
+
+  fixCounts = getFixCounts(bm);
+  for (numPinned = 0, i = 0; i < 10; i++)
+    numPinned += fixCounts[i];
+  free(fixCounts);
+  ASSERT_EQUALS_INT(6, numPinned, "check fix counts after pinning a batch");
+
+  CHECK(unpinPages(bm, h, 6));
+  fixCounts = getFixCounts(bm);
+  for (numPinned = 0, i = 0; i < 10; i++)
+    numPinned += fixCounts[i];
+  free(fixCounts);
+  ASSERT_EQUALS_INT(0, numPinned, "check fix counts after unpinning a batch");
+
+  // the 4 pages fill the pool, page 27 is read once and takes no other page's frame
+  CHECK(pinPages(bm, h, repeated, 5));
+  ASSERT_EQUALS_INT(10, getNumReadIO(bm), "check that a repeated page is read once");
+  ASSERT_EQUALS_INT(1, h[0].data == h[3].data, "check that the handles of a repeated page share its frame");
+  CHECK(unpinPages(bm, h, 5));
+  fixCounts = getFixCounts(bm);
+  for (numPinned = 0, i = 0; i < 10; i++)
+    numPinned += fixCounts[i];
+  free(fixCounts);
+  ASSERT_EQUALS_INT(0, numPinned, "check fix counts after unpinning a repeated page");
+  for (i = 0; i < 6; i++)
+    readAndCheckDummyPage(bm, batch[i]);
+  ASSERT_EQUALS_INT(10, getNumReadIO(bm), "check that the first batch is still in the pool");
+
+  // 11 pages do not fit in 10 frames
+  for (i = 0; i < 11; i++)
+    tooLarge[i] = 10 + i;
+  ASSERT_ERROR(pinPages(bm, h, tooLarge, 11), "pin a batch larger than the pool");
+  fixCounts = getFixCounts(bm);
+  for (numPinned = 0, i = 0; i < 10; i++)
+    numPinned += fixCounts[i];
+  free(fixCounts);
+  ASSERT_EQUALS_INT(0, numPinned, "check that a failed batch pins nothing");
+
+  CHECK(shutdownBufferPool(bm));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  TEST_DONE();
+}
+
+// two page files in one pool, replacement picks victims over the pages of both
+void
+testSharedPool (void)
+{
+  int i;
+  int numResident;
+  PageNumber *frameContents;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_BufferPool *pool = MAKE_POOL();
+  BM_BufferPool *other = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  char expected[PAGE_SIZE];
+  testName = "Sharing a pool between page files";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 10);
+  CHECK(createPageFile("testbuffer2.bin"));
+  CHECK(initBufferPool(other, "testbuffer2.bin", 3, RS_FIFO, NULL));
+  for (i = 0; i < 10; i++)
+    {
+      CHECK(pinPage(other, h, i));
+      sprintf(h->data, "%s-%i", "Other", h->pageNum);
+      CHECK(markDirty(other, h));
+      CHECK(unpinPage(other, h));
+    }
+  CHECK(shutdownBufferPool(other));
+
+  CHECK(initSharedBufferPool(pool, 6, RS_LRU, NULL));
+  CHECK(openPoolFile(bm, pool, "testbuffer.bin"));
+  CHECK(openPoolFile(other, pool, "testbuffer2.bin"));
+  ASSERT_ERROR(pinPage(pool, h, 0), "pin a page of a pool without a file");
+
+  // the same page numbers of both files are different pages
+  for (i = 0; i < 4; i++)
+    readAndCheckDummyPage(bm, i);
+  for (i = 0; i < 4; i++)
+    {
+      CHECK(pinPage(other, h, i));
+      sprintf(expected, "%s-%i", "Other", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "check page content of the second file");
+      CHECK(unpinPage(other, h));
+    }
+  ASSERT_EQUALS_INT(8, getNumReadIO(pool), "check that every page was read once");
+
+  // the second file evicted pages 0 and 1 of the first, page 3 is still there
+  readAndCheckDummyPage(bm, 3);
+  ASSERT_EQUALS_INT(8, getNumReadIO(pool), "check that page 3 of the first file is a hit");
+  readAndCheckDummyPage(bm, 0);
+  ASSERT_EQUALS_INT(9, getNumReadIO(pool), "check that page 0 of the first file was evicted");
+
+  CHECK(pinPage(other, h, 1));
+  sprintf(h->data, "%s-%i", "Changed", 1);
+  CHECK(markDirty(other, h));
+  CHECK(unpinPage(other, h));
+  ASSERT_ERROR(shutdownBufferPool(pool), "shut down a pool with files in it");
+
+  // removing a file writes its pages and leaves only those of the first file
+  CHECK(shutdownBufferPool(other));
+  frameContents = getFrameContents(pool);
+  for (numResident = 0, i = 0; i < 6; i++)
+    numResident += frameContents[i] != NO_PAGE;
+  free(frameContents);
+  ASSERT_EQUALS_INT(2, numResident, "check that the pages of the removed file left the pool");
+
+  CHECK(openPoolFile(other, pool, "testbuffer2.bin"));
+  CHECK(pinPage(other, h, 1));
+  ASSERT_EQUALS_STRING("Changed-1", h->data, "check that the page was written when its file was removed");
+  CHECK(unpinPage(other, h));
+  readAndCheckDummyPage(bm, 3);
+
+  CHECK(shutdownBufferPool(other));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(shutdownBufferPool(pool));
+  CHECK(destroyPageFile("testbuffer.bin"));
+  CHECK(destroyPageFile("testbuffer2.bin"));
+
+  free(bm);
+  free(pool);
+  free(other);
+  free(h);
+  TEST_DONE();
+}
+
+// pin pages first to last of the file of bm and check their content
+static void
+pinOtherPages (BM_BufferPool *bm, BM_PageHandle *h, int first, int last)
+{
+  int i;
+  char expected[PAGE_SIZE];
+
+  for (i = first; i <= last; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Other", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "check page content of the second file");
+      CHECK(unpinPage(bm, h));
+    }
+}
+
+// test reservations, caps and priority classes of the files of a shared pool
+void
+testPoolQuotas (void)
+{
+  int i;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_BufferPool *pool = MAKE_POOL();
+  BM_BufferPool *index = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  testName = "Quotas of the files of a shared pool";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 10);
+  CHECK(createPageFile("testbuffer2.bin"));
+  CHECK(initBufferPool(index, "testbuffer2.bin", 3, RS_FIFO, NULL));
+  for (i = 0; i < 6; i++)
+    {
+      CHECK(pinPage(index, h, i));
+      sprintf(h->data, "%s-%i", "Other", h->pageNum);
+      CHECK(markDirty(index, h));
+      CHECK(unpinPage(index, h));
+    }
+  CHECK(shutdownBufferPool(index));
+
+  CHECK(initSharedBufferPool(pool, 6, RS_LRU, NULL));
+  CHECK(openPoolFile(bm, pool, "testbuffer.bin"));
+  CHECK(openPoolFile(index, pool, "testbuffer2.bin"));
+  ASSERT_ERROR(setPoolFileQuota(pool, 1, 0, PRIORITY_HEAP), "set a quota for a pool without a file");
+
+  // a scan of the heap file evicts its own pages before the older pages of the index
+  CHECK(setPoolFileQuota(index, 0, 0, PRIORITY_INDEX));
+  pinOtherPages(index, h, 0, 2);
+  for (i = 0; i < 10; i++)
+    readAndCheckDummyPage(bm, i);
+  ASSERT_EQUALS_INT(3, getNumPoolFileFrames(index), "check that the scan kept the index pages");
+  ASSERT_EQUALS_INT(3, getNumPoolFileFrames(bm), "check that the scan replaced its own pages");
+  pinOtherPages(index, h, 0, 2);
+  ASSERT_EQUALS_INT(13, getNumReadIO(pool), "check that the index pages are hits");
+
+  // in the same class the scan takes index pages only down to the reservation
+  CHECK(setPoolFileQuota(index, 2, 0, PRIORITY_HEAP));
+  ASSERT_ERROR(setPoolFileQuota(bm, 5, 0, PRIORITY_HEAP), "reserve more frames than the pool has");
+  for (i = 0; i < 10; i++)
+    readAndCheckDummyPage(bm, i);
+  ASSERT_EQUALS_INT(2, getNumPoolFileFrames(index), "check that the reservation of the index was kept");
+  ASSERT_EQUALS_INT(4, getNumPoolFileFrames(bm), "check that the scan took the other frames");
+
+  // a file at its cap replaces its own pages, even if the pages of the other file are older
+  CHECK(setPoolFileQuota(index, 0, 2, PRIORITY_HEAP));
+  pinOtherPages(index, h, 0, 5);
+  ASSERT_EQUALS_INT(2, getNumPoolFileFrames(index), "check that the index stays at its cap");
+  ASSERT_EQUALS_INT(4, getNumPoolFileFrames(bm), "check that the heap pages stay");
+
+  CHECK(shutdownBufferPool(index));
+  ASSERT_EQUALS_INT(0, getNumPoolFileFrames(index), "check that a removed file holds no frames");
+  CHECK(shutdownBufferPool(bm));
+  CHECK(shutdownBufferPool(pool));
+
+  // 2Q: the victims passed over for the index pages are not remembered, so the scan keeps its pages on A1out
+  CHECK(initSharedBufferPool(pool, 6, RS_2Q, NULL));
+  CHECK(openPoolFile(bm, pool, "testbuffer.bin"));
+  CHECK(openPoolFile(index, pool, "testbuffer2.bin"));
+  CHECK(setPoolFileQuota(index, 0, 0, PRIORITY_INDEX));
+  pinOtherPages(index, h, 0, 2);
+  pinOtherPages(index, h, 0, 2);
+  for (i = 0; i < 9; i++)
+    readAndCheckDummyPage(bm, i % 6);
+  ASSERT_EQUALS_INT(3, getNumPoolFileFrames(index), "check that the scan kept the index pages");
+  ASSERT_EQUALS_INT(3, getNumRecencyGhostHits(pool), "check number of A1out hits of the scan");
+  CHECK(shutdownBufferPool(index));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(shutdownBufferPool(pool));
+  CHECK(destroyPageFile("testbuffer.bin"));
+  CHECK(destroyPageFile("testbuffer2.bin"));
+
+  free(bm);
+  free(pool);
+  free(index);
+  free(h);
+  TEST_DONE();
+}
+
 // test error cases
 void
 testError (void)